@@ -1,14 +1,35 @@
 # Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
 # SPDX-License-Identifier: Apache-2.0
 
+import argparse
+import base64
 import glob
 import os
+import re
+import sys
 
-def bin2array(name, fin, fout):
+PEM_BLOCK = re.compile(rb"-----BEGIN ([A-Z0-9 ]+)-----(.*?)-----END \1-----", re.DOTALL)
+
+def pem2der(fin, data):
+    blocks = PEM_BLOCK.findall(data)
+    if len(blocks) == 0:
+        sys.exit(f"{os.path.relpath(fin)}: no PEM block found")
+    if len(blocks) > 1:
+        # mbedTLS parses a single certificate from a DER credential
+        sys.exit(f"{os.path.relpath(fin)}: {len(blocks)} PEM blocks found, DER credentials hold a single one")
+    label, body = blocks[0]
+    if b"ENCRYPTED" in label or b"Proc-Type" in body:
+        sys.exit(f"{os.path.relpath(fin)}: encrypted keys are not supported")
+    return base64.b64decode(b"".join(body.split()))
+
+def bin2array(name, fin, fout, der=False):
     with open(fin, 'rb') as f:
         data = f.read()
 
-    data += b'\0' # Add null terminator
+    if der:
+        data = pem2der(fin, data) # DER is parsed as is, without terminator
+    else:
+        data += b'\0' # Add null terminator
 
     with open(fout, 'w') as f:
         f.write("#include <stdint.h>\n")
@@ -21,21 +42,30 @@ def bin2array(name, fin, fout):
         f.write(f"const uint32_t {name}_len = sizeof({name});\n")
 
     print(
-        f"[{name.center(13, ' ')}]: {os.path.relpath(fin)} -> {os.path.relpath(fout)}")
+        f"[{name.center(13, ' ')}]: {os.path.relpath(fin)} -> {os.path.relpath(fout)} ({'DER' if der else 'PEM'}, {len(data)} bytes)")
 
 if __name__ == "__main__":
     creds_dir = os.path.dirname(os.path.realpath(__file__))
 
+    parser = argparse.ArgumentParser(description="Convert credentials to C arrays")
+    parser.add_argument("--der", action="store_true",
+                        help="convert credentials to DER, CONFIG_MBEDTLS_PEM_CERTIFICATE_FORMAT is then not required")
+    parser.add_argument("--output", default=creds_dir,
+                        help="output directory of 'cert.c', 'key.c' and 'ca.c'")
+    args = parser.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+
     creds = glob.glob(f"{creds_dir}/*.pem.*")
 
     cert_found, key_found = False, False
 
     for cred in creds:
         if cred.endswith('-certificate.pem.crt'):
-            bin2array("public_cert", cred, os.path.join(creds_dir, "cert.c"))
+            bin2array("public_cert", cred, os.path.join(args.output, "cert.c"), args.der)
             cert_found = True
         elif cred.endswith('-private.pem.key'):
-            bin2array("private_key", cred, os.path.join(creds_dir, "key.c"))
+            bin2array("private_key", cred, os.path.join(args.output, "key.c"), args.der)
             key_found = True
 
     if not cert_found:
@@ -44,4 +74,7 @@ if __name__ == "__main__":
         print("No private key found !")
 
     bin2array("ca_cert", os.path.join(creds_dir, "broker_ca.crt"),
-              os.path.join(creds_dir, "ca.c"))
+              os.path.join(args.output, "ca.c"), args.der)
+
+    if args.der and not (cert_found and key_found):
+        sys.exit(1)
@@ -0,0 +1,168 @@
+# @file      convert_background.py
+# @brief     Convert background images to RLE compressed RGB565 images
+#
+# Copyright (C) Witekio
+#
+# This file is part of Zephyr Wind Turbine demonstration.
+#
+# This demonstration is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This demonstration is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+
+# Compressed image format, all fields are little-endian:
+#   magic        4 bytes "WTBG"
+#   width        uint16
+#   height       uint16
+#   payload_len  uint32, length of the payload in bytes
+#   payload      sequence of packets made of 16 bits words:
+#                - control word with bit 15 set: run of (control & 0x7fff) + 1
+#                  pixels, followed by the RGB565 pixel to repeat
+#                - control word with bit 15 cleared: (control + 1) literal
+#                  RGB565 pixels follow
+#
+# The PNG decoder only relies on the standard library so that the conversion
+# can run as a build step without additional dependencies.
+
+import argparse
+import os
+import struct
+import zlib
+
+MAGIC = b'WTBG'
+PACKET_MAX = 0x8000
+
+
+def png_read(fin):
+    with open(fin, 'rb') as f:
+        data = f.read()
+
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError(f"{fin} is not a PNG file")
+
+    # Parse chunks
+    offset, idat, ihdr = 8, b'', None
+    while offset < len(data):
+        length, kind = struct.unpack('>I4s', data[offset:offset + 8])
+        chunk = data[offset + 8:offset + 8 + length]
+        if kind == b'IHDR':
+            ihdr = chunk
+        elif kind == b'IDAT':
+            idat += chunk
+        elif kind == b'IEND':
+            break
+        offset += 12 + length
+
+    if ihdr is None or len(ihdr) != 13:
+        raise ValueError(f"{fin}: IHDR chunk is missing or invalid")
+    width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', ihdr)
+    if depth != 8 or color not in (2, 6) or interlace != 0:
+        raise ValueError(f"{fin}: only non-interlaced 8 bits RGB and RGBA images are supported")
+
+    # Unfilter scanlines
+    bpp = 3 if color == 2 else 4
+    stride = width * bpp
+    raw = zlib.decompress(idat)
+    pixels = bytearray(stride * height)
+    prev = bytearray(stride)
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for x in range(stride):
+            a = line[x - bpp] if x >= bpp else 0
+            b = prev[x]
+            c = prev[x - bpp] if x >= bpp else 0
+            if kind == 1:
+                line[x] = (line[x] + a) & 0xff
+            elif kind == 2:
+                line[x] = (line[x] + b) & 0xff
+            elif kind == 3:
+                line[x] = (line[x] + ((a + b) >> 1)) & 0xff
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[x] = (line[x] + pred) & 0xff
+        pixels[y * stride:(y + 1) * stride] = line
+        prev = line
+
+    # Convert to RGB565 with rounding, transparent pixels are blended over black
+    rgb565 = []
+    for i in range(0, len(pixels), bpp):
+        r, g, b = pixels[i], pixels[i + 1], pixels[i + 2]
+        if bpp == 4:
+            alpha = pixels[i + 3]
+            r, g, b = (r * alpha + 127) // 255, (g * alpha + 127) // 255, (b * alpha + 127) // 255
+        r, g, b = (r * 31 + 127) // 255, (g * 63 + 127) // 255, (b * 31 + 127) // 255
+        rgb565.append((r << 11) | (g << 5) | b)
+
+    return width, height, rgb565
+
+
+def rle_encode(pixels):
+    payload = bytearray()
+    literals = []
+
+    def flush_literals():
+        while literals:
+            count = min(len(literals), PACKET_MAX)
+            payload.extend(struct.pack('<H', count - 1))
+            payload.extend(struct.pack(f'<{count}H', *literals[:count]))
+            del literals[:count]
+
+    i = 0
+    while i < len(pixels):
+        run = 1
+        while i + run < len(pixels) and run < PACKET_MAX and pixels[i + run] == pixels[i]:
+            run += 1
+        # Runs shorter than 3 pixels are cheaper as literals
+        if run >= 3:
+            flush_literals()
+            payload.extend(struct.pack('<HH', 0x8000 | (run - 1), pixels[i]))
+        else:
+            literals.extend(pixels[i:i + run])
+        i += run
+    flush_literals()
+
+    return payload
+
+
+def write_c(name, data, fout):
+    with open(fout, 'w') as f:
+        f.write("#include <stdint.h>\n")
+        f.write(f"const uint8_t {name}[] = {{")
+        for i in range(0, len(data), 16):
+            f.write("\n\t")
+            f.write(", ".join(f"0x{b:02x}" for b in data[i:i+16]))
+            f.write(",")
+        f.write("\n};\n")
+        f.write(f"const uint32_t {name}_len = sizeof({name});\n")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Convert a PNG image to a RLE compressed RGB565 image")
+    parser.add_argument("--name", default="background_rle_screen1", help="C array name")
+    parser.add_argument("input", help="PNG image")
+    parser.add_argument("output", help="C source file (.c) or raw binary file (.bin)")
+    args = parser.parse_args()
+
+    width, height, pixels = png_read(args.input)
+    payload = rle_encode(pixels)
+    data = MAGIC + struct.pack('<HHI', width, height, len(payload)) + payload
+
+    if args.output.endswith('.c'):
+        write_c(args.name, data, args.output)
+    else:
+        with open(args.output, 'wb') as f:
+            f.write(data)
+
+    print(f"[{args.name}]: {os.path.relpath(args.input)} -> {os.path.relpath(args.output)}, "
+          f"{width}x{height}, {len(pixels) * 2} -> {len(data)} bytes")
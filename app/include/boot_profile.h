@@ -0,0 +1,54 @@
+/**
+ * @file      boot_profile.h
+ * @brief     Boot phases profiling
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BOOT_PROFILE_H__
+#define __BOOT_PROFILE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief Boot phases
+ */
+enum boot_phase {
+    BOOT_PHASE_KERNEL,        /**< Kernel initialized, application initialization starts */
+    BOOT_PHASE_DISPLAY,       /**< Display initialized */
+    BOOT_PHASE_FIRST_FRAME,   /**< First frame rendered and display switched ON */
+    BOOT_PHASE_NETWORK,       /**< Network initialized */
+    BOOT_PHASE_KAMEA,         /**< Kamea client initialized */
+    BOOT_PHASE_FIRST_CONNACK, /**< First connection to Kamea acknowledged */
+    BOOT_PHASE_COUNT          /**< Number of boot phases */
+};
+
+/**
+ * @brief Record the end of a boot phase
+ * @note Only the first occurrence of each phase is recorded, this function can be called from any thread
+ * @param phase Boot phase
+ */
+void boot_profile_record(enum boot_phase phase);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __BOOT_PROFILE_H__ */
@@ -28,6 +28,8 @@
 #include <lv_conf.h>
 #include <lvgl.h>
 
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RAW
+
 #ifndef LV_ATTRIBUTE_MEM_ALIGN
 #define LV_ATTRIBUTE_MEM_ALIGN
 #endif
@@ -324,6 +326,38 @@ const lv_image_dsc_t background_screen1 = {
   .data = background_map_screen1,
 };
 
+#else
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief Background image
+ * @note The image 'img/background.png' is RLE compressed at build time by 'img/convert_background.py' and decoded into RAM by
+ *       background_decode
+ */
+extern lv_image_dsc_t background_screen1;
+
+/**
+ * @brief Background image draw buffer, sharing the decoded image with background_screen1
+ * @note It is initialized by background_decode, static elements drawn into it are part of the background afterwards
+ */
+extern lv_draw_buf_t background_draw_buf_screen1;
+
+/**
+ * @brief Decode compressed background images into RAM
+ * @note This function must be called once before using the background images
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int background_decode(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RAW */
+
 #endif /* CONFIG_DISPLAY */
 
 #endif /* __BACKGROUND_H__ */
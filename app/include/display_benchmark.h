@@ -0,0 +1,55 @@
+/**
+ * @file      display_benchmark.h
+ * @brief     Display benchmark APIs
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISPLAY_BENCHMARK_H__
+#define __DISPLAY_BENCHMARK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+/**
+ * @brief Display benchmark initialization
+ * @note Must be called from the display work queue, once the screens are created
+ */
+void display_benchmark_init(void);
+
+/**
+ * @brief Get benchmark timestamp
+ * @return Timestamp, only differences between two timestamps are meaningful
+ */
+uint32_t display_benchmark_timestamp(void);
+
+/**
+ * @brief Record duration of lv_timer_handler
+ * @note Periodically prints the benchmark report
+ * @param start Timestamp taken before calling lv_timer_handler
+ */
+void display_benchmark_record_timer_handler(uint32_t start);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __DISPLAY_BENCHMARK_H__ */
@@ -0,0 +1,90 @@
+/**
+ * @file      history.h
+ * @brief     Long-history min/max store of the wind turbine output power
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+/**
+ * @brief Number of columns kept for each timescale, one per 2 pixels of the 480 pixels wide screen 2 chart
+ */
+#define HISTORY_COLUMNS_COUNT (240)
+
+/**
+ * @brief Timescales
+ */
+enum history_timescale {
+    HISTORY_TIMESCALE_1MIN,  /**< 1 minute */
+    HISTORY_TIMESCALE_10MIN, /**< 10 minutes */
+    HISTORY_TIMESCALE_1H,    /**< 1 hour */
+    HISTORY_TIMESCALE_24H,   /**< 24 hours */
+    HISTORY_TIMESCALE_COUNT  /**< Number of timescales */
+};
+
+/**
+ * @brief Column, min/max of the values added during the column period
+ * @note A column without any value has a min greater than its max
+ */
+struct history_column {
+    uint8_t min; /**< Minimum value */
+    uint8_t max; /**< Maximum value */
+};
+
+/**
+ * @brief Add a value to the history
+ * @note This function can be called from any thread
+ * @param value Value
+ */
+void history_add(uint8_t value);
+
+/**
+ * @brief Get the number of columns completed on a timescale
+ * @param timescale Timescale
+ * @return Number of columns completed since boot, changes each time a column completes
+ */
+uint32_t history_get_completed(enum history_timescale timescale);
+
+/**
+ * @brief Read the completed columns of a timescale
+ * @param timescale Timescale
+ * @param columns Columns, from the oldest to the newest, HISTORY_COLUMNS_COUNT entries
+ * @return Number of columns completed since boot
+ */
+uint32_t history_read(enum history_timescale timescale, struct history_column *columns);
+
+/**
+ * @brief Get the name of a timescale
+ * @param timescale Timescale
+ * @return Name of the timescale
+ */
+const char *history_get_timescale_name(enum history_timescale timescale);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __HISTORY_H__ */
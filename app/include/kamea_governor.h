@@ -0,0 +1,72 @@
+/**
+ * @file      kamea_governor.h
+ * @brief     Kamea telemetry bandwidth governor
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KAMEA_GOVERNOR_H__
+#define __KAMEA_GOVERNOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Link quality
+ */
+enum kamea_governor_link {
+    KAMEA_GOVERNOR_LINK_GOOD,     /**< Telemetry is published at full rate */
+    KAMEA_GOVERNOR_LINK_DEGRADED, /**< Telemetry is published at half rate */
+    KAMEA_GOVERNOR_LINK_POOR,     /**< Telemetry is published at quarter rate */
+    KAMEA_GOVERNOR_LINK_COUNT     /**< Number of link qualities */
+};
+
+/**
+ * @brief Governor status
+ */
+struct kamea_governor_status {
+    int32_t                  budget; /**< Available budget (bytes), negative when publishes have been forced */
+    uint32_t                 rate;   /**< Budget refill rate (bytes per second) */
+    enum kamea_governor_link link;   /**< Link quality */
+};
+
+/**
+ * @brief Acquire budget to publish telemetry
+ * @note The budget is refilled at a rate depending on the link quality, computed from the RSSI, the TCP retransmits and the PUBACK round-trip time
+ * @param len Length of the telemetry to publish (bytes)
+ * @param force Consume the budget even if it is not sufficient, used when the aggregation period reaches its maximum
+ * @return true if the telemetry can be published, false if the aggregation period should be stretched
+ */
+bool kamea_governor_acquire(size_t len, bool force);
+
+/**
+ * @brief Get governor status
+ * @param status Governor status
+ */
+void kamea_governor_get_status(struct kamea_governor_status *status);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __KAMEA_GOVERNOR_H__ */
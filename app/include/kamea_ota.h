@@ -0,0 +1,76 @@
+/**
+ * @file      kamea_ota.h
+ * @brief     Kamea firmware download
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KAMEA_OTA_H__
+#define __KAMEA_OTA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Firmware download states
+ */
+enum kamea_ota_state {
+    KAMEA_OTA_STATE_IDLE,        /**< No download started since boot */
+    KAMEA_OTA_STATE_DOWNLOADING, /**< Chunks are expected from the confirmed offset */
+    KAMEA_OTA_STATE_READY,       /**< Image downloaded and verified, installed at next reboot */
+    KAMEA_OTA_STATE_ERROR,       /**< Download aborted, waiting for a new download */
+    KAMEA_OTA_STATE_COUNT        /**< Number of states */
+};
+
+/**
+ * @brief Firmware download status
+ */
+struct kamea_ota_status {
+    enum kamea_ota_state state;  /**< Download state */
+    size_t               offset; /**< Confirmed offset, chunks are accepted only at this offset (bytes) */
+    size_t               size;   /**< Size of the image, or patch, transferred (bytes) */
+    int                  error;  /**< Error code of the latest aborted download */
+};
+
+/**
+ * @brief Subscribe to the firmware download topics
+ * @note Must be called after the initialization of the Kamea MQTT client
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_ota_init(void);
+
+/**
+ * @brief Report the download status when the client is connected, so that the server resumes the download from the confirmed offset
+ */
+void kamea_ota_connected(void);
+
+/**
+ * @brief Get the download status
+ * @param status Download status
+ */
+void kamea_ota_get_status(struct kamea_ota_status *status);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __KAMEA_OTA_H__ */
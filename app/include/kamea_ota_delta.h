@@ -0,0 +1,120 @@
+/**
+ * @file      kamea_ota_delta.h
+ * @brief     Kamea firmware delta patches
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KAMEA_OTA_DELTA_H__
+#define __KAMEA_OTA_DELTA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size of the patch header (bytes)
+ * @note The format is described in 'ota/make_delta.py'
+ */
+#define KAMEA_OTA_DELTA_HEADER_SIZE (76)
+
+/**
+ * @brief Size of the buffer used to read the source image and reconstruct the target image (bytes)
+ */
+#define KAMEA_OTA_DELTA_BUFFER_SIZE (256)
+
+/**
+ * @brief Target image writer
+ * @param data Reconstructed data
+ * @param len Length of data
+ * @param flush The data are the last ones of the target image
+ * @return 0 if the function succeeds, error code otherwise
+ */
+typedef int (*kamea_ota_delta_write_t)(const uint8_t *data, size_t len, bool flush);
+
+/**
+ * @brief Patch decoder states
+ */
+enum kamea_ota_delta_state {
+    KAMEA_OTA_DELTA_STATE_HEADER,   /**< Receiving header */
+    KAMEA_OTA_DELTA_STATE_COMMAND,  /**< Expecting command */
+    KAMEA_OTA_DELTA_STATE_OFFSET,   /**< Receiving ADD source offset */
+    KAMEA_OTA_DELTA_STATE_LENGTH,   /**< Receiving ADD or INSERT length */
+    KAMEA_OTA_DELTA_STATE_ZEROS,    /**< Receiving ADD packet number of bytes copied from the source */
+    KAMEA_OTA_DELTA_STATE_COUNT,    /**< Receiving ADD packet number of diff bytes */
+    KAMEA_OTA_DELTA_STATE_DIFF,     /**< Receiving ADD packet diff bytes */
+    KAMEA_OTA_DELTA_STATE_INSERT,   /**< Receiving INSERT bytes */
+    KAMEA_OTA_DELTA_STATE_DONE      /**< Target image reconstructed */
+};
+
+/**
+ * @brief Patch decoder context, the patch is applied as it is received with this context only
+ */
+struct kamea_ota_delta {
+    enum kamea_ota_delta_state state;                               /**< Decoder state */
+    kamea_ota_delta_write_t    write;                               /**< Target image writer */
+    const uint8_t             *sha256;                              /**< Expected target image SHA-256 */
+    size_t                     max_size;                            /**< Maximum target image size (bytes) */
+    uint8_t                    header[KAMEA_OTA_DELTA_HEADER_SIZE]; /**< Header, until it is received */
+    size_t                     header_len;                          /**< Length of header received */
+    uint32_t                   source_size;                         /**< Source image size (bytes) */
+    uint32_t                   target_size;                         /**< Target image size (bytes) */
+    uint32_t                   written;                             /**< Length of target image reconstructed (bytes) */
+    uint8_t                    command;                             /**< Current command */
+    uint32_t                   source_offset;                       /**< Offset of the next source byte of the current ADD command */
+    uint32_t                   remaining;                           /**< Bytes remaining in the current command */
+    uint32_t                   count;                               /**< Bytes remaining in the current ADD packet diff bytes */
+    uint32_t                   varint;                              /**< Varint being received */
+    uint8_t                    shift;                               /**< Shift of the next varint byte */
+    uint8_t                    buffer[KAMEA_OTA_DELTA_BUFFER_SIZE]; /**< Source and target data buffer */
+};
+
+/**
+ * @brief Initialize patch decoder
+ * @param delta Patch decoder context
+ * @param max_size Maximum target image size (bytes)
+ * @param sha256 Expected target image SHA-256, must remain valid until the patch is applied
+ * @param write Target image writer
+ */
+void kamea_ota_delta_init(struct kamea_ota_delta *delta, size_t max_size, const uint8_t *sha256, kamea_ota_delta_write_t write);
+
+/**
+ * @brief Apply a slice of the patch, the source image is read from slot0_partition
+ * @param delta Patch decoder context
+ * @param data Patch slice
+ * @param len Length of patch slice
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_ota_delta_apply(struct kamea_ota_delta *delta, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check if the target image is fully reconstructed
+ * @param delta Patch decoder context
+ * @return true if the target image is reconstructed, false otherwise
+ */
+bool kamea_ota_delta_done(const struct kamea_ota_delta *delta);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __KAMEA_OTA_DELTA_H__ */
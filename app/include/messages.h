@@ -33,8 +33,9 @@ extern "C" {
  * @brief Button status
  */
 struct button_status_msg {
-    char *name;  /**< Name */
-    bool  state; /**< State */
+    char *name;       /**< Name */
+    bool  state;      /**< State */
+    bool  long_press; /**< The button has been held down for CONFIG_WIND_TURBINE_BUTTONS_LONG_PRESS_MS */
 };
 
 /**
@@ -47,6 +48,14 @@ struct wind_turbine_status_msg {
     uint16_t output_power;   /**< Output power (kilo-watts) */
 };
 
+/**
+ * @brief Wind turbine configuration
+ */
+struct wind_turbine_config_msg {
+    bool    turned_on; /**< The motor is driven if true, stopped otherwise */
+    uint8_t limiter;   /**< Maximum motor duty cycle (percent) */
+};
+
 /**
  * @brief Inverter status
  */
@@ -64,6 +73,16 @@ struct network_status_msg {
     char ip_address[32]; /**< IPv4 address, if connected is true */
 };
 
+/**
+ * @brief Network link statistics
+ */
+struct network_link_msg {
+    bool     rssi_valid;        /**< RSSI is available */
+    int8_t   rssi;              /**< Received signal strength indicator (dBm), if rssi_valid is true */
+    bool     retransmits_valid; /**< TCP retransmits are available */
+    uint32_t retransmits;       /**< TCP segments retransmitted since the previous statistics, if retransmits_valid is true */
+};
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
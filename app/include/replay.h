@@ -0,0 +1,45 @@
+/**
+ * @file      replay.h
+ * @brief     Wind profile replay APIs
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+
+/**
+ * @brief Capture a payload published to Kamea
+ * @note Captured payloads are dumped to the telemetry output file for golden-file comparison
+ * @param topic Topic suffix of the payload
+ * @param payload Payload
+ * @param len Length of payload
+ */
+void replay_capture(const char *topic, const char *payload, size_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __REPLAY_H__ */
@@ -0,0 +1,48 @@
+/**
+ * @file      soak.h
+ * @brief     Soak test APIs
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOAK_H__
+#define __SOAK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+
+/**
+ * @brief Record the result of a publish to Kamea
+ * @param result 0 if the publish succeeds, error code otherwise
+ */
+void soak_record_publish(int result);
+
+/**
+ * @brief Record a change of the Kamea connection status
+ * @param connected true if the client is connected, false otherwise
+ */
+void soak_record_connection(bool connected);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SOAK_H__ */
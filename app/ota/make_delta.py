@@ -0,0 +1,236 @@
+# @file      make_delta.py
+# @brief     Build a delta patch between two firmware images
+#
+# Copyright (C) Witekio
+#
+# This file is part of Zephyr Wind Turbine demonstration.
+#
+# This demonstration is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This demonstration is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+
+# Patch format, all integers are little-endian, varints are unsigned LEB128:
+#   magic          4 bytes "WTDP"
+#   source_size    uint32, size of the image running from slot0_partition
+#   source_sha256  32 bytes, SHA-256 of the source image
+#   target_size    uint32, size of the image to reconstruct into slot1_partition
+#   target_sha256  32 bytes, SHA-256 of the target image
+#   commands       sequence of commands until target_size bytes are produced:
+#                  - 0x00 ADD: varint source offset, varint length, then
+#                    packets until length bytes are produced: varint number of
+#                    bytes copied from the source, varint number of diff bytes,
+#                    diff bytes added (modulo 256) to the next source bytes
+#                  - 0x01 INSERT: varint length, then length bytes
+#
+# ADD commands cover source regions matching the target except for sparse
+# bytes, such as code shifted by an application change where only branch and
+# literal addresses differ, INSERT commands cover new data. The device applies
+# the patch while it is received, reading the source from flash, so that its
+# RAM usage does not depend on the image size.
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+MAGIC = b'WTDP'
+ADD = 0x00
+INSERT = 0x01
+
+# Length of the seeds indexed in the source, and minimum exact match to start an ADD command
+SEED = 8
+MIN_MATCH = 16
+# Maximum number of candidates checked per seed
+MAX_CANDIDATES = 16
+# ADD commands are extended while the score (matching bytes - mismatching bytes) is not lower than the best one by this margin
+MARGIN = 32
+# Shortest run of unchanged bytes worth a new packet in ADD commands
+MIN_ZEROS = 3
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def read_varint(data, pos):
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if value >> 32:
+            # Rejected by the device, values are 32 bits
+            raise ValueError(f"varint at offset {pos - 1} exceeds 32 bits")
+        if not byte & 0x80:
+            return value, pos
+
+
+def index_source(source):
+    index = {}
+    for pos in range(0, len(source) - SEED + 1):
+        candidates = index.setdefault(source[pos:pos + SEED], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+    return index
+
+
+def match_length(source, spos, target, tpos):
+    length = 0
+    while spos + length < len(source) and tpos + length < len(target) and source[spos + length] == target[tpos + length]:
+        length += 1
+    return length
+
+
+def find_match(source, target, tpos, index, shift):
+    # Prefer the offset of the previous match, code following a change is usually shifted by the same amount
+    best, best_len = None, 0
+    candidates = index.get(target[tpos:tpos + SEED], [])
+    if 0 <= tpos + shift < len(source):
+        candidates = [tpos + shift] + candidates
+    for spos in candidates:
+        length = match_length(source, spos, target, tpos)
+        if length > best_len:
+            best, best_len = spos, length
+    return best if best_len >= MIN_MATCH else None
+
+
+def extend(source, spos, target, tpos):
+    score, best, end = 0, 0, 0
+    length = 0
+    while spos + length < len(source) and tpos + length < len(target):
+        score += 1 if source[spos + length] == target[tpos + length] else -1
+        length += 1
+        if score > best:
+            best, end = score, length
+        elif best - score > MARGIN:
+            break
+    return end
+
+
+def encode_add(source, spos, target, tpos, length):
+    out = bytearray([ADD]) + varint(spos) + varint(length)
+    diff = bytes((target[tpos + i] - source[spos + i]) & 0xff for i in range(length))
+    pos = 0
+    while pos < length:
+        zeros = 0
+        while pos + zeros < length and diff[pos + zeros] == 0:
+            zeros += 1
+        end = pos + zeros
+        # Diff bytes run until a run of unchanged bytes long enough to start a new packet
+        literal_end = end
+        while literal_end < length:
+            run = 0
+            while literal_end + run < length and diff[literal_end + run] == 0 and run < MIN_ZEROS:
+                run += 1
+            if run >= MIN_ZEROS or literal_end + run == length:
+                break
+            literal_end += run + 1
+        out += varint(zeros) + varint(literal_end - end) + diff[end:literal_end]
+        pos = literal_end
+    return bytes(out)
+
+
+def encode_insert(data):
+    return bytes([INSERT]) + varint(len(data)) + data
+
+
+def make_delta(source, target):
+    index = index_source(source)
+    commands = []
+    tpos, insert_start, shift = 0, 0, 0
+    while tpos < len(target):
+        spos = find_match(source, target, tpos, index, shift) if tpos + SEED <= len(target) else None
+        if spos is None:
+            tpos += 1
+            continue
+        length = extend(source, spos, target, tpos)
+        if tpos > insert_start:
+            commands.append(encode_insert(target[insert_start:tpos]))
+        commands.append(encode_add(source, spos, target, tpos, length))
+        shift = spos - tpos
+        tpos += length
+        insert_start = tpos
+    if len(target) > insert_start:
+        commands.append(encode_insert(target[insert_start:]))
+
+    header = MAGIC + struct.pack('<I', len(source)) + hashlib.sha256(source).digest()
+    header += struct.pack('<I', len(target)) + hashlib.sha256(target).digest()
+    return header + b''.join(commands)
+
+
+def apply_delta(source, patch):
+    if patch[0:4] != MAGIC:
+        raise ValueError("invalid magic")
+    source_size, = struct.unpack_from('<I', patch, 4)
+    target_size, = struct.unpack_from('<I', patch, 40)
+    if source_size != len(source) or hashlib.sha256(source).digest() != patch[8:40]:
+        raise ValueError("patch does not apply to the source image")
+    target = bytearray()
+    pos = 76
+    while len(target) < target_size:
+        op = patch[pos]
+        pos += 1
+        if op == ADD:
+            spos, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            end = len(target) + length
+            while len(target) < end:
+                zeros, pos = read_varint(patch, pos)
+                count, pos = read_varint(patch, pos)
+                target += source[spos:spos + zeros]
+                spos += zeros
+                target += bytes((source[spos + i] + patch[pos + i]) & 0xff for i in range(count))
+                spos += count
+                pos += count
+        elif op == INSERT:
+            length, pos = read_varint(patch, pos)
+            target += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"invalid command 0x{op:02x}")
+    if pos != len(patch) or hashlib.sha256(target).digest() != patch[44:76]:
+        raise ValueError("invalid patch")
+    return bytes(target)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Build a delta patch between two firmware images")
+    parser.add_argument("--verify", action="store_true", help="apply the patch to the source image and compare with the target image")
+    parser.add_argument("source", help="image running on the device, signed MCUboot image of slot0_partition")
+    parser.add_argument("target", help="new image, signed MCUboot image")
+    parser.add_argument("output", help="patch file")
+    args = parser.parse_args()
+
+    with open(args.source, 'rb') as f:
+        source = f.read()
+    with open(args.target, 'rb') as f:
+        target = f.read()
+
+    patch = make_delta(source, target)
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+
+    print(f"[make_delta]: {os.path.relpath(args.source)} + {os.path.relpath(args.output)} -> {os.path.relpath(args.target)}, "
+          f"{len(target)} -> {len(patch)} bytes ({100 * len(patch) / max(len(target), 1):.1f}%)")
+
+    if args.verify and apply_delta(source, patch) != target:
+        sys.exit("Patch verification failed")
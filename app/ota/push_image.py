@@ -0,0 +1,136 @@
+# @file      push_image.py
+# @brief     Push a firmware image to a device through the Kamea firmware download topics
+#
+# Copyright (C) Witekio
+#
+# This file is part of Zephyr Wind Turbine demonstration.
+#
+# This demonstration is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This demonstration is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+
+# Firmware download protocol, topics are relative to 'device/<client_id>/':
+#   ota/start    JSON request { "size": <bytes>, "sha256": "<hex>", "delta":
+#                <bool> }, starts a new download, or resumes the download in
+#                progress when the same image is requested again, the size is
+#                the one of the data transferred, the SHA-256 the one of the
+#                image, and delta is set when a patch built by make_delta.py is
+#                transferred instead of the image
+#   ota/chunk    uint32 little-endian offset of the data in the image, followed
+#                by the data, only accepted at the confirmed offset
+#   telemetries  the device publishes { "ota": { "state", "offset", "size",
+#                "error" } } after the download request, after each chunk and
+#                on reconnection, the next chunk is sent from the offset
+#
+# Requires the paho-mqtt package.
+
+import argparse
+import hashlib
+import json
+import os
+import struct
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+RESEND_TIMEOUT = 10
+
+
+class Pusher:
+    def __init__(self, args, image):
+        self.args = args
+        self.image = image
+        self.topic = f"device/{args.client_id}/"
+        self.offset = None
+        self.sent = None
+        self.sent_time = 0
+        self.result = None
+        self.done = threading.Event()
+        self.start = time.monotonic()
+
+    def request(self, client):
+        request = {"size": len(self.image), "sha256": hashlib.sha256(self.image).hexdigest()}
+        if self.args.patch:
+            # The target image SHA-256 is given by the patch header
+            request.update({"sha256": self.image[44:76].hex(), "delta": True})
+        client.publish(self.topic + "ota/start", json.dumps(request), qos=1)
+
+    def send(self, client, offset):
+        # Send a single chunk at a time, the next one is sent when the offset is confirmed
+        data = self.image[offset:offset + self.args.chunk_size]
+        client.publish(self.topic + "ota/chunk", struct.pack('<I', offset) + data, qos=1)
+        self.sent, self.sent_time = offset, time.monotonic()
+
+    def on_connect(self, client, userdata, flags, rc, properties=None):
+        client.subscribe(self.topic + "telemetries", qos=1)
+        self.request(client)
+
+    def on_message(self, client, userdata, message):
+        try:
+            status = json.loads(message.payload)["ota"]
+        except (ValueError, KeyError, TypeError):
+            return
+        self.offset = status["offset"]
+        elapsed = time.monotonic() - self.start
+        print(f"\r{status['state']}: {self.offset}/{len(self.image)} bytes, "
+              f"{self.offset / 1024 / max(elapsed, 0.001):.1f} KiB/s", end="", flush=True)
+        if status["state"] == "downloading":
+            if self.offset != self.sent:
+                self.send(client, self.offset)
+        elif status["state"] in ("ready", "error"):
+            print(f"\nDownload {status['state']}, error {status['error']}")
+            self.result = status["state"] == "ready"
+            self.done.set()
+
+    def run(self, client):
+        # Resend the chunk at the confirmed offset if no status is received, it may have been lost during a disconnection
+        while not self.done.wait(1):
+            if self.sent is not None and time.monotonic() - self.sent_time > RESEND_TIMEOUT:
+                print(f"\nNo status received, resending chunk at offset {self.offset}")
+                self.send(client, self.offset)
+        return self.result
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Push a firmware image through the Kamea firmware download topics")
+    parser.add_argument("--host", default="localhost", help="MQTT broker host")
+    parser.add_argument("--port", type=int, default=8883, help="MQTT broker port")
+    parser.add_argument("--cafile", help="broker CA certificate, TLS is disabled if not set")
+    parser.add_argument("--cert", help="client certificate")
+    parser.add_argument("--key", help="client private key")
+    parser.add_argument("--client-id", default="wind_turbine_stm32f746g_disco", help="device client ID")
+    parser.add_argument("--chunk-size", type=int, default=1024, help="size of the chunks data (bytes)")
+    parser.add_argument("--patch", action="store_true", help="the image is a patch built by make_delta.py")
+    parser.add_argument("image", help="firmware image, signed MCUboot image for the update slot")
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    print(f"[push_image]: {os.path.relpath(args.image)}, {len(image)} bytes, SHA-256 {hashlib.sha256(image).hexdigest()}")
+
+    pusher = Pusher(args, image)
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:
+        client = mqtt.Client()
+    if args.cafile:
+        client.tls_set(ca_certs=args.cafile, certfile=args.cert, keyfile=args.key)
+    client.on_connect = pusher.on_connect
+    client.on_message = pusher.on_message
+    client.connect(args.host, args.port)
+    client.loop_start()
+    result = pusher.run(client)
+    client.loop_stop()
+
+    sys.exit(0 if result else 1)
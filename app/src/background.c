@@ -0,0 +1,272 @@
+/**
+ * @file      background.c
+ * @brief     Decoding of compressed background images
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_background, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/linker/devicetree_regions.h>
+#include <zephyr/sys/byteorder.h>
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_STORAGE
+#include <zephyr/storage/flash_map.h>
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_STORAGE */
+
+#include "display/background.h"
+
+/**
+ * @brief Background image resolution (pixels)
+ */
+#define BACKGROUND_WIDTH  (480)
+#define BACKGROUND_HEIGHT (272)
+
+/**
+ * @brief Compressed image magic, header size and packet control word run flag
+ * @note The format is described in 'img/convert_background.py'
+ */
+#define BACKGROUND_MAGIC       "WTBG"
+#define BACKGROUND_HEADER_SIZE (12)
+#define BACKGROUND_RUN         (0x8000)
+
+/**
+ * @brief Size of the chunks read from the compressed image (bytes)
+ */
+#define BACKGROUND_CHUNK_SIZE (256)
+
+/**
+ * @brief Decoded image placement, SDRAM when available
+ */
+#if DT_NODE_EXISTS(DT_NODELABEL(sdram1))
+#define BACKGROUND_SECTION Z_GENERIC_SECTION(LINKER_DT_NODE_REGION_NAME(DT_NODELABEL(sdram1)))
+#else
+#define BACKGROUND_SECTION
+#endif
+
+/**
+ * @brief Decoder context
+ */
+struct background_decoder {
+    uint16_t *dst;       /**< Next pixel to write */
+    size_t    remaining; /**< Number of pixels remaining to write */
+    uint32_t  count;     /**< Number of pixels remaining in the current packet, 0 if a control word is expected */
+    bool      run;       /**< The current packet is a run */
+    uint8_t   byte;      /**< First byte of a word split between two chunks */
+    bool      split;     /**< A word is split between two chunks */
+};
+
+/**
+ * @brief Read compressed image
+ * @param offset Offset in the compressed image
+ * @param buf Buffer
+ * @param len Number of bytes to read
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int background_read(size_t offset, void *buf, size_t len);
+
+/**
+ * @brief Decode a chunk of the compressed image payload
+ * @param decoder Decoder context
+ * @param data Chunk
+ * @param len Length of the chunk
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int background_decode_chunk(struct background_decoder *decoder, const uint8_t *data, size_t len);
+
+/**
+ * @brief Decode a word of the compressed image payload
+ * @param decoder Decoder context
+ * @param word Word
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int background_decode_word(struct background_decoder *decoder, uint16_t word);
+
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RLE
+
+/**
+ * @brief Compressed background image, generated at build time
+ */
+extern const uint8_t  background_rle_screen1[];
+extern const uint32_t background_rle_screen1_len;
+
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RLE */
+
+/**
+ * @brief Decoded background image
+ */
+static uint16_t background_map_screen1[BACKGROUND_WIDTH * BACKGROUND_HEIGHT] __aligned(4) BACKGROUND_SECTION;
+
+lv_draw_buf_t background_draw_buf_screen1;
+
+lv_image_dsc_t background_screen1 = {
+    .header.cf     = LV_COLOR_FORMAT_RGB565,
+    .header.magic  = LV_IMAGE_HEADER_MAGIC,
+    .header.w      = BACKGROUND_WIDTH,
+    .header.h      = BACKGROUND_HEIGHT,
+    .header.stride = BACKGROUND_WIDTH * sizeof(uint16_t),
+    .data_size     = sizeof(background_map_screen1),
+    .data          = (const uint8_t *)background_map_screen1,
+};
+
+int
+background_decode(void) {
+
+    uint8_t                   chunk[BACKGROUND_CHUNK_SIZE];
+    struct background_decoder decoder = { .dst = background_map_screen1, .remaining = ARRAY_SIZE(background_map_screen1) };
+    uint32_t                  start   = k_cycle_get_32();
+    size_t                    offset, len, payload_len;
+    int                       res;
+
+    /* Describe the decoded image as a draw buffer, static elements can then be composed into it */
+    lv_draw_buf_init(&background_draw_buf_screen1,
+                     BACKGROUND_WIDTH,
+                     BACKGROUND_HEIGHT,
+                     LV_COLOR_FORMAT_RGB565,
+                     BACKGROUND_WIDTH * sizeof(uint16_t),
+                     background_map_screen1,
+                     sizeof(background_map_screen1));
+
+    /* Read and check header */
+    if (0 != (res = background_read(0, chunk, BACKGROUND_HEADER_SIZE))) {
+        LOG_ERR("Unable to read background image, error %d", res);
+        return res;
+    }
+    if ((0 != memcmp(chunk, BACKGROUND_MAGIC, strlen(BACKGROUND_MAGIC))) || (BACKGROUND_WIDTH != sys_get_le16(&chunk[4]))
+        || (BACKGROUND_HEIGHT != sys_get_le16(&chunk[6]))) {
+        LOG_ERR("Invalid background image");
+        return -EINVAL;
+    }
+    payload_len = sys_get_le32(&chunk[8]);
+
+    /* Decode payload chunk by chunk */
+    for (offset = 0; offset < payload_len; offset += len) {
+        len = MIN(payload_len - offset, sizeof(chunk));
+        if (0 != (res = background_read(BACKGROUND_HEADER_SIZE + offset, chunk, len))) {
+            LOG_ERR("Unable to read background image, error %d", res);
+            return res;
+        }
+        if (0 != (res = background_decode_chunk(&decoder, chunk, len))) {
+            LOG_ERR("Invalid background image payload");
+            return res;
+        }
+    }
+    if ((0 != decoder.remaining) || (0 != decoder.count) || (true == decoder.split)) {
+        LOG_ERR("Truncated background image payload");
+        return -EINVAL;
+    }
+
+    LOG_INF("Background image decoded in %u us, %u bytes compressed to %u bytes",
+            k_cyc_to_us_floor32(k_cycle_get_32() - start),
+            (uint32_t)sizeof(background_map_screen1),
+            (uint32_t)(BACKGROUND_HEADER_SIZE + payload_len));
+
+    return 0;
+}
+
+static int
+background_read(size_t offset, void *buf, size_t len) {
+
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RLE
+
+    /* Compressed image is embedded in the application */
+    if (offset + len > background_rle_screen1_len) {
+        return -EINVAL;
+    }
+    memcpy(buf, &background_rle_screen1[offset], len);
+
+    return 0;
+
+#else
+
+    const struct flash_area *fa;
+    int                      res;
+
+    /* Compressed image is stored in the storage partition */
+    if (0 != (res = flash_area_open(FIXED_PARTITION_ID(storage_partition), &fa))) {
+        return res;
+    }
+    res = flash_area_read(fa, CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_STORAGE_OFFSET + offset, buf, len);
+    flash_area_close(fa);
+
+    return res;
+
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RLE */
+}
+
+static int
+background_decode_chunk(struct background_decoder *decoder, const uint8_t *data, size_t len) {
+
+    size_t index = 0;
+    int    res;
+
+    /* Complete the word split between the previous chunk and this one */
+    if ((true == decoder->split) && (len > 0)) {
+        decoder->split = false;
+        if (0 != (res = background_decode_word(decoder, decoder->byte | (data[0] << 8)))) {
+            return res;
+        }
+        index = 1;
+    }
+
+    /* Decode words */
+    for (; index + 1 < len; index += 2) {
+        if (0 != (res = background_decode_word(decoder, sys_get_le16(&data[index])))) {
+            return res;
+        }
+    }
+
+    /* Keep the first byte of a split word */
+    if (index < len) {
+        decoder->byte  = data[index];
+        decoder->split = true;
+    }
+
+    return 0;
+}
+
+static int
+background_decode_word(struct background_decoder *decoder, uint16_t word) {
+
+    /* Control word */
+    if (0 == decoder->count) {
+        decoder->run   = (0 != (word & BACKGROUND_RUN));
+        decoder->count = (word & ~BACKGROUND_RUN) + 1;
+        if (decoder->count > decoder->remaining) {
+            return -EINVAL;
+        }
+        decoder->remaining -= decoder->count;
+        return 0;
+    }
+
+    /* Run or literal pixel */
+    if (true == decoder->run) {
+        for (; decoder->count > 0; decoder->count--) {
+            *decoder->dst++ = word;
+        }
+    } else {
+        *decoder->dst++ = word;
+        decoder->count--;
+    }
+
+    return 0;
+}
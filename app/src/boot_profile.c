@@ -0,0 +1,117 @@
+/**
+ * @file      boot_profile.c
+ * @brief     Boot phases profiling
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_boot_profile, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/atomic.h>
+
+#include "boot_profile.h"
+
+/**
+ * @brief Boot profiling initialization
+ * @note Records the end of the kernel initialization, must be the first application initialization
+ * @return Always returns 0
+ */
+static int boot_profile_init(void);
+
+/**
+ * @brief Shell command used to display the boot phases timestamps
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Always returns 0
+ */
+static int boot_profile_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Names of the boot phases
+ */
+static const char *boot_profile_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_KERNEL]        = "kernel",
+    [BOOT_PHASE_DISPLAY]       = "display",
+    [BOOT_PHASE_FIRST_FRAME]   = "first frame",
+    [BOOT_PHASE_NETWORK]       = "network",
+    [BOOT_PHASE_KAMEA]         = "kamea",
+    [BOOT_PHASE_FIRST_CONNACK] = "first connack",
+};
+
+/**
+ * @brief Timestamps of the boot phases (microseconds since boot)
+ */
+static uint32_t boot_profile_timestamps[BOOT_PHASE_COUNT];
+
+/**
+ * @brief Boot phases recorded
+ */
+static ATOMIC_DEFINE(boot_profile_recorded, BOOT_PHASE_COUNT);
+
+void
+boot_profile_record(enum boot_phase phase) {
+
+    uint32_t timestamp = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+
+    /* Record first occurrence only */
+    if (false == atomic_test_and_set_bit(boot_profile_recorded, phase)) {
+        boot_profile_timestamps[phase] = timestamp;
+        LOG_INF("Boot phase '%s' completed at %u.%03u ms", boot_profile_names[phase], timestamp / 1000, timestamp % 1000);
+    }
+}
+
+static int
+boot_profile_init(void) {
+
+    /* Kernel is initialized */
+    boot_profile_record(BOOT_PHASE_KERNEL);
+
+    return 0;
+}
+
+static int
+boot_profile_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    /* Display boot phases timestamps */
+    for (int phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        if (true == atomic_test_bit(boot_profile_recorded, phase)) {
+            shell_print(sh, "%-14s %8u.%03u ms", boot_profile_names[phase], boot_profile_timestamps[phase] / 1000, boot_profile_timestamps[phase] % 1000);
+        } else {
+            shell_print(sh, "%-14s %12s", boot_profile_names[phase], "-");
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Shell command definition
+ */
+SHELL_CMD_REGISTER(boot, NULL, "Display boot phases timestamps", boot_profile_cmd);
+
+/**
+ * @brief Initialization of boot profiling, before any other application initialization
+ */
+SYS_INIT(boot_profile_init, APPLICATION, 0);
@@ -20,10 +20,18 @@
  * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(wind_turbine_buttons, LOG_LEVEL_INF);
 
+#include <zephyr/kernel.h>
+#include <zephyr/input/input.h>
+#ifdef CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/shell/shell.h>
+#endif /* CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL */
 #include <zephyr/zbus/zbus.h>
 
 #include "messages.h"
@@ -38,6 +46,54 @@ LOG_MODULE_REGISTER(wind_turbine_buttons, LOG_LEVEL_INF);
  */
 #define BUTTONS_WORK_QUEUE_PRIORITY (5)
 
+/**
+ * @brief Top button
+ */
+#define WIND_TURBINE_TOP_BUTTON_NODE DT_ALIAS(wind_turbine_top_button)
+#if !DT_NODE_HAS_STATUS_OKAY(WIND_TURBINE_TOP_BUTTON_NODE)
+#error "wind-turbine-top-button devicetree alias is not defined"
+#endif
+
+/**
+ * @brief Bottom button
+ */
+#define WIND_TURBINE_BOTTOM_BUTTON_NODE DT_ALIAS(wind_turbine_bottom_button)
+#if !DT_NODE_HAS_STATUS_OKAY(WIND_TURBINE_BOTTOM_BUTTON_NODE)
+#error "wind-turbine-bottom-button devicetree alias is not defined"
+#endif
+
+/**
+ * @brief Button definition, keys are debounced by the gpio-keys input driver (debounce-interval-ms devicetree property)
+ * @param node Devicetree node of the key
+ * @param key_name Name of the key, published in the button status
+ */
+#define BUTTONS_KEY(node, key_name)                                                                                                                            \
+    {                                                                                                                                                          \
+        .name = key_name, .code = DT_PROP(node, zephyr_code),                                                                                                 \
+        IF_ENABLED(CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL, (.gpio = GPIO_DT_SPEC_GET(node, gpios), ))                                                      \
+    }
+
+/**
+ * @brief Button
+ */
+struct buttons_key {
+    const char *name; /**< Name */
+    uint16_t    code; /**< Input event code */
+#ifdef CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL
+    struct gpio_dt_spec gpio; /**< GPIO of the key, used to simulate bounces */
+#endif /* CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL */
+    atomic_t                state;              /**< Debounced state, updated by the input callback */
+    bool                    pressed;            /**< Set by the input callback on press, cleared once the press is published */
+    struct k_spinlock       lock;               /**< Lock used to update the state and the pressed flag together */
+    bool                    published_state;    /**< Last published state */
+    atomic_t                last_publish;       /**< Uptime of the last publish (milliseconds) */
+    struct k_work_delayable publish_work;       /**< Work used to publish the state, delayed to limit the publish rate */
+    struct k_work_delayable long_press_work;    /**< Work used to detect long press */
+    atomic_t                events_count;       /**< Number of input events received */
+    atomic_t                publish_count;      /**< Number of button status published */
+    atomic_t                long_press_count;   /**< Number of long press detected */
+};
+
 /**
  * @brief Buttons initialization
  * @return 0 if the function succeeds, error code otherwise
@@ -45,32 +101,53 @@ LOG_MODULE_REGISTER(wind_turbine_buttons, LOG_LEVEL_INF);
 static int buttons_init(void);
 
 /**
- * @brief Top button pressed callback
- * @param port Device struct for the GPIO device
- * @param cb Original struct gpio_callback owning this handler
- * @param pins Mask of pins that triggers the callback handler
+ * @brief Input event callback
+ * @param evt Input event
+ * @param user_data User data (not used)
  */
-static void buttons_top_button_pressed_cb(const struct device *port, struct gpio_callback *cb, uint32_t pins);
+static void buttons_input_callback(struct input_event *evt, void *user_data);
 
 /**
- * @brief Bottom button pressed callback
- * @param port Device struct for the GPIO device
- * @param cb Original struct gpio_callback owning this handler
- * @param pins Mask of pins that triggers the callback handler
+ * @brief Function used to publish the state of a button
+ * @param handle Work handler
  */
-static void buttons_bottom_button_pressed_cb(const struct device *port, struct gpio_callback *cb, uint32_t pins);
+static void buttons_publish_work_handler(struct k_work *handle);
 
 /**
- * @brief Function used to handle top button work
+ * @brief Function used to detect long press of a button
  * @param handle Work handler
  */
-static void buttons_top_button_work_handler(struct k_work *handle);
+static void buttons_long_press_work_handler(struct k_work *handle);
 
 /**
- * @brief Function used to handle bottom button work
- * @param handle Work handler
+ * @brief Publish button status
+ * @param key Button
+ * @param state Button state
+ * @param long_press Long press
+ */
+static void buttons_publish(struct buttons_key *key, bool state, bool long_press);
+
+#ifdef CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL
+
+/**
+ * @brief Shell command used to display buttons statistics
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Always returns 0
+ */
+static int buttons_stats_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Shell command used to simulate a bounce storm on a button with the GPIO emulator
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: button index, number of toggles, period between toggles (microseconds)
+ * @return 0 if the function succeeds, error code otherwise
  */
-static void buttons_bottom_button_work_handler(struct k_work *handle);
+static int buttons_bounce_cmd(const struct shell *sh, size_t argc, char **argv);
+
+#endif /* CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL */
 
 /**
  * @brief Buttons work queue stack
@@ -88,74 +165,33 @@ static struct k_work_q buttons_work_queue_handle;
 ZBUS_CHAN_DEFINE(buttons_status_chan, struct button_status_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
 
 /**
- * @brief Top button
+ * @brief Buttons table
  */
-#define WIND_TURBINE_TOP_BUTTON_NODE DT_ALIAS(wind_turbine_top_button)
-#if !DT_NODE_HAS_STATUS_OKAY(WIND_TURBINE_TOP_BUTTON_NODE)
-#error "wind-turbine-top-button devicetree alias is not defined"
-#endif
-static const struct gpio_dt_spec buttons_top_button = GPIO_DT_SPEC_GET_OR(WIND_TURBINE_TOP_BUTTON_NODE, gpios, { 0 });
-static struct gpio_callback      buttons_top_button_cb_data;
-static bool                      buttons_top_button_state = false;
-static struct k_work             buttons_top_button_work_handle;
+static struct buttons_key buttons_keys[] = {
+    BUTTONS_KEY(WIND_TURBINE_TOP_BUTTON_NODE, "Wind Turbine Top Button"),
+    BUTTONS_KEY(WIND_TURBINE_BOTTOM_BUTTON_NODE, "Wind Turbine Bottom Button"),
+};
 
 /**
- * @brief Bottom button
+ * @brief Input callback definition, the buttons are handled by the gpio-keys input device
  */
-#define WIND_TURBINE_BOTTOM_BUTTON_NODE DT_ALIAS(wind_turbine_bottom_button)
-#if !DT_NODE_HAS_STATUS_OKAY(WIND_TURBINE_BOTTOM_BUTTON_NODE)
-#error "wind-turbine-bottom-button devicetree alias is not defined"
-#endif
-static const struct gpio_dt_spec buttons_bottom_button = GPIO_DT_SPEC_GET_OR(WIND_TURBINE_BOTTOM_BUTTON_NODE, gpios, { 0 });
-static struct gpio_callback      buttons_bottom_button_cb_data;
-static bool                      buttons_bottom_button_state = false;
-static struct k_work             buttons_bottom_button_work_handle;
+INPUT_CALLBACK_DEFINE(DEVICE_DT_GET(DT_PARENT(WIND_TURBINE_TOP_BUTTON_NODE)), buttons_input_callback, NULL);
 
 static int
 buttons_init(void) {
 
-    int result;
-
     LOG_INF("Initializing buttons...");
 
     /* Initialize work queue handler */
     k_work_queue_init(&buttons_work_queue_handle);
     k_work_queue_start(&buttons_work_queue_handle, buttons_work_queue_stack, BUTTONS_WORK_QUEUE_STACK_SIZE, BUTTONS_WORK_QUEUE_PRIORITY, NULL);
     k_thread_name_set(k_work_queue_thread_get(&buttons_work_queue_handle), "buttons_work_queue");
-    k_work_init(&buttons_top_button_work_handle, buttons_top_button_work_handler);
-    k_work_init(&buttons_bottom_button_work_handle, buttons_bottom_button_work_handler);
 
-    /* Configure top button */
-    if (!gpio_is_ready_dt(&buttons_top_button)) {
-        LOG_ERR("Unable to configure top button '%s', device is not ready", buttons_top_button.port->name);
-        return -1;
-    }
-    if (0 != (result = gpio_pin_configure_dt(&buttons_top_button, GPIO_INPUT))) {
-        LOG_ERR("Unable to configure top button '%s', unable to configure pin, result = %d", buttons_top_button.port->name, result);
-        return -1;
+    /* Initialize buttons */
+    for (int index = 0; index < ARRAY_SIZE(buttons_keys); index++) {
+        k_work_init_delayable(&buttons_keys[index].publish_work, buttons_publish_work_handler);
+        k_work_init_delayable(&buttons_keys[index].long_press_work, buttons_long_press_work_handler);
     }
-    if (0 != (result = gpio_pin_interrupt_configure_dt(&buttons_top_button, GPIO_INT_EDGE_BOTH))) {
-        LOG_ERR("Unable to configure top button '%s', unable to configure interrupt, result = %d", buttons_top_button.port->name, result);
-        return -1;
-    }
-    gpio_init_callback(&buttons_top_button_cb_data, buttons_top_button_pressed_cb, BIT(buttons_top_button.pin));
-    gpio_add_callback(buttons_top_button.port, &buttons_top_button_cb_data);
-
-    /* Configure bottom button */
-    if (!gpio_is_ready_dt(&buttons_bottom_button)) {
-        LOG_ERR("Unable to configure bottom button '%s', device is not ready", buttons_bottom_button.port->name);
-        return -1;
-    }
-    if (0 != (result = gpio_pin_configure_dt(&buttons_bottom_button, GPIO_INPUT))) {
-        LOG_ERR("Unable to configure bottom button '%s', unable to configure pin, result = %d", buttons_bottom_button.port->name, result);
-        return -1;
-    }
-    if (0 != (result = gpio_pin_interrupt_configure_dt(&buttons_bottom_button, GPIO_INT_EDGE_BOTH))) {
-        LOG_ERR("Unable to configure bottom button '%s', unable to configure interrupt, result = %d", buttons_bottom_button.port->name, result);
-        return -1;
-    }
-    gpio_init_callback(&buttons_bottom_button_cb_data, buttons_bottom_button_pressed_cb, BIT(buttons_bottom_button.pin));
-    gpio_add_callback(buttons_bottom_button.port, &buttons_bottom_button_cb_data);
 
     LOG_INF("Initializing buttons: DONE");
 
@@ -163,73 +199,172 @@ buttons_init(void) {
 }
 
 static void
-buttons_top_button_pressed_cb(const struct device *port, struct gpio_callback *cb, uint32_t pins) {
+buttons_input_callback(struct input_event *evt, void *user_data) {
 
-    ARG_UNUSED(port);
-    ARG_UNUSED(cb);
-    ARG_UNUSED(pins);
+    ARG_UNUSED(user_data);
+    struct buttons_key *key = NULL;
+    int32_t             delay;
+    k_spinlock_key_t    lock;
 
-    /* Submit the work to the work queue */
-    if (k_work_submit_to_queue(&buttons_work_queue_handle, &buttons_top_button_work_handle) < 0) {
-        LOG_ERR("Unable to submit work to the work queue");
+    /* Retrieve button */
+    if (INPUT_EV_KEY != evt->type) {
+        return;
+    }
+    for (int index = 0; index < ARRAY_SIZE(buttons_keys); index++) {
+        if (evt->code == buttons_keys[index].code) {
+            key = &buttons_keys[index];
+            break;
+        }
+    }
+    if (NULL == key) {
+        return;
+    }
+    atomic_inc(&key->events_count);
+    lock = k_spin_lock(&key->lock);
+    atomic_set(&key->state, (0 != evt->value) ? 1 : 0);
+    key->pressed |= (0 != evt->value);
+    k_spin_unlock(&key->lock, lock);
+
+    /* Start or stop long press detection */
+    if (0 != evt->value) {
+        k_work_reschedule_for_queue(&buttons_work_queue_handle, &key->long_press_work, K_MSEC(CONFIG_WIND_TURBINE_BUTTONS_LONG_PRESS_MS));
+    } else {
+        k_work_cancel_delayable(&key->long_press_work);
     }
+
+    /* Publish the state, at most once per interval, events received meanwhile are coalesced */
+    delay = (int32_t)(atomic_get(&key->last_publish) + CONFIG_WIND_TURBINE_BUTTONS_MIN_INTERVAL_MS - k_uptime_get_32());
+    k_work_schedule_for_queue(&buttons_work_queue_handle, &key->publish_work, K_MSEC(CLAMP(delay, 0, CONFIG_WIND_TURBINE_BUTTONS_MIN_INTERVAL_MS)));
 }
 
 static void
-buttons_bottom_button_pressed_cb(const struct device *port, struct gpio_callback *cb, uint32_t pins) {
-
-    ARG_UNUSED(port);
-    ARG_UNUSED(cb);
-    ARG_UNUSED(pins);
+buttons_publish_work_handler(struct k_work *handle) {
+
+    struct k_work_delayable *work = k_work_delayable_from_work(handle);
+    struct buttons_key      *key  = CONTAINER_OF(work, struct buttons_key, publish_work);
+    k_spinlock_key_t         lock;
+    bool                     state, pressed;
+
+    /* Retrieve the latest state and whether the button has been pressed since the last publish */
+    lock         = k_spin_lock(&key->lock);
+    state        = (0 != atomic_get(&key->state));
+    pressed      = key->pressed;
+    key->pressed = false;
+    k_spin_unlock(&key->lock, lock);
+
+    /* Publish the press coalesced during the interval, preceded by the release if the button was published pressed, so that it is not lost */
+    if (true == pressed) {
+        if (true == key->published_state) {
+            buttons_publish(key, false, false);
+        }
+        buttons_publish(key, true, false);
+    }
 
-    /* Submit the work to the work queue */
-    if (k_work_submit_to_queue(&buttons_work_queue_handle, &buttons_bottom_button_work_handle) < 0) {
-        LOG_ERR("Unable to submit work to the work queue");
+    /* Publish the latest state if it has changed */
+    if (state != key->published_state) {
+        buttons_publish(key, state, false);
     }
 }
 
 static void
-buttons_top_button_work_handler(struct k_work *handle) {
+buttons_long_press_work_handler(struct k_work *handle) {
 
-    ARG_UNUSED(handle);
-    struct button_status_msg button_status_msg = { 0 };
+    struct k_work_delayable *work = k_work_delayable_from_work(handle);
+    struct buttons_key      *key  = CONTAINER_OF(work, struct buttons_key, long_press_work);
 
-    /* Check button state */
-    if ((false == buttons_top_button_state) && (1 == gpio_pin_get_dt(&buttons_top_button))) {
-        buttons_top_button_state = true;
-    } else if ((true == buttons_top_button_state) && (0 == gpio_pin_get_dt(&buttons_top_button))) {
-        buttons_top_button_state = false;
-    } else {
-        return;
+    /* Publish long press if the button is still pressed */
+    if (0 != atomic_get(&key->state)) {
+        atomic_inc(&key->long_press_count);
+        buttons_publish(key, true, true);
     }
+}
+
+static void
+buttons_publish(struct buttons_key *key, bool state, bool long_press) {
+
+    struct button_status_msg button_status_msg = { 0 };
 
     /* Send button status */
-    button_status_msg.name  = "Wind Turbine Top Button";
-    button_status_msg.state = buttons_top_button_state;
+    button_status_msg.name       = (char *)key->name;
+    button_status_msg.state      = state;
+    button_status_msg.long_press = long_press;
     zbus_chan_pub(&buttons_status_chan, &button_status_msg, K_MSEC(10));
+    key->published_state = state;
+    atomic_set(&key->last_publish, k_uptime_get_32());
+    atomic_inc(&key->publish_count);
 }
 
-static void
-buttons_bottom_button_work_handler(struct k_work *handle) {
+#ifdef CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL
 
-    ARG_UNUSED(handle);
-    struct button_status_msg button_status_msg = { 0 };
+static int
+buttons_stats_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    /* Display statistics of each button */
+    for (int index = 0; index < ARRAY_SIZE(buttons_keys); index++) {
+        shell_print(sh,
+                    "%d: %s, events: %ld, published: %ld, long press: %ld",
+                    index,
+                    buttons_keys[index].name,
+                    atomic_get(&buttons_keys[index].events_count),
+                    atomic_get(&buttons_keys[index].publish_count),
+                    atomic_get(&buttons_keys[index].long_press_count));
+    }
 
-    /* Check button state */
-    if ((false == buttons_bottom_button_state) && (1 == gpio_pin_get_dt(&buttons_bottom_button))) {
-        buttons_bottom_button_state = true;
-    } else if ((true == buttons_bottom_button_state) && (0 == gpio_pin_get_dt(&buttons_bottom_button))) {
-        buttons_bottom_button_state = false;
-    } else {
-        return;
+    return 0;
+}
+
+static int
+buttons_bounce_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    int                 err     = 0;
+    unsigned long       index   = shell_strtoul(argv[1], 0, &err);
+    unsigned long       toggles = shell_strtoul(argv[2], 0, &err);
+    unsigned long       period  = (argc > 3) ? shell_strtoul(argv[3], 0, &err) : 500;
+    struct buttons_key *key;
+    atomic_val_t        events, published;
+
+    /* Check arguments, the error is kept by shell_strtoul if any of them is invalid */
+    if ((0 != err) || (index >= ARRAY_SIZE(buttons_keys)) || (0 == toggles) || (0 == period)) {
+        shell_error(sh, "Invalid arguments");
+        return -EINVAL;
+    }
+    key       = &buttons_keys[index];
+    events    = atomic_get(&key->events_count);
+    published = atomic_get(&key->publish_count);
+
+    /* Toggle the GPIO, then release the button, the GPIO is active low */
+    for (unsigned long toggle = 0; toggle < toggles; toggle++) {
+        gpio_emul_input_set(key->gpio.port, key->gpio.pin, toggle % 2);
+        k_sleep(K_USEC(period));
     }
+    gpio_emul_input_set(key->gpio.port, key->gpio.pin, 1);
 
-    /* Send button status */
-    button_status_msg.name  = "Wind Turbine Bottom Button";
-    button_status_msg.state = buttons_bottom_button_state;
-    zbus_chan_pub(&buttons_status_chan, &button_status_msg, K_MSEC(10));
+    /* Wait for the debounce and publish intervals, then report */
+    k_sleep(K_MSEC(CONFIG_WIND_TURBINE_BUTTONS_MIN_INTERVAL_MS + 100));
+    shell_print(sh,
+                "%s: %lu toggles, %ld input events, %ld published",
+                key->name,
+                toggles,
+                atomic_get(&key->events_count) - events,
+                atomic_get(&key->publish_count) - published);
+
+    return 0;
 }
 
+/**
+ * @brief Shell commands definition
+ */
+SHELL_STATIC_SUBCMD_SET_CREATE(buttons_cmds,
+                               SHELL_CMD_ARG(stats, NULL, "Display buttons statistics", buttons_stats_cmd, 1, 0),
+                               SHELL_CMD_ARG(bounce, NULL, "Simulate a bounce storm: bounce <button> <toggles> [period_us]", buttons_bounce_cmd, 3, 1),
+                               SHELL_SUBCMD_SET_END);
+SHELL_CMD_REGISTER(buttons, &buttons_cmds, "Buttons commands", NULL);
+
+#endif /* CONFIG_WIND_TURBINE_BUTTONS_BOUNCE_SHELL */
+
 /**
  * @brief Initialization of buttons
  */
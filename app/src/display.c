@@ -20,17 +20,30 @@
  * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(wind_turbine_display, LOG_LEVEL_INF);
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/display.h>
+#ifdef CONFIG_INPUT
+#include <zephyr/input/input.h>
+#endif /* CONFIG_INPUT */
+#include <zephyr/sys/barrier.h>
 #include <zephyr/zbus/zbus.h>
 #include <lvgl_zephyr.h>
 #include <lvgl.h>
 
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+#include "boot_profile.h"
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
 #include "display/background.h"
+#include "history.h"
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK
+#include "display_benchmark.h"
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK */
 #include "messages.h"
 
 /**
@@ -43,17 +56,92 @@ LOG_MODULE_REGISTER(wind_turbine_display, LOG_LEVEL_INF);
  */
 #define DISPLAY_WORK_QUEUE_PRIORITY (5)
 
+/**
+ * @brief Minimum delay between two refreshes of the display (milliseconds)
+ */
+#define DISPLAY_REFRESH_DELAY_MIN (1)
+
+/**
+ * @brief Maximum delay between two refreshes of the display (milliseconds)
+ */
+#define DISPLAY_REFRESH_DELAY_MAX (1000)
+
+/**
+ * @brief Wind turbine current particles count
+ */
+#define DISPLAY_PARTICLES_COUNT (12)
+
+/**
+ * @brief Wind turbine current particles size (pixels)
+ */
+#define DISPLAY_PARTICLES_SIZE (15)
+
+/**
+ * @brief Wind turbine current particles path length (pixels)
+ */
+#define DISPLAY_PARTICLES_PATH_LENGTH (165)
+
+/**
+ * @brief Wind turbine current particles progress on a leg of the path, in 1/65536 of the leg
+ */
+#define DISPLAY_PARTICLES_PROGRESS_MAX (65536)
+
+/**
+ * @brief Delay between the start of two consecutive particles (milliseconds)
+ */
+#define DISPLAY_PARTICLES_DELAY (500)
+
+/**
+ * @brief Screen 2 chart size (pixels), the horizontal padding and borders are removed so that the width is the plotting width
+ */
+#define DISPLAY_SCREEN2_CHART_WIDTH  (480)
+#define DISPLAY_SCREEN2_CHART_HEIGHT (180)
+
+/**
+ * @brief Width of a history column on screen 2 chart (pixels)
+ */
+#define DISPLAY_SCREEN2_CHART_COLUMN_WIDTH (2)
+
+BUILD_ASSERT(HISTORY_COLUMNS_COUNT == DISPLAY_SCREEN2_CHART_WIDTH / DISPLAY_SCREEN2_CHART_COLUMN_WIDTH,
+             "History columns count must be the chart width divided by the column width");
+
+/**
+ * @brief Wind turbine current particle
+ */
+struct display_particle {
+    int32_t  delay;    /**< Remaining delay before the particle starts moving (milliseconds) */
+    uint32_t progress; /**< Progress on the current leg of the path, from 0 to DISPLAY_PARTICLES_PROGRESS_MAX */
+    bool     reverse;  /**< Particle is going back along the path */
+    int32_t  x;        /**< Last drawn position of the particle relative to the widget (pixels) */
+    int32_t  y;        /**< Last drawn position of the particle relative to the widget (pixels) */
+};
+
+/**
+ * @brief Display model, latest status received from each zbus channel
+ * @note Each status is protected by a sequence counter which is odd while the status is written by the zbus listener. Writers of a
+ *       given status are serialized by zbus, the display work never waits for them: torn reads are dropped and the status is read
+ *       again on the next refresh, which is requested by the writer once the status is complete.
+ */
+struct display_model {
+    atomic_t                       wind_turbine_status_sequence; /**< Wind turbine status sequence counter */
+    struct wind_turbine_status_msg wind_turbine_status;          /**< Wind turbine status */
+    atomic_t                       inverter_status_sequence;     /**< Inverter status sequence counter */
+    struct inverter_status_msg     inverter_status;              /**< Inverter status */
+    atomic_t                       network_status_sequence;      /**< Network status sequence counter */
+    struct network_status_msg      network_status;               /**< Network status */
+};
+
 /**
  * @brief Display initialization
  * @return 0 if the function succeeds, error code otherwise
  */
-/*static*/ int display_init(void); /* FIXME: this should be a static function */
+static int display_init(void);
 
 /**
- * @brief Function used to handle work context timer when it expires
- * @param handle Timer handler
+ * @brief Request refresh of the display as soon as possible
+ * @note This function can be called from any context
  */
-static void display_timer_callback(struct k_timer *handle);
+static void display_wakeup(void);
 
 /**
  * @brief Function used to handle work
@@ -61,6 +149,25 @@ static void display_timer_callback(struct k_timer *handle);
  */
 static void display_work_handler(struct k_work *handle);
 
+/**
+ * @brief Enter or exit idle mode
+ * @note Animations and input devices polling are stopped in idle mode
+ * @param idle true to enter idle mode, false to exit idle mode
+ */
+static void display_set_idle(bool idle);
+
+#ifdef CONFIG_INPUT
+
+/**
+ * @brief Input event callback
+ * @note This callback is used to wake up the display when the user interacts with the device
+ * @param evt Input event
+ * @param user_data User data (not used)
+ */
+static void display_input_callback(struct input_event *evt, void *user_data);
+
+#endif /* CONFIG_INPUT */
+
 /**
  * @brief Create screen 1
  */
@@ -71,6 +178,17 @@ static void display_create_screen1(void);
  */
 static void display_create_screen2(void);
 
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE
+
+/**
+ * @brief Compose the static elements of screen 1 into the decoded background image, the only copy of the static layer
+ * @param canvas Background canvas, covering the whole screen
+ * @param button Wind turbine status button, its body is drawn into the background and the button is made transparent
+ */
+static void display_screen1_static_layer_compose(lv_obj_t *canvas, lv_obj_t *button);
+
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE */
+
 /**
  * @brief Wind turbine status button callback
  * @param event Event value
@@ -78,11 +196,32 @@ static void display_create_screen2(void);
 static void display_screen1_wind_turbine_status_button_callback(lv_event_t *event);
 
 /**
- * @brief Wind turbine current animation callback
- * @param var Wind turbine current animation object
- * @param v Animation value
+ * @brief Set speed of the wind turbine current particles
+ * @param output_power Wind turbine output power (kilo-watts)
  */
-static void display_screen1_animation_wind_turbine_current_exec_callback(void *var, int32_t v);
+static void display_screen1_particles_set_speed(uint16_t output_power);
+
+/**
+ * @brief Wind turbine current particles timer callback
+ * @note This callback moves all the particles and invalidates the areas they leave and reach
+ * @param timer Particles timer
+ */
+static void display_screen1_particles_timer_callback(lv_timer_t *timer);
+
+/**
+ * @brief Wind turbine current particles draw callback
+ * @note This callback draws all the particles of the widget
+ * @param event Event value
+ */
+static void display_screen1_particles_draw_callback(lv_event_t *event);
+
+/**
+ * @brief Compute position of a particle relative to the widget
+ * @param particle Particle
+ * @param x Horizontal position (pixels)
+ * @param y Vertical position (pixels)
+ */
+static void display_screen1_particles_get_position(const struct display_particle *particle, int32_t *x, int32_t *y);
 
 /**
  * @brief Screen2 back button callback
@@ -90,6 +229,20 @@ static void display_screen1_animation_wind_turbine_current_exec_callback(void *v
  */
 static void display_screen2_back_button_callback(lv_event_t *event);
 
+/**
+ * @brief Screen2 timescale button callback
+ * @note This callback selects the next timescale of the chart
+ * @param event Event value
+ */
+static void display_screen2_timescale_button_callback(lv_event_t *event);
+
+/**
+ * @brief Redraw the output power chart from the history
+ * @note This function is called once per frame from the display work, the chart is only redrawn when it is visible and a column of the
+ *       selected timescale has completed
+ */
+static void display_screen2_chart_apply(void);
+
 /**
  * @brief Wind turbine status callback
  * @note This callback is used to refresh the wind turbine status on the display
@@ -111,25 +264,77 @@ static void display_inverter_status_callback(const struct zbus_channel *chan);
  */
 static void display_network_status_callback(const struct zbus_channel *chan);
 
+/**
+ * @brief Write a status to the display model
+ * @note This function is called from the zbus listeners
+ * @param sequence Sequence counter of the status
+ * @param dst Status in the display model
+ * @param src Status received
+ * @param size Size of the status
+ */
+static void display_model_write(atomic_t *sequence, void *dst, const void *src, size_t size);
+
+/**
+ * @brief Read a status from the display model
+ * @note This function is called from the display work, it never waits for the writer
+ * @param sequence Sequence counter of the status
+ * @param applied Sequence of the last status read, updated if a new status is read
+ * @param dst Copy of the status
+ * @param src Status in the display model
+ * @param size Size of the status
+ * @return true if a new consistent status has been read, false otherwise
+ */
+static bool display_model_read(atomic_t *sequence, atomic_val_t *applied, void *dst, const void *src, size_t size);
+
+/**
+ * @brief Apply the latest statuses of the display model to the screens
+ * @note This function is called once per frame from the display work
+ */
+static void display_model_apply(void);
+
+/**
+ * @brief Set text of a label if it has changed
+ * @param label Label
+ * @param text New text
+ */
+static void display_label_set_text(lv_obj_t *label, const char *text);
+
 /**
  * @brief Display work queue stack
  */
 K_THREAD_STACK_DEFINE(display_work_queue_stack, DISPLAY_WORK_QUEUE_STACK_SIZE);
 
 /**
- * @brief Timer used to periodically schedule the refresh of the screen
+ * @brief Work queue used to refresh the screen
  */
-static struct k_timer display_timer_handle;
+static struct k_work_q display_work_queue_handle;
 
 /**
- * @brief Work queue used to periodically refresh the screen
+ * @brief Work handler used to refresh the screen, scheduled according to the next LVGL timer deadline
  */
-static struct k_work_q display_work_queue_handle;
+static struct k_work_delayable display_work_handle;
+
+/**
+ * @brief Idle mode status
+ */
+static bool display_idle = false;
+
+/**
+ * @brief Wake up request, set when the user interacts with the device
+ */
+static atomic_t display_wakeup_request = ATOMIC_INIT(0);
 
 /**
- * @brief Work handler used to periodically refresh the screen
+ * @brief Display model, written by the zbus listeners and applied by the display work
  */
-static struct k_work display_work_handle;
+static struct display_model display_model;
+
+/**
+ * @brief Sequences of the statuses last applied to the screens
+ */
+static atomic_val_t display_model_wind_turbine_status_applied = 0;
+static atomic_val_t display_model_inverter_status_applied     = 0;
+static atomic_val_t display_model_network_status_applied      = 0;
 
 /**
  * @brief Styles
@@ -148,17 +353,31 @@ static lv_obj_t *display_screen1_network_status_label       = NULL;
 /**
  * @brief Screen 2
  */
-static lv_obj_t *display_screen2                   = NULL;
-static lv_obj_t *display_screen2_back_button       = NULL;
-static lv_obj_t *display_screen2_back_button_label = NULL;
-static lv_obj_t *display_screen2_chart             = NULL;
+static lv_obj_t *display_screen2                        = NULL;
+static lv_obj_t *display_screen2_back_button            = NULL;
+static lv_obj_t *display_screen2_back_button_label      = NULL;
+static lv_obj_t *display_screen2_chart                  = NULL;
+static lv_obj_t *display_screen2_timescale_button       = NULL;
+static lv_obj_t *display_screen2_timescale_button_label = NULL;
+
+/**
+ * @brief Output power chart, min/max envelope of the selected timescale
+ */
+static lv_chart_series_t     *display_screen2_chart_max_series = NULL;
+static lv_chart_series_t     *display_screen2_chart_min_series = NULL;
+static enum history_timescale display_screen2_chart_timescale  = HISTORY_TIMESCALE_1MIN;
+static bool                   display_screen2_chart_valid      = false;
+static uint32_t               display_screen2_chart_completed  = 0;
+static struct history_column  display_screen2_chart_columns[HISTORY_COLUMNS_COUNT];
 
 /**
- * @brief Wind turbine current animations and objects
+ * @brief Wind turbine current particles widget, timer, leg duration (milliseconds) and particles
  */
-#define DISPLAY_ANIMATION_WIND_TURBINE_CURRENT_OBJECTS_COUNT (12)
-static lv_anim_t display_animation_wind_turbine_current[DISPLAY_ANIMATION_WIND_TURBINE_CURRENT_OBJECTS_COUNT];
-static lv_obj_t *display_animation_wind_turbine_current_objs[DISPLAY_ANIMATION_WIND_TURBINE_CURRENT_OBJECTS_COUNT];
+static lv_obj_t               *display_screen1_particles          = NULL;
+static lv_timer_t             *display_screen1_particles_timer    = NULL;
+static uint32_t                display_screen1_particles_tick     = 0;
+static uint32_t                display_screen1_particles_duration = 12288;
+static struct display_particle display_screen1_particles_array[DISPLAY_PARTICLES_COUNT];
 
 /**
  * @brief Zbus channels
@@ -174,8 +393,16 @@ ZBUS_LISTENER_DEFINE(display_wind_turbine_status_listenner, display_wind_turbine
 ZBUS_LISTENER_DEFINE(display_inverter_status_listenner, display_inverter_status_callback);
 ZBUS_LISTENER_DEFINE(display_network_status_listenner, display_network_status_callback);
 
-/* FIXME: this should be a static function */
-/*static*/ int
+#ifdef CONFIG_INPUT
+
+/**
+ * @brief Input callback definition, any input device wakes up the display
+ */
+INPUT_CALLBACK_DEFINE(NULL, display_input_callback, NULL);
+
+#endif /* CONFIG_INPUT */
+
+static int
 display_init(void) {
 
     const struct device *display_dev;
@@ -193,29 +420,47 @@ display_init(void) {
     k_work_queue_init(&display_work_queue_handle);
     k_work_queue_start(&display_work_queue_handle, display_work_queue_stack, DISPLAY_WORK_QUEUE_STACK_SIZE, DISPLAY_WORK_QUEUE_PRIORITY, NULL);
     k_thread_name_set(k_work_queue_thread_get(&display_work_queue_handle), "display_work_queue");
-    k_work_init(&display_work_handle, display_work_handler);
-    k_timer_init(&display_timer_handle, display_timer_callback, NULL);
+    k_work_init_delayable(&display_work_handle, display_work_handler);
 
     /* Create styles */
     lv_style_init(&display_style_transp);
     lv_style_set_bg_opa(&display_style_transp, LV_OPA_TRANSP);
     lv_style_set_border_width(&display_style_transp, 0);
 
-    /* Create screens */
+#ifndef CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RAW
+    /* Decode background images, screens are displayed with a black background on failure */
+    if (0 != background_decode()) {
+        LOG_ERR("Unable to decode background images");
+    }
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BACKGROUND_RAW */
+
+    /* Create landing screen, screen 2 is created on first use and freed afterwards */
     display_create_screen1();
-    display_create_screen2();
 
     /* Display landing screen */
     lv_scr_load(display_screen1);
 
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+    boot_profile_record(BOOT_PHASE_DISPLAY);
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK
+    /* Start benchmark */
+    display_benchmark_init();
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK */
+
     /* Refresh display */
     lv_timer_handler();
 
     /* Switch ON display */
     display_blanking_off(display_dev);
 
-    /* Start periodic refresh of the display */
-    k_timer_start(&display_timer_handle, K_NO_WAIT, K_MSEC(10));
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+    boot_profile_record(BOOT_PHASE_FIRST_FRAME);
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+
+    /* Start refresh of the display */
+    k_work_schedule_for_queue(&display_work_queue_handle, &display_work_handle, K_NO_WAIT);
 
     /* Register to Zbus channels */
     zbus_chan_add_obs(&wind_turbine_status_chan, &display_wind_turbine_status_listenner, K_MSEC(10));
@@ -228,12 +473,10 @@ display_init(void) {
 }
 
 static void
-display_timer_callback(struct k_timer *handle) {
-
-    ARG_UNUSED(handle);
+display_wakeup(void) {
 
-    /* Submit the work to the work queue */
-    if (k_work_submit_to_queue(&display_work_queue_handle, &display_work_handle) < 0) {
+    /* Bring the next refresh forward */
+    if (k_work_reschedule_for_queue(&display_work_queue_handle, &display_work_handle, K_NO_WAIT) < 0) {
         LOG_ERR("Unable to submit work to the work queue");
     }
 }
@@ -242,11 +485,79 @@ static void
 display_work_handler(struct k_work *handle) {
 
     ARG_UNUSED(handle);
+    uint32_t delay;
+
+    /* Exit idle mode when the user interacts with the device, enter it when the screen is unattended */
+    if (0 != atomic_clear(&display_wakeup_request)) {
+        lv_display_trigger_activity(NULL);
+        display_set_idle(false);
+    } else if ((CONFIG_WIND_TURBINE_DISPLAY_IDLE_TIMEOUT > 0) && (lv_display_get_inactive_time(NULL) >= (CONFIG_WIND_TURBINE_DISPLAY_IDLE_TIMEOUT * 1000))) {
+        display_set_idle(true);
+    }
 
-    /* Refresh display */
-    lv_timer_handler();
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK
+    uint32_t start = display_benchmark_timestamp();
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK */
+
+    /* Apply latest statuses and history, then refresh display */
+    display_model_apply();
+    display_screen2_chart_apply();
+    delay = lv_timer_handler();
+
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK
+    display_benchmark_record_timer_handler(start);
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK */
+
+    /* Schedule next refresh according to the next LVGL timer deadline, unless a wake up is already pending */
+    delay = CLAMP(delay, DISPLAY_REFRESH_DELAY_MIN, DISPLAY_REFRESH_DELAY_MAX);
+    k_work_schedule_for_queue(&display_work_queue_handle, &display_work_handle, K_MSEC(delay));
+}
+
+static void
+display_set_idle(bool idle) {
+
+    lv_indev_t *indev = NULL;
+
+    /* Check if idle mode changes */
+    if (idle == display_idle) {
+        return;
+    }
+    display_idle = idle;
+    LOG_INF("Display %s idle mode", (true == idle) ? "enters" : "exits");
+
+    /* Stop or restart wind turbine current particles */
+    if (true == idle) {
+        lv_timer_pause(display_screen1_particles_timer);
+    } else {
+        display_screen1_particles_tick = lv_tick_get();
+        lv_timer_resume(display_screen1_particles_timer);
+    }
+
+    /* Pause or resume input devices polling, input events wake up the display in idle mode */
+    while (NULL != (indev = lv_indev_get_next(indev))) {
+        if (true == idle) {
+            lv_timer_pause(lv_indev_get_read_timer(indev));
+        } else {
+            lv_timer_resume(lv_indev_get_read_timer(indev));
+        }
+    }
+}
+
+#ifdef CONFIG_INPUT
+
+static void
+display_input_callback(struct input_event *evt, void *user_data) {
+
+    ARG_UNUSED(evt);
+    ARG_UNUSED(user_data);
+
+    /* Wake up the display */
+    atomic_set(&display_wakeup_request, 1);
+    display_wakeup();
 }
 
+#endif /* CONFIG_INPUT */
+
 static void
 display_create_screen1(void) {
 
@@ -255,10 +566,16 @@ display_create_screen1(void) {
     /* Create screen */
     display_screen1 = lv_obj_create(NULL);
 
-    /* Create background */
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE
+    /* Create background, the static elements are composed into the decoded image */
+    lv_obj_t *background = lv_canvas_create(display_screen1);
+    lv_canvas_set_draw_buf(background, &background_draw_buf_screen1);
+#else
+    /* Create background, drawn straight from the decoded image */
     lv_obj_t *background = lv_image_create(display_screen1);
-    lv_obj_align(background, LV_ALIGN_CENTER, 0, 0);
     lv_image_set_src(background, &background_screen1);
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE */
+    lv_obj_align(background, LV_ALIGN_CENTER, 0, 0);
 
     /* Create wind turbine status label */
     display_screen1_wind_turbine_status_button = lv_button_create(display_screen1);
@@ -271,6 +588,11 @@ display_create_screen1(void) {
     lv_obj_set_style_text_align(display_screen1_wind_turbine_status_label, LV_TEXT_ALIGN_CENTER, 0);
     lv_obj_center(display_screen1_wind_turbine_status_label);
 
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE
+    /* Compose static elements, the labels are updated with the status and drawn on top */
+    display_screen1_static_layer_compose(background, display_screen1_wind_turbine_status_button);
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE */
+
     /* Create inverter status label */
     display_screen1_inverter_status_label = lv_label_create(display_screen1);
     lv_obj_align(display_screen1_inverter_status_label, LV_ALIGN_CENTER, -35, -50);
@@ -283,27 +605,18 @@ display_create_screen1(void) {
     lv_label_set_text(display_screen1_network_status_label, "IP Address: --");
     lv_obj_set_style_text_align(display_screen1_network_status_label, LV_TEXT_ALIGN_CENTER, 0);
 
-    /* Create wind turbine current animations */
-    for (index = 0; index < DISPLAY_ANIMATION_WIND_TURBINE_CURRENT_OBJECTS_COUNT; index++) {
-        display_animation_wind_turbine_current_objs[index] = lv_obj_create(display_screen1);
-        lv_obj_remove_flag(display_animation_wind_turbine_current_objs[index], LV_OBJ_FLAG_SCROLLABLE);
-        lv_obj_set_style_bg_color(display_animation_wind_turbine_current_objs[index], lv_palette_main(LV_PALETTE_RED), 0);
-        lv_obj_set_style_radius(display_animation_wind_turbine_current_objs[index], LV_RADIUS_CIRCLE, 0);
-        lv_obj_set_size(display_animation_wind_turbine_current_objs[index], 15, 15);
-        lv_obj_align(display_animation_wind_turbine_current_objs[index], LV_ALIGN_CENTER, -175, 78);
-        lv_anim_init(&display_animation_wind_turbine_current[index]);
-        lv_anim_set_var(&display_animation_wind_turbine_current[index], display_animation_wind_turbine_current_objs[index]);
-        lv_anim_set_values(&display_animation_wind_turbine_current[index], 0, 165);     /* 'v' range from 0 to 165 */
-        lv_anim_set_delay(&display_animation_wind_turbine_current[index], 500 * index); /* Create a small distance between the objects */
-        lv_anim_set_duration(&display_animation_wind_turbine_current[index], 12288);
-        lv_anim_set_reverse_delay(&display_animation_wind_turbine_current[index], 0);
-        lv_anim_set_reverse_duration(&display_animation_wind_turbine_current[index], 12288);
-        lv_anim_set_repeat_delay(&display_animation_wind_turbine_current[index], 0);
-        lv_anim_set_repeat_count(&display_animation_wind_turbine_current[index], LV_ANIM_REPEAT_INFINITE);
-        lv_anim_set_path_cb(&display_animation_wind_turbine_current[index], lv_anim_path_ease_in_out);
-        lv_anim_set_exec_cb(&display_animation_wind_turbine_current[index], display_screen1_animation_wind_turbine_current_exec_callback);
-        lv_anim_start(&display_animation_wind_turbine_current[index]);
+    /* Create wind turbine current particles, all drawn by a single widget covering their path */
+    display_screen1_particles = lv_obj_create(display_screen1);
+    lv_obj_remove_style_all(display_screen1_particles);
+    lv_obj_remove_flag(display_screen1_particles, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(display_screen1_particles, 115 + DISPLAY_PARTICLES_SIZE, 25 + DISPLAY_PARTICLES_SIZE);
+    lv_obj_align(display_screen1_particles, LV_ALIGN_TOP_LEFT, 57, 206);
+    lv_obj_add_event_cb(display_screen1_particles, display_screen1_particles_draw_callback, LV_EVENT_DRAW_MAIN, NULL);
+    for (index = 0; index < DISPLAY_PARTICLES_COUNT; index++) {
+        display_screen1_particles_array[index].delay = DISPLAY_PARTICLES_DELAY * index; /* Create a small distance between the particles */
     }
+    display_screen1_particles_tick  = lv_tick_get();
+    display_screen1_particles_timer = lv_timer_create(display_screen1_particles_timer_callback, LV_DEF_REFR_PERIOD, NULL);
 }
 
 static void
@@ -322,46 +635,172 @@ display_create_screen2(void) {
     lv_obj_set_style_text_align(display_screen2_back_button_label, LV_TEXT_ALIGN_CENTER, 0);
     lv_obj_center(display_screen2_back_button_label);
 
-    /* Create chart */
+    /* Create timescale button */
+    display_screen2_timescale_button = lv_button_create(display_screen2);
+    lv_obj_add_event_cb(display_screen2_timescale_button, display_screen2_timescale_button_callback, LV_EVENT_PRESSED, NULL);
+    lv_obj_align(display_screen2_timescale_button, LV_ALIGN_BOTTOM_LEFT, 10, -10);
+    lv_obj_remove_flag(display_screen2_timescale_button, LV_OBJ_FLAG_PRESS_LOCK);
+    display_screen2_timescale_button_label = lv_label_create(display_screen2_timescale_button);
+    lv_label_set_text(display_screen2_timescale_button_label, history_get_timescale_name(display_screen2_chart_timescale));
+    lv_obj_set_style_text_align(display_screen2_timescale_button_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_center(display_screen2_timescale_button_label);
+
+    /* Create chart, the envelope is drawn with a series for the maximums and a series for the minimums of each column */
     display_screen2_chart = lv_chart_create(display_screen2);
-    lv_chart_set_update_mode(display_screen2_chart, LV_CHART_UPDATE_MODE_CIRCULAR);
+    lv_chart_set_update_mode(display_screen2_chart, LV_CHART_UPDATE_MODE_SHIFT);
     lv_obj_set_style_size(display_screen2_chart, 0, 0, LV_PART_INDICATOR);
-    lv_obj_set_size(display_screen2_chart, 480, 180);
+    lv_obj_set_style_pad_hor(display_screen2_chart, 0, 0);
+    lv_obj_set_style_border_side(display_screen2_chart, LV_BORDER_SIDE_TOP | LV_BORDER_SIDE_BOTTOM, 0);
+    lv_obj_set_size(display_screen2_chart, DISPLAY_SCREEN2_CHART_WIDTH, DISPLAY_SCREEN2_CHART_HEIGHT);
     lv_obj_center(display_screen2_chart);
-    lv_chart_set_point_count(display_screen2_chart, 80);
-    lv_chart_add_series(display_screen2_chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_point_count(display_screen2_chart, HISTORY_COLUMNS_COUNT);
+    display_screen2_chart_max_series = lv_chart_add_series(display_screen2_chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y);
+    display_screen2_chart_min_series = lv_chart_add_series(display_screen2_chart, lv_palette_main(LV_PALETTE_BROWN), LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(display_screen2_chart, display_screen2_chart_max_series, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(display_screen2_chart, display_screen2_chart_min_series, LV_CHART_POINT_NONE);
+}
+
+#ifdef CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE
+
+static void
+display_screen1_static_layer_compose(lv_obj_t *canvas, lv_obj_t *button) {
+
+    lv_draw_rect_dsc_t dsc;
+    lv_area_t          area;
+    lv_layer_t         layer;
+
+    /* Retrieve the button body as drawn by the theme, the canvas covers the screen so screen coordinates are canvas coordinates */
+    lv_obj_update_layout(display_screen1);
+    lv_draw_rect_dsc_init(&dsc);
+    lv_obj_init_draw_rect_dsc(button, LV_PART_MAIN, &dsc);
+    lv_obj_get_coords(button, &area);
+
+    /* Draw it once into the decoded image */
+    lv_canvas_init_layer(canvas, &layer);
+    lv_draw_rect(&layer, &dsc, &area);
+    lv_canvas_finish_layer(canvas, &layer);
+    lv_image_cache_drop(&background_draw_buf_screen1);
+
+    /* The button is then only used for its label and input */
+    lv_obj_set_style_bg_opa(button, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(button, 0, 0);
+    lv_obj_set_style_outline_width(button, 0, 0);
+    lv_obj_set_style_shadow_width(button, 0, 0);
 }
 
+#endif /* CONFIG_WIND_TURBINE_DISPLAY_LAYER_CACHE */
+
 static void
 display_screen1_wind_turbine_status_button_callback(lv_event_t *event) {
 
     ARG_UNUSED(event);
 
-    /* Load screen2 */
+    /* Create screen2 on first use, then load it */
+    if (NULL == display_screen2) {
+        display_create_screen2();
+    }
     lv_scr_load(display_screen2);
 }
 
 static void
-display_screen1_animation_wind_turbine_current_exec_callback(void *var, int32_t v) {
+display_screen1_particles_set_speed(uint16_t output_power) {
 
-    /* Compute coordinates based on the animation value 'v' */
-    if (v < 25) {
-        lv_obj_set_y((lv_obj_t *)var, v + 78);
-        lv_obj_set_x((lv_obj_t *)var, -175);
-    } else if (v > 140) {
-        lv_obj_set_y((lv_obj_t *)var, 243 - v);
-        lv_obj_set_x((lv_obj_t *)var, -60);
-    } else {
-        lv_obj_set_y((lv_obj_t *)var, 103);
-        lv_obj_set_x((lv_obj_t *)var, v - 200);
+    /* Modify the duration of a leg of the path based on the output power value */
+    display_screen1_particles_duration = 12288 - 2 * output_power;
+}
+
+static void
+display_screen1_particles_timer_callback(lv_timer_t *timer) {
+
+    ARG_UNUSED(timer);
+    uint32_t  elapsed = lv_tick_elaps(display_screen1_particles_tick);
+    uint32_t  advance;
+    int32_t   x, y;
+    lv_area_t coords, area;
+    int       index;
+
+    /* Compute progress since last call */
+    display_screen1_particles_tick += elapsed;
+    advance = (elapsed * DISPLAY_PARTICLES_PROGRESS_MAX) / display_screen1_particles_duration;
+
+    /* Move particles */
+    lv_obj_get_coords(display_screen1_particles, &coords);
+    for (index = 0; index < DISPLAY_PARTICLES_COUNT; index++) {
+        struct display_particle *particle = &display_screen1_particles_array[index];
+        if (particle->delay > 0) {
+            particle->delay -= elapsed;
+            continue;
+        }
+        particle->progress += advance;
+        while (particle->progress >= DISPLAY_PARTICLES_PROGRESS_MAX) {
+            particle->progress -= DISPLAY_PARTICLES_PROGRESS_MAX;
+            particle->reverse = !particle->reverse;
+        }
+
+        /* Invalidate the area covering the previous and the new positions of the particle */
+        display_screen1_particles_get_position(particle, &x, &y);
+        if ((x != particle->x) || (y != particle->y)) {
+            area.x1 = MIN(x, particle->x);
+            area.y1 = MIN(y, particle->y);
+            area.x2 = MAX(x, particle->x) + DISPLAY_PARTICLES_SIZE - 1;
+            area.y2 = MAX(y, particle->y) + DISPLAY_PARTICLES_SIZE - 1;
+            lv_area_move(&area, coords.x1, coords.y1);
+            lv_obj_invalidate_area(display_screen1_particles, &area);
+            particle->x = x;
+            particle->y = y;
+        }
+    }
+}
+
+static void
+display_screen1_particles_draw_callback(lv_event_t *event) {
+
+    lv_layer_t        *layer = lv_event_get_layer(event);
+    lv_draw_rect_dsc_t forward_dsc, reverse_dsc;
+    lv_area_t          coords, area;
+    int                index;
+
+    /* Particles are red when going forward and brown when going back */
+    lv_draw_rect_dsc_init(&forward_dsc);
+    forward_dsc.radius   = LV_RADIUS_CIRCLE;
+    forward_dsc.bg_color = lv_palette_main(LV_PALETTE_RED);
+    lv_draw_rect_dsc_init(&reverse_dsc);
+    reverse_dsc.radius   = LV_RADIUS_CIRCLE;
+    reverse_dsc.bg_color = lv_palette_main(LV_PALETTE_BROWN);
+
+    /* Draw all particles */
+    lv_obj_get_coords(display_screen1_particles, &coords);
+    for (index = 0; index < DISPLAY_PARTICLES_COUNT; index++) {
+        struct display_particle *particle = &display_screen1_particles_array[index];
+        area.x1                           = coords.x1 + particle->x;
+        area.y1                           = coords.y1 + particle->y;
+        area.x2                           = area.x1 + DISPLAY_PARTICLES_SIZE - 1;
+        area.y2                           = area.y1 + DISPLAY_PARTICLES_SIZE - 1;
+        lv_draw_rect(layer, (true == particle->reverse) ? &reverse_dsc : &forward_dsc, &area);
     }
+}
 
-    /* Change color when the object reach the endinds of the animation */
-    if (0 == v) {
-        lv_obj_set_style_bg_color((lv_obj_t *)var, lv_palette_main(LV_PALETTE_RED), 0);
+static void
+display_screen1_particles_get_position(const struct display_particle *particle, int32_t *x, int32_t *y) {
+
+    /* Ease in and out along the leg of the path, then compute position 'v' on the path */
+    int64_t t = particle->progress;
+    int64_t v = (t * t * (3 * DISPLAY_PARTICLES_PROGRESS_MAX - 2 * t)) / ((int64_t)DISPLAY_PARTICLES_PROGRESS_MAX * DISPLAY_PARTICLES_PROGRESS_MAX);
+    v         = (v * DISPLAY_PARTICLES_PATH_LENGTH) / DISPLAY_PARTICLES_PROGRESS_MAX;
+    if (true == particle->reverse) {
+        v = DISPLAY_PARTICLES_PATH_LENGTH - v;
     }
-    if (165 == v) {
-        lv_obj_set_style_bg_color((lv_obj_t *)var, lv_palette_main(LV_PALETTE_BROWN), 0);
+
+    /* Compute coordinates based on the position 'v' */
+    if (v < 25) {
+        *x = 0;
+        *y = v;
+    } else if (v > 140) {
+        *x = 115;
+        *y = DISPLAY_PARTICLES_PATH_LENGTH - v;
+    } else {
+        *x = v - 25;
+        *y = 25;
     }
 }
 
@@ -372,70 +811,199 @@ display_screen2_back_button_callback(lv_event_t *event) {
 
     /* Load screen1 */
     lv_scr_load(display_screen1);
+
+    /* Free screen2 to release LVGL memory, it is deleted once the event is processed */
+    lv_obj_delete_async(display_screen2);
+    display_screen2                        = NULL;
+    display_screen2_back_button            = NULL;
+    display_screen2_back_button_label      = NULL;
+    display_screen2_chart                  = NULL;
+    display_screen2_timescale_button       = NULL;
+    display_screen2_timescale_button_label = NULL;
+    display_screen2_chart_max_series       = NULL;
+    display_screen2_chart_min_series       = NULL;
+    display_screen2_chart_valid            = false;
 }
 
 static void
-display_wind_turbine_status_callback(const struct zbus_channel *chan) {
+display_screen2_timescale_button_callback(lv_event_t *event) {
 
-    char                                  str[64];
-    const struct wind_turbine_status_msg *wind_turbine_status_msg = zbus_chan_const_msg(chan);
-    int                                   index;
+    ARG_UNUSED(event);
+
+    /* Select next timescale, the chart is redrawn on next frame */
+    display_screen2_chart_timescale = (display_screen2_chart_timescale + 1) % HISTORY_TIMESCALE_COUNT;
+    display_screen2_chart_valid     = false;
+    lv_label_set_text(display_screen2_timescale_button_label, history_get_timescale_name(display_screen2_chart_timescale));
+}
+
+static void
+display_screen2_chart_apply(void) {
 
-    /* Format and display status */
-    lv_snprintf(str, sizeof(str), "%dV\n%dkW", wind_turbine_status_msg->output_voltage, wind_turbine_status_msg->output_power);
-    lv_label_set_text(display_screen1_wind_turbine_status_label, str);
+    int32_t *max_values, *min_values;
+    uint32_t index;
 
-    /* Modify the duration of the wind turbine current animation based on the output power value */
-    uint32_t duration = 12288 - 2 * wind_turbine_status_msg->output_power;
-    for (index = 0; index < DISPLAY_ANIMATION_WIND_TURBINE_CURRENT_OBJECTS_COUNT; index++) {
-        lv_anim_set_duration(&display_animation_wind_turbine_current[index], duration);
-        lv_anim_set_reverse_duration(&display_animation_wind_turbine_current[index], duration);
+    /* Check if the chart is visible and if a column has completed */
+    if (display_screen2 != lv_screen_active()) {
+        return;
+    }
+    if ((true == display_screen2_chart_valid) && (display_screen2_chart_completed == history_get_completed(display_screen2_chart_timescale))) {
+        return;
     }
 
-    /* Update wind turbine output power chart */
-    lv_chart_series_t *ser = lv_chart_get_series_next(display_screen2_chart, NULL);
-    lv_chart_set_next_value(display_screen2_chart, ser, (100 * wind_turbine_status_msg->output_power) / 4096);
-    uint32_t p     = lv_chart_get_point_count(display_screen2_chart);
-    uint32_t s     = lv_chart_get_x_start_point(display_screen2_chart, ser);
-    int32_t *a     = lv_chart_get_series_y_array(display_screen2_chart, ser);
-    a[(s + 1) % p] = LV_CHART_POINT_NONE;
-    a[(s + 2) % p] = LV_CHART_POINT_NONE;
-    a[(s + 3) % p] = LV_CHART_POINT_NONE;
+    /* Redraw the envelope, columns without any value are not drawn */
+    display_screen2_chart_completed = history_read(display_screen2_chart_timescale, display_screen2_chart_columns);
+    display_screen2_chart_valid     = true;
+    max_values                      = lv_chart_get_series_y_array(display_screen2_chart, display_screen2_chart_max_series);
+    min_values                      = lv_chart_get_series_y_array(display_screen2_chart, display_screen2_chart_min_series);
+    for (index = 0; index < HISTORY_COLUMNS_COUNT; index++) {
+        if (display_screen2_chart_columns[index].min <= display_screen2_chart_columns[index].max) {
+            max_values[index] = display_screen2_chart_columns[index].max;
+            min_values[index] = display_screen2_chart_columns[index].min;
+        } else {
+            max_values[index] = LV_CHART_POINT_NONE;
+            min_values[index] = LV_CHART_POINT_NONE;
+        }
+    }
+    lv_chart_set_x_start_point(display_screen2_chart, display_screen2_chart_max_series, 0);
+    lv_chart_set_x_start_point(display_screen2_chart, display_screen2_chart_min_series, 0);
     lv_chart_refresh(display_screen2_chart);
 }
 
+static void
+display_wind_turbine_status_callback(const struct zbus_channel *chan) {
+
+    const struct wind_turbine_status_msg *wind_turbine_status_msg = zbus_chan_const_msg(chan);
+
+    /* Record output power in percent in the history */
+    history_add((100 * wind_turbine_status_msg->output_power) / 4096);
+
+    /* Store status and request refresh of the display */
+    display_model_write(
+        &display_model.wind_turbine_status_sequence, &display_model.wind_turbine_status, wind_turbine_status_msg, sizeof(struct wind_turbine_status_msg));
+    display_wakeup();
+}
+
 static void
 display_inverter_status_callback(const struct zbus_channel *chan) {
 
-    char                              str[64];
-    const struct inverter_status_msg *inverter_status_msg = zbus_chan_const_msg(chan);
-
-    /* Format and display status */
-    lv_snprintf(str,
-                sizeof(str),
-                "%.1fkV\n%dkW\n%.1fHz",
-                ((double)(inverter_status_msg->output_voltage)) / 1000,
-                inverter_status_msg->output_power,
-                inverter_status_msg->frequency);
-    lv_label_set_text(display_screen1_inverter_status_label, str);
+    /* Store status and request refresh of the display */
+    display_model_write(&display_model.inverter_status_sequence, &display_model.inverter_status, zbus_chan_const_msg(chan), sizeof(struct inverter_status_msg));
+    display_wakeup();
 }
 
 static void
 display_network_status_callback(const struct zbus_channel *chan) {
 
-    char                             str[64];
-    const struct network_status_msg *network_status_msg = zbus_chan_const_msg(chan);
+    /* Store status and request refresh of the display */
+    display_model_write(&display_model.network_status_sequence, &display_model.network_status, zbus_chan_const_msg(chan), sizeof(struct network_status_msg));
+    display_wakeup();
+}
 
-    /* Format and display status */
-    if (!network_status_msg->connected) {
-        lv_snprintf(str, sizeof(str), "IP Address: --");
-    } else {
-        lv_snprintf(str, sizeof(str), "IP Address: %s", network_status_msg->ip_address);
+static void
+display_model_write(atomic_t *sequence, void *dst, const void *src, size_t size) {
+
+    /* Sequence is odd while the status is written */
+    atomic_inc(sequence);
+    barrier_dmem_fence_full();
+    memcpy(dst, src, size);
+    barrier_dmem_fence_full();
+    atomic_inc(sequence);
+}
+
+static bool
+display_model_read(atomic_t *sequence, atomic_val_t *applied, void *dst, const void *src, size_t size) {
+
+    atomic_val_t start, end;
+
+    /* Check if a new status is available and not being written */
+    start = atomic_get(sequence);
+    if ((start == *applied) || (0 != (start & 1))) {
+        return false;
+    }
+
+    /* Copy the status and check it has not been modified meanwhile */
+    barrier_dmem_fence_full();
+    memcpy(dst, src, size);
+    barrier_dmem_fence_full();
+    end = atomic_get(sequence);
+    if (end != start) {
+        return false;
+    }
+    *applied = start;
+
+    return true;
+}
+
+static void
+display_model_apply(void) {
+
+    char                           str[64];
+    struct wind_turbine_status_msg wind_turbine_status_msg;
+    struct inverter_status_msg     inverter_status_msg;
+    struct network_status_msg      network_status_msg;
+
+    /* Wind turbine status */
+    if (true
+        == display_model_read(&display_model.wind_turbine_status_sequence,
+                              &display_model_wind_turbine_status_applied,
+                              &wind_turbine_status_msg,
+                              &display_model.wind_turbine_status,
+                              sizeof(struct wind_turbine_status_msg))) {
+
+        /* Format and display status */
+        lv_snprintf(str, sizeof(str), "%dV\n%dkW", wind_turbine_status_msg.output_voltage, wind_turbine_status_msg.output_power);
+        display_label_set_text(display_screen1_wind_turbine_status_label, str);
+
+        /* Modify the speed of the wind turbine current particles based on the output power value */
+        display_screen1_particles_set_speed(wind_turbine_status_msg.output_power);
+    }
+
+    /* Inverter status */
+    if (true
+        == display_model_read(&display_model.inverter_status_sequence,
+                              &display_model_inverter_status_applied,
+                              &inverter_status_msg,
+                              &display_model.inverter_status,
+                              sizeof(struct inverter_status_msg))) {
+
+        /* Format and display status */
+        lv_snprintf(str,
+                    sizeof(str),
+                    "%.1fkV\n%dkW\n%.1fHz",
+                    ((double)(inverter_status_msg.output_voltage)) / 1000,
+                    inverter_status_msg.output_power,
+                    inverter_status_msg.frequency);
+        display_label_set_text(display_screen1_inverter_status_label, str);
+    }
+
+    /* Network status */
+    if (true
+        == display_model_read(&display_model.network_status_sequence,
+                              &display_model_network_status_applied,
+                              &network_status_msg,
+                              &display_model.network_status,
+                              sizeof(struct network_status_msg))) {
+
+        /* Format and display status */
+        if (!network_status_msg.connected) {
+            lv_snprintf(str, sizeof(str), "IP Address: --");
+        } else {
+            lv_snprintf(str, sizeof(str), "IP Address: %s", network_status_msg.ip_address);
+        }
+        display_label_set_text(display_screen1_network_status_label, str);
+    }
+}
+
+static void
+display_label_set_text(lv_obj_t *label, const char *text) {
+
+    /* Avoid invalidating the label if the text has not changed */
+    if (0 != strcmp(lv_label_get_text(label), text)) {
+        lv_label_set_text(label, text);
     }
-    lv_label_set_text(display_screen1_network_status_label, str);
 }
 
 /**
- * @brief Initialization of display
+ * @brief Initialization of display, after LVGL and before the other modules to display the first frame as soon as possible
  */
-//SYS_INIT(display_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY); /* FIXME: this should be initialized here */
+SYS_INIT(display_init, APPLICATION, CONFIG_WIND_TURBINE_DISPLAY_INIT_PRIORITY);
@@ -0,0 +1,332 @@
+/**
+ * @file      display_benchmark.c
+ * @brief     Headless display render benchmark
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_display_benchmark, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#if defined(CONFIG_ADC_EMUL) && !defined(CONFIG_WIND_TURBINE_REPLAY) && !defined(CONFIG_WIND_TURBINE_SOAK)
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#define DISPLAY_BENCHMARK_WIND_SWEEP
+#endif
+#include <lvgl.h>
+
+#include "display_benchmark.h"
+#ifdef CONFIG_ARCH_POSIX
+#include "display_benchmark_bottom.h"
+#endif /* CONFIG_ARCH_POSIX */
+
+/**
+ * @brief Maximum number of samples recorded per report period
+ */
+#define DISPLAY_BENCHMARK_SAMPLES_COUNT (CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK_SAMPLES)
+
+#ifdef DISPLAY_BENCHMARK_WIND_SWEEP
+
+/**
+ * @brief ADC full scale (12 bits resolution)
+ */
+#define DISPLAY_BENCHMARK_ADC_FULL_SCALE (4096)
+
+/**
+ * @brief Period of the scripted wind sweep (milliseconds)
+ */
+#define DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS (20000)
+
+#endif /* DISPLAY_BENCHMARK_WIND_SWEEP */
+
+/**
+ * @brief Benchmark samples
+ */
+struct display_benchmark_samples {
+    uint32_t values[DISPLAY_BENCHMARK_SAMPLES_COUNT]; /**< Values */
+    uint32_t count;                                   /**< Number of values */
+    uint32_t dropped;                                 /**< Number of values dropped because the buffer is full */
+    uint64_t sum;                                     /**< Sum of values, including dropped values */
+};
+
+/**
+ * @brief Display event callback
+ * @param event Event value
+ */
+static void display_benchmark_event_callback(lv_event_t *event);
+
+/**
+ * @brief Add value to benchmark samples
+ * @param samples Benchmark samples
+ * @param value Value
+ */
+static void display_benchmark_samples_add(struct display_benchmark_samples *samples, uint32_t value);
+
+/**
+ * @brief Print and reset benchmark samples
+ * @param name Name of the samples
+ * @param unit Unit of the values
+ * @param samples Benchmark samples
+ */
+static void display_benchmark_samples_report(const char *name, const char *unit, struct display_benchmark_samples *samples);
+
+/**
+ * @brief Compare two samples, used to sort samples
+ * @param a First sample
+ * @param b Second sample
+ * @return Negative value, 0 or positive value if a is lower, equal or greater than b
+ */
+static int display_benchmark_samples_compare(const void *a, const void *b);
+
+/**
+ * @brief Convert difference of timestamps to microseconds
+ * @param delta Difference of timestamps
+ * @return Duration (microseconds)
+ */
+static uint32_t display_benchmark_to_us(uint32_t delta);
+
+#ifdef DISPLAY_BENCHMARK_WIND_SWEEP
+
+/**
+ * @brief ADC emulator value callback
+ * @note Simulates a triangle wind sweep over the full range of the ADC
+ * @param dev ADC emulator device
+ * @param chan ADC channel
+ * @param data User data (not used)
+ * @param result Input voltage (millivolts)
+ * @return Always returns 0
+ */
+static int display_benchmark_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result);
+
+/**
+ * @brief ADC channel driven by the benchmark
+ */
+static const struct adc_dt_spec display_benchmark_adc_channel = ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 0);
+
+#endif /* DISPLAY_BENCHMARK_WIND_SWEEP */
+
+/**
+ * @brief Benchmark samples of the current report period
+ */
+static struct display_benchmark_samples display_benchmark_timer_handler_samples;
+static struct display_benchmark_samples display_benchmark_render_samples;
+static struct display_benchmark_samples display_benchmark_invalidated_area_samples;
+
+/**
+ * @brief Current frame
+ */
+static uint32_t display_benchmark_render_start       = 0;
+static uint32_t display_benchmark_invalidated_area   = 0;
+static int64_t  display_benchmark_report_timestamp   = 0;
+static uint64_t display_benchmark_timer_handler_busy = 0;
+
+void
+display_benchmark_init(void) {
+
+    lv_monkey_config_t config;
+    lv_monkey_t       *monkey;
+
+    LOG_INF("Initializing display benchmark...");
+
+    /* Register to display events to measure rendering */
+    lv_display_add_event_cb(lv_display_get_default(), display_benchmark_event_callback, LV_EVENT_ALL, NULL);
+
+    /* Create monkey to simulate touch input */
+    lv_monkey_config_init(&config);
+    config.type             = LV_INDEV_TYPE_POINTER;
+    config.period_range.min = CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK_MONKEY_PERIOD_MIN_MS;
+    config.period_range.max = CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK_MONKEY_PERIOD_MAX_MS;
+    if (NULL == (monkey = lv_monkey_create(&config))) {
+        LOG_ERR("Unable to create monkey");
+    } else {
+        lv_monkey_set_enable(monkey, true);
+    }
+
+#ifdef DISPLAY_BENCHMARK_WIND_SWEEP
+    /* Drive the ADC emulator with scripted wind data */
+    if (0 != adc_emul_value_func_set(display_benchmark_adc_channel.dev, display_benchmark_adc_channel.channel_id, display_benchmark_adc_value_callback, NULL)) {
+        LOG_ERR("Unable to set ADC emulator value function");
+    }
+#endif /* DISPLAY_BENCHMARK_WIND_SWEEP */
+
+    display_benchmark_report_timestamp = k_uptime_get();
+
+    LOG_INF("Initializing display benchmark: DONE");
+}
+
+uint32_t
+display_benchmark_timestamp(void) {
+
+#ifdef CONFIG_ARCH_POSIX
+    /* Simulated time does not elapse while the code is executed, use host time */
+    return display_benchmark_bottom_time_ns();
+#else
+    return k_cycle_get_32();
+#endif /* CONFIG_ARCH_POSIX */
+}
+
+void
+display_benchmark_record_timer_handler(uint32_t start) {
+
+    uint32_t duration = display_benchmark_to_us(display_benchmark_timestamp() - start);
+    int64_t  now      = k_uptime_get();
+    int64_t  elapsed;
+    uint32_t load;
+
+    /* Record lv_timer_handler duration */
+    display_benchmark_samples_add(&display_benchmark_timer_handler_samples, duration);
+    display_benchmark_timer_handler_busy += duration;
+
+    /* Check if report should be printed */
+    elapsed = now - display_benchmark_report_timestamp;
+    if (elapsed < CONFIG_WIND_TURBINE_DISPLAY_BENCHMARK_REPORT_PERIOD_MS) {
+        return;
+    }
+
+    /* Print report, CPU load is given in per mille of the elapsed time */
+    load = (uint32_t)(display_benchmark_timer_handler_busy / elapsed);
+    LOG_INF("Display benchmark report over %lld ms, %u frames, CPU load %u.%u%%",
+            (long long)elapsed,
+            display_benchmark_render_samples.count + display_benchmark_render_samples.dropped,
+            load / 10,
+            load % 10);
+    display_benchmark_samples_report("lv_timer_handler", "us", &display_benchmark_timer_handler_samples);
+    display_benchmark_samples_report("frame render", "us", &display_benchmark_render_samples);
+    display_benchmark_samples_report("invalidated area", "px", &display_benchmark_invalidated_area_samples);
+    display_benchmark_timer_handler_busy = 0;
+    display_benchmark_report_timestamp   = now;
+}
+
+static void
+display_benchmark_event_callback(lv_event_t *event) {
+
+    const lv_area_t *area;
+
+    /* Treatment depending of the event */
+    switch (lv_event_get_code(event)) {
+        case LV_EVENT_INVALIDATE_AREA:
+            /* Accumulate invalidated area of the next frame */
+            if (NULL != (area = lv_event_get_param(event))) {
+                display_benchmark_invalidated_area += lv_area_get_size(area);
+            }
+            break;
+        case LV_EVENT_REFR_START:
+            display_benchmark_render_start = display_benchmark_timestamp();
+            break;
+        case LV_EVENT_REFR_READY:
+            /* Record frame, only if something has been rendered */
+            if (0 != display_benchmark_invalidated_area) {
+                display_benchmark_samples_add(&display_benchmark_render_samples,
+                                              display_benchmark_to_us(display_benchmark_timestamp() - display_benchmark_render_start));
+                display_benchmark_samples_add(&display_benchmark_invalidated_area_samples, display_benchmark_invalidated_area);
+                display_benchmark_invalidated_area = 0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+display_benchmark_samples_add(struct display_benchmark_samples *samples, uint32_t value) {
+
+    if (samples->count < DISPLAY_BENCHMARK_SAMPLES_COUNT) {
+        samples->values[samples->count++] = value;
+    } else {
+        samples->dropped++;
+    }
+    samples->sum += value;
+}
+
+static void
+display_benchmark_samples_report(const char *name, const char *unit, struct display_benchmark_samples *samples) {
+
+    uint32_t count = samples->count;
+
+    /* Check if samples are available */
+    if (0 == count) {
+        LOG_INF("  %s: no sample", name);
+        return;
+    }
+
+    /* Compute percentiles */
+    qsort(samples->values, count, sizeof(uint32_t), display_benchmark_samples_compare);
+    LOG_INF("  %s (%s): avg %u, p50 %u, p90 %u, p99 %u, max %u",
+            name,
+            unit,
+            (uint32_t)(samples->sum / (count + samples->dropped)),
+            samples->values[((count - 1) * 50) / 100],
+            samples->values[((count - 1) * 90) / 100],
+            samples->values[((count - 1) * 99) / 100],
+            samples->values[count - 1]);
+    if (0 != samples->dropped) {
+        LOG_WRN("  %s: %u samples not included in percentiles", name, samples->dropped);
+    }
+
+    /* Reset samples */
+    samples->count   = 0;
+    samples->dropped = 0;
+    samples->sum     = 0;
+}
+
+static int
+display_benchmark_samples_compare(const void *a, const void *b) {
+
+    uint32_t value_a = *(const uint32_t *)a;
+    uint32_t value_b = *(const uint32_t *)b;
+
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+static uint32_t
+display_benchmark_to_us(uint32_t delta) {
+
+#ifdef CONFIG_ARCH_POSIX
+    return delta / 1000;
+#else
+    return k_cyc_to_us_floor32(delta);
+#endif /* CONFIG_ARCH_POSIX */
+}
+
+#ifdef DISPLAY_BENCHMARK_WIND_SWEEP
+
+static int
+display_benchmark_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result) {
+
+    ARG_UNUSED(chan);
+    ARG_UNUSED(data);
+    uint32_t phase = k_uptime_get_32() % DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS;
+    uint32_t raw;
+
+    /* Triangle sweep from 0 to the full scale and back */
+    if (phase < (DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS / 2)) {
+        raw = (phase * DISPLAY_BENCHMARK_ADC_FULL_SCALE) / (DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS / 2);
+    } else {
+        raw = ((DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS - phase) * DISPLAY_BENCHMARK_ADC_FULL_SCALE) / (DISPLAY_BENCHMARK_WIND_SWEEP_PERIOD_MS / 2);
+    }
+
+    /* Convert raw value to input voltage */
+    *result = (MIN(raw, DISPLAY_BENCHMARK_ADC_FULL_SCALE - 1) * adc_ref_internal(dev)) / DISPLAY_BENCHMARK_ADC_FULL_SCALE;
+
+    return 0;
+}
+
+#endif /* DISPLAY_BENCHMARK_WIND_SWEEP */
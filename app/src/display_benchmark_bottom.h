@@ -0,0 +1,43 @@
+/**
+ * @file      display_benchmark_bottom.h
+ * @brief     Display benchmark host side APIs
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISPLAY_BENCHMARK_BOTTOM_H__
+#define __DISPLAY_BENCHMARK_BOTTOM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+
+/**
+ * @brief Get host monotonic time
+ * @note Simulated time does not elapse while the code is executed, host time is used to measure durations
+ * @return Host monotonic time (nanoseconds), truncated to 32 bits
+ */
+uint32_t display_benchmark_bottom_time_ns(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __DISPLAY_BENCHMARK_BOTTOM_H__ */
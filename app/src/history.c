@@ -0,0 +1,161 @@
+/**
+ * @file      history.c
+ * @brief     Long-history min/max store of the wind turbine output power
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zephyr/kernel.h>
+
+#include "history.h"
+
+/**
+ * @brief Empty column
+ */
+#define HISTORY_COLUMN_EMPTY ((struct history_column){ .min = UINT8_MAX, .max = 0 })
+
+/**
+ * @brief Timescale ring of columns
+ */
+struct history_ring {
+    struct history_column columns[HISTORY_COLUMNS_COUNT]; /**< Completed columns */
+    uint32_t              completed;                      /**< Number of columns completed since boot */
+    int64_t               slot;                           /**< Time slot of the current column */
+    struct history_column current;                        /**< Current column */
+    bool                  started;                        /**< At least one value has been added */
+};
+
+/**
+ * @brief Push a column to a ring
+ * @param ring Ring
+ * @param column Column
+ */
+static void history_push(struct history_ring *ring, struct history_column column);
+
+/**
+ * @brief Duration of the columns of each timescale (milliseconds)
+ */
+static const uint32_t history_column_duration[HISTORY_TIMESCALE_COUNT] = {
+    [HISTORY_TIMESCALE_1MIN]  = (60 * 1000) / HISTORY_COLUMNS_COUNT,
+    [HISTORY_TIMESCALE_10MIN] = (10 * 60 * 1000) / HISTORY_COLUMNS_COUNT,
+    [HISTORY_TIMESCALE_1H]    = (60 * 60 * 1000) / HISTORY_COLUMNS_COUNT,
+    [HISTORY_TIMESCALE_24H]   = (24 * 60 * 60 * 1000) / HISTORY_COLUMNS_COUNT,
+};
+
+/**
+ * @brief Name of each timescale
+ */
+static const char *history_timescale_name[HISTORY_TIMESCALE_COUNT] = {
+    [HISTORY_TIMESCALE_1MIN]  = "1 min",
+    [HISTORY_TIMESCALE_10MIN] = "10 min",
+    [HISTORY_TIMESCALE_1H]    = "1 h",
+    [HISTORY_TIMESCALE_24H]   = "24 h",
+};
+
+/**
+ * @brief Rings of each timescale
+ */
+static struct history_ring history_rings[HISTORY_TIMESCALE_COUNT];
+
+/**
+ * @brief Lock protecting the rings
+ */
+static struct k_spinlock history_lock;
+
+void
+history_add(uint8_t value) {
+
+    int64_t          now = k_uptime_get();
+    int64_t          slot, missed;
+    int              timescale;
+    k_spinlock_key_t key = k_spin_lock(&history_lock);
+
+    for (timescale = 0; timescale < HISTORY_TIMESCALE_COUNT; timescale++) {
+        struct history_ring *ring = &history_rings[timescale];
+        slot                      = now / history_column_duration[timescale];
+
+        /* Start the first column */
+        if (false == ring->started) {
+            ring->started = true;
+            ring->slot    = slot;
+            ring->current = HISTORY_COLUMN_EMPTY;
+        }
+
+        /* Complete the current column, and the columns of the slots without any value, when a new slot starts */
+        if (slot != ring->slot) {
+            history_push(ring, ring->current);
+            for (missed = MIN(slot - ring->slot - 1, HISTORY_COLUMNS_COUNT); missed > 0; missed--) {
+                history_push(ring, HISTORY_COLUMN_EMPTY);
+            }
+            ring->slot    = slot;
+            ring->current = HISTORY_COLUMN_EMPTY;
+        }
+
+        /* Update the current column */
+        ring->current.min = MIN(ring->current.min, value);
+        ring->current.max = MAX(ring->current.max, value);
+    }
+
+    k_spin_unlock(&history_lock, key);
+}
+
+uint32_t
+history_get_completed(enum history_timescale timescale) {
+
+    k_spinlock_key_t key       = k_spin_lock(&history_lock);
+    uint32_t         completed = history_rings[timescale].completed;
+
+    k_spin_unlock(&history_lock, key);
+
+    return completed;
+}
+
+uint32_t
+history_read(enum history_timescale timescale, struct history_column *columns) {
+
+    k_spinlock_key_t     key  = k_spin_lock(&history_lock);
+    struct history_ring *ring = &history_rings[timescale];
+    uint32_t             completed, index;
+
+    /* Copy columns from the oldest to the newest, columns not completed yet are empty */
+    completed = ring->completed;
+    for (index = 0; index < HISTORY_COLUMNS_COUNT; index++) {
+        if (completed + index < HISTORY_COLUMNS_COUNT) {
+            columns[index] = HISTORY_COLUMN_EMPTY;
+        } else {
+            columns[index] = ring->columns[(completed + index) % HISTORY_COLUMNS_COUNT];
+        }
+    }
+
+    k_spin_unlock(&history_lock, key);
+
+    return completed;
+}
+
+const char *
+history_get_timescale_name(enum history_timescale timescale) {
+
+    return history_timescale_name[timescale];
+}
+
+static void
+history_push(struct history_ring *ring, struct history_column column) {
+
+    ring->columns[ring->completed % HISTORY_COLUMNS_COUNT] = column;
+    ring->completed++;
+}
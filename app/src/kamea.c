@@ -23,16 +23,63 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(wind_turbine_kamea, LOG_LEVEL_INF);
 
+#include <zephyr/data/json.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/zbus/zbus.h>
 
 #include "app/subsys/kamea.h"
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+#include "boot_profile.h"
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+#ifdef CONFIG_WIND_TURBINE_KAMEA_GOVERNOR
+#include "kamea_governor.h"
+#endif /* CONFIG_WIND_TURBINE_KAMEA_GOVERNOR */
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA
+#include "kamea_ota.h"
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA */
 #include "messages.h"
+#ifdef CONFIG_WIND_TURBINE_REPLAY
+#include "replay.h"
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+#ifdef CONFIG_WIND_TURBINE_SOAK
+#include "soak.h"
+#endif /* CONFIG_WIND_TURBINE_SOAK */
 
 /**
  * @brief Period to send telemetry data (in multiple of the wind turbine sampling, 100ms x 100 = 10s)
+ * @note The period is stretched by multiples of this value by the governor when the link degrades
+ * @note In batch mode samples are averaged over 1 minute (100ms x 600) so that a burst holds fewer messages
  */
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+#define KAMEA_REAL_TIME_DATA_PERIOD (600)
+#else
 #define KAMEA_REAL_TIME_DATA_PERIOD (100)
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+/**
+ * @brief Wind turbine and inverter sampling frequency (Hz)
+ */
+#define KAMEA_SAMPLING_FREQUENCY (10)
+
+/**
+ * @brief Normal priority messages published every period (wind turbine, app, inverter and governor telemetry)
+ */
+#define KAMEA_REAL_TIME_DATA_MESSAGES (3 + (IS_ENABLED(CONFIG_WIND_TURBINE_KAMEA_GOVERNOR) ? 1 : 0))
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+/* The normal priority queue holds the telemetry of a whole batch interval, plus one period for jitter and one reported configs message */
+BUILD_ASSERT(CONFIG_KAMEA_MQTT_QUEUE_NORMAL_SIZE
+                 >= KAMEA_REAL_TIME_DATA_MESSAGES * (CONFIG_KAMEA_MQTT_BATCH_INTERVAL * KAMEA_SAMPLING_FREQUENCY / KAMEA_REAL_TIME_DATA_PERIOD + 1) + 1,
+             "CONFIG_KAMEA_MQTT_QUEUE_NORMAL_SIZE is too small for CONFIG_KAMEA_MQTT_BATCH_INTERVAL");
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+/**
+ * @brief Configs received from or reported to the Kamea server
+ */
+struct kamea_configs {
+    bool    turned_on; /**< The wind turbine is turned on */
+    int32_t limiter;   /**< Limiter (percent) */
+};
 
 /**
  * @brief Kamea initialization
@@ -57,6 +104,60 @@ static void kamea_disconnected_cb(void);
  */
 static void kamea_published_cb(uint16_t message_id, int result);
 
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+
+/**
+ * @brief Kamea MQTT connected callback
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_connected_cb(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Kamea MQTT disconnected callback
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_disconnected_cb(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Kamea MQTT published callback
+ * @param kamea Client instance
+ * @param message_id Message ID
+ * @param result 0 if the publish succeeds, error code otherwise
+ */
+static void kamea_mqtt_published_cb(kamea_mqtt_t *kamea, uint16_t message_id, int result);
+
+/**
+ * @brief Kamea desired configs handler
+ * @note The configs are parsed in place and applied to the wind turbine, then reported if they have changed
+ * @param slice Desired configs payload slice
+ * @param user_data User data
+ */
+static void kamea_configs_handler(const kamea_mqtt_slice_t *slice, void *user_data);
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+/**
+ * @brief Publish the current wind turbine configuration as reported configs
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_publish_reported_configs(void);
+
+/**
+ * @brief Publish telemetry payload
+ * @note Alerts are published with QoS 1, other telemetry with CONFIG_WIND_TURBINE_KAMEA_TELEMETRY_QOS, on the CoAP channel alerts are confirmable
+ * @param payload Telemetry payload
+ * @param priority Publish priority
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_publish_telemetry(char *payload, kamea_priority_t priority);
+
+/**
+ * @brief Publish configs payload
+ * @param payload Configs payload
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_publish_configs(char *payload);
+
 /**
  * @brief Buttons status callback
  * @note This callback is used to send the button status to the kamea server
@@ -84,6 +185,7 @@ static void kamea_inverter_status_cb(const struct zbus_channel *chan);
 ZBUS_CHAN_DECLARE(buttons_status_chan);
 ZBUS_CHAN_DECLARE(wind_turbine_status_chan);
 ZBUS_CHAN_DECLARE(inverter_status_chan);
+ZBUS_CHAN_DECLARE(wind_turbine_config_chan);
 
 /**
  * @brief Zbus listeners
@@ -92,6 +194,23 @@ ZBUS_LISTENER_DEFINE(kamea_buttons_status_listenner, kamea_buttons_status_cb);
 ZBUS_LISTENER_DEFINE(kamea_wind_turbine_status_listenner, kamea_wind_turbine_status_cb);
 ZBUS_LISTENER_DEFINE(kamea_inverter_status_listenner, kamea_inverter_status_cb);
 
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+
+/**
+ * @brief Kamea cloud MQTT client instance
+ */
+KAMEA_MQTT_DEFINE(kamea_cloud);
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+/**
+ * @brief Configs JSON descriptor, other fields are ignored
+ */
+static const struct json_obj_descr kamea_configs_descr[] = {
+    JSON_OBJ_DESCR_PRIM_NAMED(struct kamea_configs, "turnedOn", turned_on, JSON_TOK_TRUE),
+    JSON_OBJ_DESCR_PRIM(struct kamea_configs, limiter, JSON_TOK_NUMBER),
+};
+
 /**
  * @brief LED
  */
@@ -109,6 +228,52 @@ kamea_init(void) {
     LOG_INF("Initializing Kamea client...");
 
 #ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    /* FIXME: configuration should not be static, for example we can define this in files in the SD-Card */
+    extern uint8_t      public_cert[];
+    extern uint32_t     public_cert_len;
+    extern uint8_t      private_key[];
+    extern uint32_t     private_key_len;
+    extern uint8_t      ca_cert[];
+    extern uint32_t     ca_cert_len;
+    kamea_mqtt_config_t config = {
+        .client_id              = "wind_turbine_stm32f746g_disco",
+        .hostname               = CONFIG_KAMEA_CHANNEL_MQTT_URL,
+        .port                   = CONFIG_KAMEA_CHANNEL_MQTT_PORT,
+        .sec_tag                = CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG,
+        .ca_sec_tag             = CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG,
+        .public_cert            = public_cert,
+        .public_cert_len        = public_cert_len,
+        .private_key            = private_key,
+        .private_key_len        = private_key_len,
+        .ca_cert                = ca_cert,
+        .ca_cert_len            = ca_cert_len,
+        .callbacks.connected    = kamea_mqtt_connected_cb,
+        .callbacks.disconnected = kamea_mqtt_disconnected_cb,
+        .callbacks.published    = kamea_mqtt_published_cb,
+    };
+    /* Initialize Kamea MQTT channel */
+    if (0 != (result = kamea_mqtt_init(&kamea_cloud, &config))) {
+        LOG_ERR("Unable to initialize Kamea MQTT channel, result = %d", result);
+        goto END;
+    }
+    /* Subscribe to desired configs */
+    if (0 != (result = kamea_mqtt_subscribe(&kamea_cloud, "configs/desired", MQTT_QOS_1_AT_LEAST_ONCE, kamea_configs_handler, NULL))) {
+        LOG_ERR("Unable to subscribe to desired configs, result = %d", result);
+        goto END;
+    }
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA
+    /* Subscribe to firmware download topics */
+    if (0 != (result = kamea_ota_init())) {
+        goto END;
+    }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA */
+#ifndef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+    /* The network is not monitored by the Kamea MQTT channel, request the connection now */
+    kamea_mqtt_connect(&kamea_cloud);
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+#ifdef CONFIG_KAMEA_CHANNEL_COAP
     /* FIXME: configuration should not be static, for example we can define this in files in the SD-Card */
     const char            *client_id = "wind_turbine_stm32f746g_disco";
     extern uint8_t         public_cert[];
@@ -117,16 +282,20 @@ kamea_init(void) {
     extern uint32_t        private_key_len;
     extern uint8_t         ca_cert[];
     extern uint32_t        ca_cert_len;
-    kamea_mqtt_callbacks_t callbacks;
+    kamea_coap_callbacks_t callbacks;
     callbacks.connected    = kamea_connected_cb;
     callbacks.disconnected = kamea_disconnected_cb;
     callbacks.published    = kamea_published_cb;
-    /* Initialize Kamea MQTT channel */
-    if (0 != (result = kamea_mqtt_init((char *)client_id, public_cert, public_cert_len, private_key, private_key_len, ca_cert, ca_cert_len, &callbacks))) {
-        LOG_ERR("Unable to initialize Kamea MQTT channel, result = %d", result);
+    /* Initialize Kamea CoAP channel, desired configs are not received on this channel */
+    if (0 != (result = kamea_coap_init((char *)client_id, public_cert, public_cert_len, private_key, private_key_len, ca_cert, ca_cert_len, &callbacks))) {
+        LOG_ERR("Unable to initialize Kamea CoAP channel, result = %d", result);
         goto END;
     }
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+#ifndef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+    /* The network is not monitored by the Kamea CoAP channel, indicate it is available now */
+    kamea_coap_connect();
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+#endif /* CONFIG_KAMEA_CHANNEL_COAP */
 
     /* Initialize Kamea status LED */
     /* FIXME: could be better to move it to buttons.c and use Zbus to report Kamea status */
@@ -148,6 +317,13 @@ kamea_init(void) {
 
 END:
 
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+    /* The phase is only recorded if the client is initialized */
+    if (0 == result) {
+        boot_profile_record(BOOT_PHASE_KAMEA);
+    }
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+
     LOG_INF("Initializing Kamea client: DONE");
 
     return result;
@@ -158,6 +334,17 @@ kamea_connected_cb(void) {
 
     /* Switch ON the LED */
     gpio_pin_set_dt(&kamea_status_led, 0);
+
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+    boot_profile_record(BOOT_PHASE_FIRST_CONNACK);
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+
+#ifdef CONFIG_WIND_TURBINE_SOAK
+    soak_record_connection(true);
+#endif /* CONFIG_WIND_TURBINE_SOAK */
+
+    /* Report current configs */
+    kamea_publish_reported_configs();
 }
 
 static void
@@ -165,6 +352,10 @@ kamea_disconnected_cb(void) {
 
     /* Switch OFF the LED */
     gpio_pin_set_dt(&kamea_status_led, 1);
+
+#ifdef CONFIG_WIND_TURBINE_SOAK
+    soak_record_connection(false);
+#endif /* CONFIG_WIND_TURBINE_SOAK */
 }
 
 static void
@@ -176,6 +367,164 @@ kamea_published_cb(uint16_t message_id, int result) {
     /* Nothing to do for the moment */
 }
 
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+
+static void
+kamea_mqtt_connected_cb(kamea_mqtt_t *kamea) {
+
+    ARG_UNUSED(kamea);
+
+    kamea_connected_cb();
+
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA
+    /* Resume the firmware download in progress */
+    kamea_ota_connected();
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA */
+}
+
+static void
+kamea_mqtt_disconnected_cb(kamea_mqtt_t *kamea) {
+
+    ARG_UNUSED(kamea);
+
+    kamea_disconnected_cb();
+}
+
+static void
+kamea_mqtt_published_cb(kamea_mqtt_t *kamea, uint16_t message_id, int result) {
+
+    ARG_UNUSED(kamea);
+
+    kamea_published_cb(message_id, result);
+}
+
+static void
+kamea_configs_handler(const kamea_mqtt_slice_t *slice, void *user_data) {
+
+    ARG_UNUSED(user_data);
+    struct wind_turbine_config_msg current, config;
+    struct kamea_configs           configs;
+    int                            fields;
+
+    /* Desired configs are parsed in place, they must be received in a single slice */
+    if (slice->len != slice->total_len) {
+        if (0 == slice->offset) {
+            LOG_ERR("Unable to parse desired configs, payload is too large (%u bytes)", (uint32_t)slice->total_len);
+        }
+        return;
+    }
+
+    /* Retrieve current configuration */
+    if (0 != zbus_chan_read(&wind_turbine_config_chan, &current, K_MSEC(10))) {
+        LOG_ERR("Unable to read wind turbine configuration");
+        return;
+    }
+
+    /* Parse desired configs in place, only the fields present are applied */
+    if ((fields = json_obj_parse((char *)slice->data, slice->len, kamea_configs_descr, ARRAY_SIZE(kamea_configs_descr), &configs)) < 0) {
+        LOG_ERR("Unable to parse desired configs, result = %d", fields);
+        return;
+    }
+    config = current;
+    if (0 != (fields & BIT(0))) {
+        config.turned_on = configs.turned_on;
+    }
+    if (0 != (fields & BIT(1))) {
+        config.limiter = CLAMP(configs.limiter, 0, 100);
+    }
+
+    /* Apply and report configs if they have changed */
+    if ((config.turned_on == current.turned_on) && (config.limiter == current.limiter)) {
+        return;
+    }
+    LOG_INF("Applying desired configs: turned %s, limiter %d%%", (true == config.turned_on) ? "on" : "off", config.limiter);
+    if (0 != zbus_chan_pub(&wind_turbine_config_chan, &config, K_MSEC(10))) {
+        LOG_ERR("Unable to apply desired configs");
+        return;
+    }
+    kamea_publish_reported_configs();
+}
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+static int
+kamea_publish_reported_configs(void) {
+
+    char                           payload[128]; /* FIXME: should use json library */
+    struct wind_turbine_config_msg config;
+    int                            result;
+
+    /* Retrieve current configuration */
+    if (0 != (result = zbus_chan_read(&wind_turbine_config_chan, &config, K_MSEC(10)))) {
+        return result;
+    }
+
+    /* Format and publish payload */
+    snprintf(payload,
+             sizeof(payload),
+             "{ \"turnedOn\": %s, \"isProduction\": true, \"limiter\": %d }",
+             (true == config.turned_on) ? "true" : "false",
+             config.limiter);
+
+    return kamea_publish_configs(payload);
+}
+
+static int
+kamea_publish_telemetry(char *payload, kamea_priority_t priority) {
+
+    int result = -1;
+
+    ARG_UNUSED(priority);
+
+#ifdef CONFIG_WIND_TURBINE_REPLAY
+    /* Capture payload for golden-file comparison */
+    replay_capture("telemetries", payload, strlen(payload));
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    result = kamea_mqtt_publish_telemetry(&kamea_cloud,
+                                          (uint8_t *)payload,
+                                          strlen(payload),
+                                          (KAMEA_PRIORITY_HIGH == priority) ? MQTT_QOS_1_AT_LEAST_ONCE : CONFIG_WIND_TURBINE_KAMEA_TELEMETRY_QOS,
+                                          priority);
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+#ifdef CONFIG_KAMEA_CHANNEL_COAP
+    result = kamea_coap_publish_telemetry((uint8_t *)payload, strlen(payload), priority);
+#endif /* CONFIG_KAMEA_CHANNEL_COAP */
+
+#ifdef CONFIG_WIND_TURBINE_SOAK
+    soak_record_publish(result);
+#endif /* CONFIG_WIND_TURBINE_SOAK */
+
+    return result;
+}
+
+static int
+kamea_publish_configs(char *payload) {
+
+    int result = -1;
+
+#ifdef CONFIG_WIND_TURBINE_REPLAY
+    /* Capture payload for golden-file comparison */
+    replay_capture("configs/reported", payload, strlen(payload));
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    result = kamea_mqtt_publish_configs(&kamea_cloud, (uint8_t *)payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_NORMAL);
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+#ifdef CONFIG_KAMEA_CHANNEL_COAP
+    result = kamea_coap_publish_configs((uint8_t *)payload, strlen(payload), KAMEA_PRIORITY_NORMAL);
+#endif /* CONFIG_KAMEA_CHANNEL_COAP */
+
+#ifdef CONFIG_WIND_TURBINE_SOAK
+    soak_record_publish(result);
+#endif /* CONFIG_WIND_TURBINE_SOAK */
+
+    return result;
+}
+
 static void
 kamea_buttons_status_cb(const struct zbus_channel *chan) {
 
@@ -183,79 +532,94 @@ kamea_buttons_status_cb(const struct zbus_channel *chan) {
     const struct button_status_msg *button_status_msg = zbus_chan_const_msg(chan);
 
     /* Format payload */
-    snprintf(payload, sizeof(payload), "{ \"alert\": { \"name\": \"%s\", \"state\": %d } }", button_status_msg->name, button_status_msg->state);
+    snprintf(payload,
+             sizeof(payload),
+             "{ \"alert\": { \"name\": \"%s\", \"state\": %d, \"longPress\": %d } }",
+             button_status_msg->name,
+             button_status_msg->state,
+             button_status_msg->long_press);
 
-    /* Publish payload */
-#ifdef CONFIG_KAMEA_CHANNEL_MQTT
-    kamea_mqtt_publish_telemetry(payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE);
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+    /* Publish payload, alerts are sent before any other message */
+    kamea_publish_telemetry(payload, KAMEA_PRIORITY_HIGH);
 }
 
 static void
 kamea_wind_turbine_status_cb(const struct zbus_channel *chan) {
 
-    char                                  payload[128]; /* FIXME: should use json library */
+    char                                  payload[128];     /* FIXME: should use json library */
+    char                                  app_payload[128]; /* FIXME: should use json library */
     const struct wind_turbine_status_msg *wind_turbine_status_msg = zbus_chan_const_msg(chan);
-    static uint16_t                       wind_speed[KAMEA_REAL_TIME_DATA_PERIOD];
-    static uint16_t                       generator_rpm[KAMEA_REAL_TIME_DATA_PERIOD];
-    static uint16_t                       output_voltage[KAMEA_REAL_TIME_DATA_PERIOD];
-    static uint16_t                       output_power[KAMEA_REAL_TIME_DATA_PERIOD];
-    static size_t                         count              = 0;
-    uint32_t                              wind_speed_avg     = 0;
-    uint32_t                              generator_rpm_avg  = 0;
-    uint32_t                              output_voltage_avg = 0;
-    uint32_t                              output_power_avg   = 0;
-    size_t                                index;
-
-    /* Save wind turbine data */
-    wind_speed[count]     = wind_turbine_status_msg->wind_speed;
-    generator_rpm[count]  = wind_turbine_status_msg->generator_rpm;
-    output_voltage[count] = wind_turbine_status_msg->output_voltage;
-    output_power[count]   = wind_turbine_status_msg->output_power;
+    static uint32_t                       wind_speed_sum          = 0;
+    static uint32_t                       generator_rpm_sum       = 0;
+    static uint32_t                       output_voltage_sum      = 0;
+    static uint32_t                       output_power_sum        = 0;
+    static uint32_t                       count                   = 0;
+    uint32_t                              wind_speed_avg, generator_rpm_avg, output_voltage_avg, output_power_avg;
+#ifdef CONFIG_WIND_TURBINE_KAMEA_GOVERNOR
+    struct kamea_governor_status governor_status;
+#endif /* CONFIG_WIND_TURBINE_KAMEA_GOVERNOR */
+
+    /* Accumulate wind turbine data */
+    wind_speed_sum += wind_turbine_status_msg->wind_speed;
+    generator_rpm_sum += wind_turbine_status_msg->generator_rpm;
+    output_voltage_sum += wind_turbine_status_msg->output_voltage;
+    output_power_sum += wind_turbine_status_msg->output_power;
     count++;
 
     /* Check if wind turbine data are ready to be sent */
-    if (count < KAMEA_REAL_TIME_DATA_PERIOD) {
+    if (0 != (count % KAMEA_REAL_TIME_DATA_PERIOD)) {
         return;
     }
-    count = 0;
 
     /* Compute average data */
-    for (index = 0; index < KAMEA_REAL_TIME_DATA_PERIOD; index++) {
-        wind_speed_avg += wind_speed[index];
-        generator_rpm_avg += generator_rpm[index];
-        output_voltage_avg += output_voltage[index];
-        output_power_avg += output_power[index];
-    }
-    wind_speed_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-    generator_rpm_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-    output_voltage_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-    output_power_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
+    wind_speed_avg     = wind_speed_sum / count;
+    generator_rpm_avg  = generator_rpm_sum / count;
+    output_voltage_avg = output_voltage_sum / count;
+    output_power_avg   = output_power_sum / count;
 
     /* Format Wind Turbine payload */
     snprintf(payload, sizeof(payload), "{ \"wind_turbine\": { \"output_voltage\": %d, \"output_power\": %d } }", output_voltage_avg, output_power_avg);
 
-    /* Publish payload */
-#ifdef CONFIG_KAMEA_CHANNEL_MQTT
-    kamea_mqtt_publish_telemetry(payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE);
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
-
-    /* Format config payload */ /* FIXME: should be dynamic and depends on configuration given by the user, use static values for now */
-    snprintf(payload, sizeof(payload), "{ \"turnedOn\": true, \"isProduction\": true, \"limiter\": 30 }");
-
-    /* Publish payload */
-#ifdef CONFIG_KAMEA_CHANNEL_MQTT
-    kamea_mqtt_publish_configs(payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE);
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
-
     /* Format App payload */
-    snprintf(
-        payload, sizeof(payload), "{ \"energyProduction\": %d, \"generator\": %d, \"windSpeed\": %d }", output_power_avg, generator_rpm_avg, wind_speed_avg);
+    snprintf(app_payload,
+             sizeof(app_payload),
+             "{ \"energyProduction\": %d, \"generator\": %d, \"windSpeed\": %d }",
+             output_power_avg,
+             generator_rpm_avg,
+             wind_speed_avg);
+
+#ifdef CONFIG_WIND_TURBINE_KAMEA_GOVERNOR
+    /* Stretch the aggregation period while the budget is not sufficient, up to the maximum period */
+    if (false
+        == kamea_governor_acquire(strlen(payload) + strlen(app_payload),
+                                  count >= CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_MAX_STRETCH * KAMEA_REAL_TIME_DATA_PERIOD)) {
+        return;
+    }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_GOVERNOR */
 
-    /* Publish payload */
-#ifdef CONFIG_KAMEA_CHANNEL_MQTT
-    kamea_mqtt_publish_telemetry(payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE);
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+    /* Publish payloads */
+    kamea_publish_telemetry(payload, KAMEA_PRIORITY_NORMAL);
+    kamea_publish_telemetry(app_payload, KAMEA_PRIORITY_NORMAL);
+
+#ifdef CONFIG_WIND_TURBINE_KAMEA_GOVERNOR
+    /* Format and publish governor payload, aggregation period is given in seconds */
+    kamea_governor_get_status(&governor_status);
+    snprintf(payload,
+             sizeof(payload),
+             "{ \"governor\": { \"budget\": %d, \"rate\": %u, \"period\": %u } }",
+             governor_status.budget,
+             governor_status.rate,
+             count / KAMEA_SAMPLING_FREQUENCY);
+    kamea_governor_acquire(strlen(payload), true);
+    kamea_publish_telemetry(payload, KAMEA_PRIORITY_NORMAL);
+#endif /* CONFIG_WIND_TURBINE_KAMEA_GOVERNOR */
+
+    /* Reset aggregation */
+    wind_speed_sum     = 0;
+    generator_rpm_sum  = 0;
+    output_voltage_sum = 0;
+    output_power_sum   = 0;
+    count              = 0;
 }
 
 static void
@@ -263,49 +627,45 @@ kamea_inverter_status_cb(const struct zbus_channel *chan) {
 
     char                              payload[128]; /* FIXME: should use json library */
     const struct inverter_status_msg *inverter_status_msg = zbus_chan_const_msg(chan);
-    static uint16_t                   output_voltage[KAMEA_REAL_TIME_DATA_PERIOD];
-    static uint16_t                   output_power[KAMEA_REAL_TIME_DATA_PERIOD];
-    static double                     frequency[KAMEA_REAL_TIME_DATA_PERIOD];
-    static size_t                     count              = 0;
-    uint32_t                          output_voltage_avg = 0;
-    uint32_t                          output_power_avg   = 0;
-    double                            frequency_avg      = 0;
-    size_t                            index;
-
-    /* Save inverter data */
-    output_voltage[count] = inverter_status_msg->output_voltage;
-    output_power[count]   = inverter_status_msg->output_power;
-    frequency[count]      = inverter_status_msg->frequency;
+    static uint32_t                   output_voltage_sum  = 0;
+    static uint32_t                   output_power_sum    = 0;
+    static double                     frequency_sum       = 0;
+    static uint32_t                   count               = 0;
+
+    /* Accumulate inverter data */
+    output_voltage_sum += inverter_status_msg->output_voltage;
+    output_power_sum += inverter_status_msg->output_power;
+    frequency_sum += inverter_status_msg->frequency;
     count++;
 
     /* Check if inverter data are ready to be sent */
-    if (count < KAMEA_REAL_TIME_DATA_PERIOD) {
+    if (0 != (count % KAMEA_REAL_TIME_DATA_PERIOD)) {
         return;
     }
-    count = 0;
 
-    /* Compute average data */
-    for (index = 0; index < KAMEA_REAL_TIME_DATA_PERIOD; index++) {
-        output_voltage_avg += output_voltage[index];
-        output_power_avg += output_power[index];
-        frequency_avg += frequency[index];
-    }
-    output_voltage_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-    output_power_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-    frequency_avg /= KAMEA_REAL_TIME_DATA_PERIOD;
-
-    /* Format payload */
+    /* Format payload with average data */
     snprintf(payload,
              sizeof(payload),
              "{ \"inverter\": { \"output_voltage\": %d, \"output_power\": %d, \"frequency\": %f } }",
-             output_voltage_avg,
-             output_power_avg,
-             frequency_avg);
+             output_voltage_sum / count,
+             output_power_sum / count,
+             frequency_sum / count);
+
+#ifdef CONFIG_WIND_TURBINE_KAMEA_GOVERNOR
+    /* Stretch the aggregation period while the budget is not sufficient, up to the maximum period */
+    if (false == kamea_governor_acquire(strlen(payload), count >= CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_MAX_STRETCH * KAMEA_REAL_TIME_DATA_PERIOD)) {
+        return;
+    }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_GOVERNOR */
 
     /* Publish payload */
-#ifdef CONFIG_KAMEA_CHANNEL_MQTT
-    kamea_mqtt_publish_telemetry(payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE);
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+    kamea_publish_telemetry(payload, KAMEA_PRIORITY_NORMAL);
+
+    /* Reset aggregation */
+    output_voltage_sum = 0;
+    output_power_sum   = 0;
+    frequency_sum      = 0;
+    count              = 0;
 }
 
 /**
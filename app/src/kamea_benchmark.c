@@ -0,0 +1,834 @@
+/**
+ * @file      kamea_benchmark.c
+ * @brief     Kamea publish latency benchmark
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#ifdef CONFIG_MBEDTLS_MEMORY_DEBUG
+#include <mbedtls/memory_buffer_alloc.h>
+#endif /* CONFIG_MBEDTLS_MEMORY_DEBUG */
+
+#include "app/subsys/kamea.h"
+
+/**
+ * @brief Default periods of the alerts and telemetry published during the benchmark (milliseconds)
+ */
+#define KAMEA_BENCHMARK_ALERT_PERIOD_MS     (500)
+#define KAMEA_BENCHMARK_TELEMETRY_PERIOD_MS (1000)
+
+/**
+ * @brief Period used to refill the bulk queue (milliseconds)
+ */
+#define KAMEA_BENCHMARK_REFILL_PERIOD_MS (10)
+
+/**
+ * @brief Size of the chunks of the streamed uploads (bytes)
+ */
+#define KAMEA_BENCHMARK_CHUNK_SIZE (256)
+
+/**
+ * @brief Maximum time waiting for each streamed upload to be written to the socket
+ */
+#define KAMEA_BENCHMARK_UPLOAD_TIMEOUT K_SECONDS(30)
+
+/**
+ * @brief Maximum time waiting for all the sessions to be connected (milliseconds)
+ */
+#define KAMEA_BENCHMARK_SESSIONS_CONNECT_TIMEOUT_MS (60000)
+
+/**
+ * @brief Default time spent disconnected by the reconnect benchmark and maximum time waiting for each step (milliseconds)
+ */
+#define KAMEA_BENCHMARK_RECONNECT_OFFLINE_MS (5000)
+#define KAMEA_BENCHMARK_RECONNECT_TIMEOUT_MS (10000)
+
+/**
+ * @brief Streamed upload context
+ */
+struct kamea_benchmark_upload {
+    size_t remaining; /**< Number of bytes remaining to give to the iterator */
+};
+
+/**
+ * @brief Shell command used to run the benchmark
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: duration (seconds), alert period (milliseconds), telemetry period (milliseconds)
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Shell command used to run the streamed upload benchmark
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: payload size (bytes), number of uploads
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_upload_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Shell command used to run the reconnect benchmark
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: number of reconnections, time spent disconnected (milliseconds)
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_reconnect_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Shell command used to run the TLS handshake benchmark
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: number of handshakes
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_handshake_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Wait for the client connection state
+ * @param connected Expected connection state
+ * @return true if the state is reached before the timeout, false otherwise
+ */
+static bool kamea_benchmark_reconnect_wait(bool connected);
+
+#if CONFIG_KAMEA_MQTT_INSTANCES > 1
+
+/**
+ * @brief Shell command used to run the sessions scaling benchmark
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments: number of sessions, duration (seconds), telemetry period (milliseconds)
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_sessions_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Benchmark session connected callback
+ * @param kamea Client instance
+ */
+static void kamea_benchmark_sessions_connected_cb(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Benchmark session disconnected callback
+ * @param kamea Client instance
+ */
+static void kamea_benchmark_sessions_disconnected_cb(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Count the benchmark sessions connected
+ * @return Number of sessions connected
+ */
+static int kamea_benchmark_sessions_count(void);
+
+#endif /* CONFIG_KAMEA_MQTT_INSTANCES > 1 */
+
+/**
+ * @brief Iterator of the streamed uploads
+ * @param user_data Streamed upload context
+ * @param chunk Next chunk
+ * @return Length of the chunk
+ */
+static int kamea_benchmark_upload_next(void *user_data, const uint8_t **chunk);
+
+/**
+ * @brief Report publish latency percentiles of a priority
+ * @param sh Shell
+ * @param name Name of the priority
+ * @param priority Publish priority
+ */
+static void kamea_benchmark_report(const struct shell *sh, const char *name, kamea_priority_t priority);
+
+/**
+ * @brief Report QoS 1 latency percentiles of a priority, from queuing to PUBACK
+ * @param sh Shell
+ * @param name Name of the priority
+ * @param priority Publish priority
+ */
+static void kamea_benchmark_report_ack(const struct shell *sh, const char *name, kamea_priority_t priority);
+
+/**
+ * @brief Report received messages dispatch time percentiles
+ * @param sh Shell
+ */
+static void kamea_benchmark_report_dispatch(const struct shell *sh);
+
+/**
+ * @brief Report percentiles of samples
+ * @param sh Shell
+ * @param name Name of the samples
+ * @param unit Unit of the samples
+ * @param count Number of samples
+ */
+static void kamea_benchmark_report_samples(const struct shell *sh, const char *name, const char *unit, size_t count);
+
+/**
+ * @brief Handler of the messages received on the benchmark topics, only counts them
+ * @param slice Payload slice
+ * @param user_data User data
+ */
+static void kamea_benchmark_handler(const kamea_mqtt_slice_t *slice, void *user_data);
+
+/**
+ * @brief Subscribe to the benchmark topics
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_benchmark_init(void);
+
+/**
+ * @brief Compare two samples, used to sort samples
+ * @param a First sample
+ * @param b Second sample
+ * @return Negative value, 0 or positive value if a is lower, equal or greater than b
+ */
+static int kamea_benchmark_samples_compare(const void *a, const void *b);
+
+/**
+ * @brief Kamea cloud MQTT client instance
+ */
+KAMEA_MQTT_DECLARE(kamea_cloud);
+
+#if CONFIG_KAMEA_MQTT_INSTANCES > 1
+
+/**
+ * @brief Benchmark sessions, using all the client instances left by the application
+ */
+static kamea_mqtt_t kamea_benchmark_sessions[CONFIG_KAMEA_MQTT_INSTANCES - 1];
+
+/**
+ * @brief Number of benchmark sessions initialized, and sessions connected
+ * @note The disconnected callback is also invoked when a connection attempt fails, so connected sessions are tracked individually
+ */
+static size_t kamea_benchmark_sessions_initialized = 0;
+static ATOMIC_DEFINE(kamea_benchmark_sessions_connected, CONFIG_KAMEA_MQTT_INSTANCES);
+
+#endif /* CONFIG_KAMEA_MQTT_INSTANCES > 1 */
+
+/**
+ * @brief Bulk payload, filled up to the maximum payload size
+ */
+static char kamea_benchmark_bulk[CONFIG_KAMEA_MQTT_PAYLOAD_SIZE + 1];
+
+/**
+ * @brief Chunk of the streamed uploads, the same chunk is given repeatedly
+ */
+static uint8_t kamea_benchmark_chunk[KAMEA_BENCHMARK_CHUNK_SIZE];
+
+/**
+ * @brief Latency samples
+ */
+static uint32_t kamea_benchmark_samples[CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];
+
+/**
+ * @brief Number of messages and bytes received on the benchmark topics
+ */
+static atomic_t kamea_benchmark_received       = ATOMIC_INIT(0);
+static atomic_t kamea_benchmark_received_bytes = ATOMIC_INIT(0);
+
+static int
+kamea_benchmark_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    int64_t  duration         = 1000LL * atoi(argv[1]);
+    int32_t  alert_period     = (argc > 2) ? atoi(argv[2]) : KAMEA_BENCHMARK_ALERT_PERIOD_MS;
+    int32_t  telemetry_period = (argc > 3) ? atoi(argv[3]) : KAMEA_BENCHMARK_TELEMETRY_PERIOD_MS;
+    int64_t  start            = k_uptime_get();
+    int64_t  next_alert       = start + alert_period;
+    int64_t  next_telemetry   = start + telemetry_period;
+    uint32_t bulk_count       = 0;
+    uint32_t alert_count      = 0;
+    uint32_t alert_failed     = 0;
+    uint32_t telemetry_count  = 0;
+    uint32_t telemetry_failed = 0;
+    char     payload[96];
+    size_t   len;
+
+    /* Reset received messages counters */
+    atomic_clear(&kamea_benchmark_received);
+    atomic_clear(&kamea_benchmark_received_bytes);
+
+    /* Check arguments */
+    if ((duration <= 0) || (alert_period <= 0) || (telemetry_period <= 0)) {
+        shell_error(sh, "Invalid arguments");
+        return -EINVAL;
+    }
+
+    /* Prepare bulk payload */
+    len = snprintf(kamea_benchmark_bulk, sizeof(kamea_benchmark_bulk), "{ \"bulk\": \"");
+    memset(&kamea_benchmark_bulk[len], 'x', CONFIG_KAMEA_MQTT_PAYLOAD_SIZE - len - 3);
+    strcpy(&kamea_benchmark_bulk[CONFIG_KAMEA_MQTT_PAYLOAD_SIZE - 3], "\" }");
+
+    shell_print(sh, "Saturating uplink for %lld s, alert every %d ms, telemetry every %d ms...", duration / 1000, alert_period, telemetry_period);
+    while (k_uptime_get() - start < duration) {
+
+        /* Keep the low priority queue full so that the uplink is saturated */
+        while (0
+               == kamea_mqtt_publish_telemetry(
+                   &kamea_cloud, (uint8_t *)kamea_benchmark_bulk, strlen(kamea_benchmark_bulk), MQTT_QOS_0_AT_MOST_ONCE, KAMEA_PRIORITY_LOW)) {
+            bulk_count++;
+        }
+
+        /* Publish alert */
+        if (k_uptime_get() >= next_alert) {
+            snprintf(payload, sizeof(payload), "{ \"alert\": { \"name\": \"Benchmark\", \"state\": %d, \"longPress\": 0 } }", alert_count % 2);
+            if (0 == kamea_mqtt_publish_telemetry(&kamea_cloud, (uint8_t *)payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_HIGH)) {
+                alert_count++;
+            } else {
+                alert_failed++;
+            }
+            next_alert += alert_period;
+        }
+
+        /* Publish telemetry */
+        if (k_uptime_get() >= next_telemetry) {
+            snprintf(payload, sizeof(payload), "{ \"benchmark\": { \"bulk\": %u, \"alerts\": %u } }", bulk_count, alert_count);
+            if (0
+                == kamea_mqtt_publish_telemetry(
+                    &kamea_cloud, (uint8_t *)payload, strlen(payload), CONFIG_WIND_TURBINE_KAMEA_TELEMETRY_QOS, KAMEA_PRIORITY_NORMAL)) {
+                telemetry_count++;
+            } else {
+                telemetry_failed++;
+            }
+            next_telemetry += telemetry_period;
+        }
+
+        k_sleep(K_MSEC(KAMEA_BENCHMARK_REFILL_PERIOD_MS));
+    }
+
+    /* Report */
+    shell_print(sh,
+                "Queued: %u bulk, %u alerts (%u failed), %u telemetry (%u failed)",
+                bulk_count,
+                alert_count,
+                alert_failed,
+                telemetry_count,
+                telemetry_failed);
+    shell_print(sh, "Latest publish latencies, from queuing to writing to the socket:");
+    kamea_benchmark_report(sh, "alert", KAMEA_PRIORITY_HIGH);
+    kamea_benchmark_report(sh, "telemetry", KAMEA_PRIORITY_NORMAL);
+    kamea_benchmark_report(sh, "bulk", KAMEA_PRIORITY_LOW);
+    shell_print(sh, "Latest QoS 1 latencies, from queuing to PUBACK (alerts are the QoS 1 probe):");
+    kamea_benchmark_report_ack(sh, "alert", KAMEA_PRIORITY_HIGH);
+    kamea_benchmark_report_ack(sh, "telemetry", KAMEA_PRIORITY_NORMAL);
+    kamea_benchmark_report_dispatch(sh);
+
+    return 0;
+}
+
+static int
+kamea_benchmark_upload_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    int                           size   = atoi(argv[1]);
+    int                           count  = (argc > 2) ? atoi(argv[2]) : 1;
+    kamea_mqtt_stream_t           stream = { .len = size, .next = kamea_benchmark_upload_next };
+    struct kamea_benchmark_upload upload;
+    uint32_t                      failed = 0;
+    int64_t                       start, duration;
+
+    /* Check arguments */
+    if ((size <= 0) || (count <= 0)) {
+        shell_error(sh, "Invalid arguments");
+        return -EINVAL;
+    }
+
+    /* Prepare chunk */
+    memset(kamea_benchmark_chunk, 'x', sizeof(kamea_benchmark_chunk));
+
+    /* Stream payloads, each upload returns when the payload is written to the socket */
+    shell_print(sh, "Streaming %d payloads of %d bytes...", count, size);
+    start = k_uptime_get();
+    for (int index = 0; index < count; index++) {
+        upload.remaining = size;
+        stream.user_data = &upload;
+        if (0 != kamea_mqtt_publish_telemetry_stream(&kamea_cloud, &stream, MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_LOW, KAMEA_BENCHMARK_UPLOAD_TIMEOUT)) {
+            failed++;
+        }
+    }
+    duration = MAX(k_uptime_get() - start, 1);
+
+    /* Report */
+    shell_print(sh,
+                "Streamed %u bytes in %lld ms (%u failed): %u bytes/s, PUBACK round-trip time %u us",
+                (uint32_t)((count - failed) * size),
+                duration,
+                failed,
+                (uint32_t)((1000LL * (count - failed) * size) / duration),
+                kamea_mqtt_get_puback_rtt(&kamea_cloud));
+
+    return 0;
+}
+
+static int
+kamea_benchmark_reconnect_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    int                        count       = atoi(argv[1]);
+    int32_t                    offline     = (argc > 2) ? atoi(argv[2]) : KAMEA_BENCHMARK_RECONNECT_OFFLINE_MS;
+    uint64_t                   received_ms = 0, acknowledged_ms = 0;
+    uint32_t                   received = 0, acknowledged = 0, failed = 0;
+    kamea_mqtt_session_stats_t before, after;
+    char                       payload[64];
+    int64_t                    start;
+    bool                       queued;
+
+    /* Check arguments */
+    if ((count <= 0) || (offline < 0)) {
+        shell_error(sh, "Invalid arguments");
+        return -EINVAL;
+    }
+    if (false == kamea_mqtt_is_connected(&kamea_cloud)) {
+        shell_error(sh, "Client is not connected");
+        return -ENOTCONN;
+    }
+
+    kamea_mqtt_get_session_stats(&kamea_cloud, &before);
+    shell_print(sh, "Reconnecting %d times, %d ms disconnected each time...", count, offline);
+    for (int index = 0; index < count; index++) {
+
+        /* Disconnect, the client closes the connection once the queued messages are sent */
+        kamea_mqtt_disconnect(&kamea_cloud);
+        if (false == kamea_benchmark_reconnect_wait(false)) {
+            shell_error(sh, "Timeout waiting for disconnection");
+            failed++;
+            break;
+        }
+
+        /* Publish a message while disconnected, it is only accepted with a persistent session */
+        snprintf(payload, sizeof(payload), "{ \"benchmark\": { \"reconnect\": %d } }", index);
+        queued = (0
+                  == kamea_mqtt_publish_telemetry(
+                      &kamea_cloud, (uint8_t *)payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_NORMAL));
+        k_msleep(offline);
+
+        /* Reconnect and wait for the first message delivered by the broker and the first PUBACK */
+        kamea_mqtt_get_session_stats(&kamea_cloud, &after);
+        received     = after.received;
+        acknowledged = after.acknowledged;
+        kamea_mqtt_connect(&kamea_cloud);
+        if (false == kamea_benchmark_reconnect_wait(true)) {
+            shell_error(sh, "Timeout waiting for connection");
+            failed++;
+            break;
+        }
+        if (false == queued) {
+            kamea_mqtt_publish_telemetry(&kamea_cloud, (uint8_t *)payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_NORMAL);
+        }
+        start = k_uptime_get();
+        do {
+            k_msleep(KAMEA_BENCHMARK_REFILL_PERIOD_MS);
+            kamea_mqtt_get_session_stats(&kamea_cloud, &after);
+        } while (((after.received == received) || (after.acknowledged == acknowledged))
+                 && (k_uptime_get() - start < KAMEA_BENCHMARK_RECONNECT_TIMEOUT_MS));
+        if (after.received != received) {
+            received_ms += after.received_ms;
+        } else {
+            failed++;
+        }
+        if (after.acknowledged != acknowledged) {
+            acknowledged_ms += after.acknowledged_ms;
+        }
+    }
+
+    /* Report */
+    kamea_mqtt_get_session_stats(&kamea_cloud, &after);
+    received     = after.received - before.received;
+    acknowledged = after.acknowledged - before.acknowledged;
+    shell_print(sh,
+                "Sessions: %u (%u resumed), %u QoS 1 messages sent again, %u reconnections without message received",
+                after.sessions - before.sessions,
+                after.resumed - before.resumed,
+                after.resent - before.resent,
+                failed);
+    shell_print(sh,
+                "Average time from reconnecting to the first message received: %u ms (%u samples), to the first PUBACK: %u ms (%u samples)",
+                (0 != received) ? (uint32_t)(received_ms / received) : 0,
+                received,
+                (0 != acknowledged) ? (uint32_t)(acknowledged_ms / acknowledged) : 0,
+                acknowledged);
+
+    return 0;
+}
+
+static int
+kamea_benchmark_handshake_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    extern uint32_t    public_cert_len;
+    extern uint32_t    private_key_len;
+    extern uint32_t    ca_cert_len;
+    int                count = atoi(argv[1]);
+    uint32_t           min = UINT32_MAX, max = 0, done = 0;
+    uint64_t           sum = 0;
+    kamea_mqtt_stats_t before, after;
+
+    ARG_UNUSED(argc);
+
+    /* Check arguments */
+    if (count <= 0) {
+        shell_error(sh, "Invalid arguments");
+        return -EINVAL;
+    }
+    if (false == kamea_mqtt_is_connected(&kamea_cloud)) {
+        shell_error(sh, "Client is not connected");
+        return -ENOTCONN;
+    }
+
+    shell_print(sh, "Performing %d TLS handshakes...", count);
+    for (int index = 0; index < count; index++) {
+
+        /* Disconnect */
+        kamea_mqtt_disconnect(&kamea_cloud);
+        if (false == kamea_benchmark_reconnect_wait(false)) {
+            shell_error(sh, "Timeout waiting for disconnection");
+            break;
+        }
+
+#ifdef CONFIG_MBEDTLS_MEMORY_DEBUG
+        /* Measure the peak heap usage of the handshake and of the session */
+        mbedtls_memory_buffer_alloc_max_reset();
+#endif /* CONFIG_MBEDTLS_MEMORY_DEBUG */
+
+        /* Reconnect, the handshake is timed by the client */
+        kamea_mqtt_get_stats(&kamea_cloud, &before);
+        kamea_mqtt_connect(&kamea_cloud);
+        if (false == kamea_benchmark_reconnect_wait(true)) {
+            shell_error(sh, "Timeout waiting for connection");
+            break;
+        }
+        kamea_mqtt_get_stats(&kamea_cloud, &after);
+        if (after.handshakes != before.handshakes) {
+            min = MIN(min, after.handshake_ms);
+            max = MAX(max, after.handshake_ms);
+            sum += after.handshake_ms;
+            done++;
+        }
+    }
+
+    /* Report */
+    if (0 == done) {
+        shell_error(sh, "No handshake completed");
+        return -EIO;
+    }
+    shell_print(sh,
+                "%u handshakes with cipher suite 0x%04x: min %u ms, average %u ms, max %u ms",
+                done,
+                after.ciphersuite,
+                min,
+                (uint32_t)(sum / done),
+                max);
+    shell_print(sh,
+                "%s credentials: certificate %u bytes, private key %u bytes, CA %u bytes",
+                IS_ENABLED(CONFIG_WIND_TURBINE_KAMEA_CREDENTIALS_DER) ? "DER" : "PEM",
+                public_cert_len,
+                private_key_len,
+                ca_cert_len);
+#ifdef CONFIG_MBEDTLS_MEMORY_DEBUG
+    size_t max_used, max_blocks;
+    mbedtls_memory_buffer_alloc_max_get(&max_used, &max_blocks);
+    shell_print(sh, "Peak mbedTLS heap: %zu / %d bytes, %zu blocks", max_used, CONFIG_MBEDTLS_HEAP_SIZE, max_blocks);
+#endif /* CONFIG_MBEDTLS_MEMORY_DEBUG */
+
+    return 0;
+}
+
+static bool
+kamea_benchmark_reconnect_wait(bool connected) {
+
+    int64_t start = k_uptime_get();
+
+    /* Poll the connection state */
+    while (connected != kamea_mqtt_is_connected(&kamea_cloud)) {
+        if (k_uptime_get() - start >= KAMEA_BENCHMARK_RECONNECT_TIMEOUT_MS) {
+            return false;
+        }
+        k_msleep(KAMEA_BENCHMARK_REFILL_PERIOD_MS);
+    }
+
+    return true;
+}
+
+#if CONFIG_KAMEA_MQTT_INSTANCES > 1
+
+static int
+kamea_benchmark_sessions_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    int                 count    = atoi(argv[1]);
+    int64_t             duration = 1000LL * atoi(argv[2]);
+    int32_t             period   = (argc > 3) ? atoi(argv[3]) : KAMEA_BENCHMARK_TELEMETRY_PERIOD_MS;
+    char                client_id[32];
+    char                payload[96];
+    kamea_mqtt_config_t config = {
+        .client_id              = client_id,
+        .hostname               = CONFIG_KAMEA_CHANNEL_MQTT_URL,
+        .port                   = CONFIG_KAMEA_CHANNEL_MQTT_PORT,
+        .sec_tag                = CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG,
+        .ca_sec_tag             = CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG,
+        .callbacks.connected    = kamea_benchmark_sessions_connected_cb,
+        .callbacks.disconnected = kamea_benchmark_sessions_disconnected_cb,
+    };
+    int64_t  start, connect_time, next;
+    uint32_t published = 0;
+    uint32_t failed    = 0;
+    uint64_t rtt_sum   = 0;
+    size_t   samples   = 0;
+    int      result;
+
+    /* Check arguments */
+    if ((count <= 0) || (count > ARRAY_SIZE(kamea_benchmark_sessions)) || (duration <= 0) || (period <= 0)) {
+        shell_error(sh, "Invalid arguments, at most %u sessions", (uint32_t)ARRAY_SIZE(kamea_benchmark_sessions));
+        return -EINVAL;
+    }
+
+    /* Initialize the sessions not initialized yet, instances cannot be released, credentials are shared with the application */
+    for (; kamea_benchmark_sessions_initialized < count; kamea_benchmark_sessions_initialized++) {
+        snprintf(client_id, sizeof(client_id), "kamea_benchmark_%u", (uint32_t)kamea_benchmark_sessions_initialized);
+        if (0 != (result = kamea_mqtt_init(&kamea_benchmark_sessions[kamea_benchmark_sessions_initialized], &config))) {
+            shell_error(sh, "Unable to initialize session %u, result = %d", (uint32_t)kamea_benchmark_sessions_initialized, result);
+            return result;
+        }
+    }
+
+    /* Connect sessions, all of them are served by the Kamea MQTT thread */
+    shell_print(sh, "Connecting %d sessions (%u bytes each)...", count, (uint32_t)sizeof(kamea_mqtt_t));
+    start = k_uptime_get();
+    for (int index = 0; index < count; index++) {
+        kamea_mqtt_connect(&kamea_benchmark_sessions[index]);
+    }
+    while ((kamea_benchmark_sessions_count() < count) && (k_uptime_get() - start < KAMEA_BENCHMARK_SESSIONS_CONNECT_TIMEOUT_MS)) {
+        k_sleep(K_MSEC(KAMEA_BENCHMARK_REFILL_PERIOD_MS));
+    }
+    connect_time = k_uptime_get() - start;
+    shell_print(sh, "%d/%d sessions connected in %lld ms", kamea_benchmark_sessions_count(), count, connect_time);
+
+    /* Publish telemetry on all sessions at each period */
+    shell_print(sh, "Publishing telemetry on each session every %d ms for %lld s...", period, duration / 1000);
+    start = k_uptime_get();
+    for (next = start; k_uptime_get() - start < duration; next += period) {
+        for (int index = 0; index < count; index++) {
+            snprintf(payload, sizeof(payload), "{ \"benchmark\": { \"session\": %d, \"published\": %u } }", index, published);
+            if (0
+                == kamea_mqtt_publish_telemetry(
+                    &kamea_benchmark_sessions[index], (uint8_t *)payload, strlen(payload), MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_NORMAL)) {
+                published++;
+            } else {
+                failed++;
+            }
+        }
+        k_sleep(K_TIMEOUT_ABS_MS(next + period));
+    }
+
+    /* Collect latencies and round-trip times of all sessions, then disconnect them */
+    for (int index = 0; index < count; index++) {
+        samples += kamea_mqtt_get_latency(
+            &kamea_benchmark_sessions[index], KAMEA_PRIORITY_NORMAL, &kamea_benchmark_samples[samples], ARRAY_SIZE(kamea_benchmark_samples) - samples);
+        rtt_sum += kamea_mqtt_get_puback_rtt(&kamea_benchmark_sessions[index]);
+        kamea_mqtt_disconnect(&kamea_benchmark_sessions[index]);
+    }
+
+    /* Report */
+    shell_print(sh,
+                "Queued %u messages (%u failed): %u messages/s, average PUBACK round-trip time %u us",
+                published,
+                failed,
+                (uint32_t)((1000LL * published) / duration),
+                (uint32_t)(rtt_sum / count));
+    shell_print(sh, "Latest publish latencies of all sessions, from queuing to writing to the socket:");
+    kamea_benchmark_report_samples(sh, "telemetry", "us", samples);
+
+    return 0;
+}
+
+static void
+kamea_benchmark_sessions_connected_cb(kamea_mqtt_t *kamea) {
+
+    atomic_set_bit(kamea_benchmark_sessions_connected, kamea - kamea_benchmark_sessions);
+}
+
+static void
+kamea_benchmark_sessions_disconnected_cb(kamea_mqtt_t *kamea) {
+
+    atomic_clear_bit(kamea_benchmark_sessions_connected, kamea - kamea_benchmark_sessions);
+}
+
+static int
+kamea_benchmark_sessions_count(void) {
+
+    int count = 0;
+
+    /* Count sessions connected */
+    for (int index = 0; index < ARRAY_SIZE(kamea_benchmark_sessions); index++) {
+        count += (true == atomic_test_bit(kamea_benchmark_sessions_connected, index)) ? 1 : 0;
+    }
+
+    return count;
+}
+
+#endif /* CONFIG_KAMEA_MQTT_INSTANCES > 1 */
+
+static int
+kamea_benchmark_upload_next(void *user_data, const uint8_t **chunk) {
+
+    struct kamea_benchmark_upload *upload = user_data;
+    size_t                         len    = MIN(upload->remaining, sizeof(kamea_benchmark_chunk));
+
+    /* Give the same chunk until the payload is complete */
+    *chunk = kamea_benchmark_chunk;
+    upload->remaining -= len;
+
+    return len;
+}
+
+static void
+kamea_benchmark_report(const struct shell *sh, const char *name, kamea_priority_t priority) {
+
+    size_t count = kamea_mqtt_get_latency(&kamea_cloud, priority, kamea_benchmark_samples, ARRAY_SIZE(kamea_benchmark_samples));
+
+    kamea_benchmark_report_samples(sh, name, "us", count);
+}
+
+static void
+kamea_benchmark_report_ack(const struct shell *sh, const char *name, kamea_priority_t priority) {
+
+    size_t count = kamea_mqtt_get_ack_latency(&kamea_cloud, priority, kamea_benchmark_samples, ARRAY_SIZE(kamea_benchmark_samples));
+
+    kamea_benchmark_report_samples(sh, name, "us", count);
+}
+
+static void
+kamea_benchmark_report_dispatch(const struct shell *sh) {
+
+    size_t count = kamea_mqtt_get_dispatch_time(&kamea_cloud, kamea_benchmark_samples, ARRAY_SIZE(kamea_benchmark_samples));
+
+    shell_print(sh,
+                "Received %u messages (%u bytes) on benchmark topics, latest dispatch times, from PUBLISH event to acknowledgement:",
+                (uint32_t)atomic_get(&kamea_benchmark_received),
+                (uint32_t)atomic_get(&kamea_benchmark_received_bytes));
+    kamea_benchmark_report_samples(sh, "dispatch", "ns", count);
+}
+
+static void
+kamea_benchmark_report_samples(const struct shell *sh, const char *name, const char *unit, size_t count) {
+
+    /* Check if samples are available */
+    if (0 == count) {
+        shell_print(sh, "  %s: no sample", name);
+        return;
+    }
+
+    /* Compute percentiles */
+    qsort(kamea_benchmark_samples, count, sizeof(uint32_t), kamea_benchmark_samples_compare);
+    shell_print(sh,
+                "  %s (%s, %u samples): p50 %u, p90 %u, p99 %u, max %u",
+                name,
+                unit,
+                (uint32_t)count,
+                kamea_benchmark_samples[((count - 1) * 50) / 100],
+                kamea_benchmark_samples[((count - 1) * 90) / 100],
+                kamea_benchmark_samples[((count - 1) * 99) / 100],
+                kamea_benchmark_samples[count - 1]);
+}
+
+static void
+kamea_benchmark_handler(const kamea_mqtt_slice_t *slice, void *user_data) {
+
+    ARG_UNUSED(user_data);
+
+    /* Count messages on their first slice */
+    if (0 == slice->offset) {
+        atomic_inc(&kamea_benchmark_received);
+    }
+    atomic_add(&kamea_benchmark_received_bytes, slice->len);
+}
+
+static int
+kamea_benchmark_init(void) {
+
+    return kamea_mqtt_subscribe(&kamea_cloud, "benchmark/#", MQTT_QOS_1_AT_LEAST_ONCE, kamea_benchmark_handler, NULL);
+}
+
+static int
+kamea_benchmark_samples_compare(const void *a, const void *b) {
+
+    uint32_t value_a = *(const uint32_t *)a;
+    uint32_t value_b = *(const uint32_t *)b;
+
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * @brief Shell command definition
+ */
+SHELL_CMD_ARG_REGISTER(kamea_benchmark,
+                       NULL,
+                       "Saturate the uplink, report publish latencies and dispatch times: kamea_benchmark <duration_s> [alert_period_ms] [telemetry_period_ms]",
+                       kamea_benchmark_cmd,
+                       2,
+                       2);
+
+/**
+ * @brief Streamed upload shell command definition
+ */
+SHELL_CMD_ARG_REGISTER(kamea_benchmark_upload,
+                       NULL,
+                       "Stream payloads larger than the MQTT Tx buffer and report the throughput: kamea_benchmark_upload <size_bytes> [count]",
+                       kamea_benchmark_upload_cmd,
+                       2,
+                       1);
+
+/**
+ * @brief Reconnect benchmark shell command definition
+ */
+SHELL_CMD_ARG_REGISTER(kamea_benchmark_reconnect,
+                       NULL,
+                       "Reconnect and report the time to the first message received and acknowledged: kamea_benchmark_reconnect <count> [offline_ms]",
+                       kamea_benchmark_reconnect_cmd,
+                       2,
+                       1);
+
+/**
+ * @brief TLS handshake benchmark shell command definition
+ */
+SHELL_CMD_ARG_REGISTER(kamea_benchmark_handshake,
+                       NULL,
+                       "Reconnect and report the TLS handshake duration and peak mbedTLS heap: kamea_benchmark_handshake <count>",
+                       kamea_benchmark_handshake_cmd,
+                       2,
+                       0);
+
+#if CONFIG_KAMEA_MQTT_INSTANCES > 1
+
+/**
+ * @brief Sessions scaling benchmark shell command definition
+ */
+SHELL_CMD_ARG_REGISTER(kamea_benchmark_sessions,
+                       NULL,
+                       "Publish telemetry on several sessions served by the Kamea MQTT thread: kamea_benchmark_sessions <count> <duration_s> [period_ms]",
+                       kamea_benchmark_sessions_cmd,
+                       3,
+                       1);
+
+#endif /* CONFIG_KAMEA_MQTT_INSTANCES > 1 */
+
+/**
+ * @brief Benchmark initialization
+ */
+SYS_INIT(kamea_benchmark_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,225 @@
+/**
+ * @file      kamea_governor.c
+ * @brief     Kamea telemetry bandwidth governor
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_kamea_governor, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "app/subsys/kamea.h"
+#include "kamea_governor.h"
+#include "messages.h"
+
+/**
+ * @brief RSSI thresholds (dBm), below which the link is degraded or poor
+ */
+#define KAMEA_GOVERNOR_RSSI_DEGRADED (-70)
+#define KAMEA_GOVERNOR_RSSI_POOR     (-80)
+
+/**
+ * @brief TCP retransmits thresholds (segments per link statistics period), above which the link is degraded or poor
+ */
+#define KAMEA_GOVERNOR_RETRANSMITS_DEGRADED (1)
+#define KAMEA_GOVERNOR_RETRANSMITS_POOR     (5)
+
+/**
+ * @brief PUBACK round-trip time thresholds (microseconds), above which the link is degraded or poor
+ */
+#define KAMEA_GOVERNOR_RTT_DEGRADED (1000000)
+#define KAMEA_GOVERNOR_RTT_POOR     (3000000)
+
+/**
+ * @brief Governor initialization
+ * @return Always returns 0
+ */
+static int kamea_governor_init(void);
+
+/**
+ * @brief Network link statistics callback
+ * @param chan Network link statistics channel
+ */
+static void kamea_governor_network_link_cb(const struct zbus_channel *chan);
+
+/**
+ * @brief Refill budget and update rate, must be called with the mutex locked
+ */
+static void kamea_governor_refill(void);
+
+/**
+ * @brief Zbus channels
+ */
+ZBUS_CHAN_DECLARE(network_link_chan);
+
+/**
+ * @brief Zbus listeners
+ */
+ZBUS_LISTENER_DEFINE(kamea_governor_network_link_listenner, kamea_governor_network_link_cb);
+
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+
+/**
+ * @brief Kamea cloud MQTT client instance
+ */
+KAMEA_MQTT_DECLARE(kamea_cloud);
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+/**
+ * @brief Names of the link qualities
+ */
+static const char *kamea_governor_link_names[KAMEA_GOVERNOR_LINK_COUNT] = {
+    [KAMEA_GOVERNOR_LINK_GOOD]     = "good",
+    [KAMEA_GOVERNOR_LINK_DEGRADED] = "degraded",
+    [KAMEA_GOVERNOR_LINK_POOR]     = "poor",
+};
+
+/**
+ * @brief Mutex used to protect the governor state
+ */
+static K_MUTEX_DEFINE(kamea_governor_mutex);
+
+/**
+ * @brief Available budget (milli-bytes, to avoid rounding errors on refill)
+ */
+static int64_t kamea_governor_budget;
+
+/**
+ * @brief Uptime of the last refill (milliseconds)
+ */
+static int64_t kamea_governor_timestamp;
+
+/**
+ * @brief Link quality computed from the latest link statistics, and current link quality
+ */
+static enum kamea_governor_link kamea_governor_link_stats = KAMEA_GOVERNOR_LINK_GOOD;
+static enum kamea_governor_link kamea_governor_link       = KAMEA_GOVERNOR_LINK_GOOD;
+
+static int
+kamea_governor_init(void) {
+
+    /* Start with a full budget */
+    kamea_governor_budget    = 1000LL * CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_BURST;
+    kamea_governor_timestamp = k_uptime_get();
+
+    /* Register to Zbus channels */
+    zbus_chan_add_obs(&network_link_chan, &kamea_governor_network_link_listenner, K_MSEC(10));
+
+    return 0;
+}
+
+bool
+kamea_governor_acquire(size_t len, bool force) {
+
+    bool result = false;
+
+    k_mutex_lock(&kamea_governor_mutex, K_FOREVER);
+
+    /* Refill budget, then consume it if sufficient */
+    kamea_governor_refill();
+    if ((true == force) || (kamea_governor_budget >= 1000LL * len)) {
+        kamea_governor_budget -= 1000LL * len;
+        result = true;
+    }
+
+    k_mutex_unlock(&kamea_governor_mutex);
+
+    return result;
+}
+
+void
+kamea_governor_get_status(struct kamea_governor_status *status) {
+
+    k_mutex_lock(&kamea_governor_mutex, K_FOREVER);
+
+    /* Refill budget and copy status */
+    kamea_governor_refill();
+    status->budget = (int32_t)(kamea_governor_budget / 1000);
+    status->rate   = CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_RATE >> kamea_governor_link;
+    status->link   = kamea_governor_link;
+
+    k_mutex_unlock(&kamea_governor_mutex);
+}
+
+static void
+kamea_governor_network_link_cb(const struct zbus_channel *chan) {
+
+    const struct network_link_msg *network_link_msg = zbus_chan_const_msg(chan);
+    enum kamea_governor_link       link             = KAMEA_GOVERNOR_LINK_GOOD;
+
+    /* Compute link quality from RSSI */
+    if (true == network_link_msg->rssi_valid) {
+        if (network_link_msg->rssi < KAMEA_GOVERNOR_RSSI_POOR) {
+            link = MAX(link, KAMEA_GOVERNOR_LINK_POOR);
+        } else if (network_link_msg->rssi < KAMEA_GOVERNOR_RSSI_DEGRADED) {
+            link = MAX(link, KAMEA_GOVERNOR_LINK_DEGRADED);
+        }
+    }
+
+    /* Compute link quality from TCP retransmits */
+    if (true == network_link_msg->retransmits_valid) {
+        if (network_link_msg->retransmits > KAMEA_GOVERNOR_RETRANSMITS_POOR) {
+            link = MAX(link, KAMEA_GOVERNOR_LINK_POOR);
+        } else if (network_link_msg->retransmits > KAMEA_GOVERNOR_RETRANSMITS_DEGRADED) {
+            link = MAX(link, KAMEA_GOVERNOR_LINK_DEGRADED);
+        }
+    }
+
+    kamea_governor_link_stats = link;
+}
+
+static void
+kamea_governor_refill(void) {
+
+    int64_t                  now  = k_uptime_get();
+    enum kamea_governor_link link = kamea_governor_link_stats;
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    uint32_t rtt = kamea_mqtt_get_puback_rtt(&kamea_cloud);
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+    /* Refill budget at the current rate, the rate is in bytes per second and the budget in milli-bytes */
+    kamea_governor_budget += (now - kamea_governor_timestamp) * (CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_RATE >> kamea_governor_link);
+    kamea_governor_budget    = MIN(kamea_governor_budget, 1000LL * CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_BURST);
+    kamea_governor_timestamp = now;
+
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    /* Compute link quality from PUBACK round-trip time */
+    if (rtt > KAMEA_GOVERNOR_RTT_POOR) {
+        link = MAX(link, KAMEA_GOVERNOR_LINK_POOR);
+    } else if (rtt > KAMEA_GOVERNOR_RTT_DEGRADED) {
+        link = MAX(link, KAMEA_GOVERNOR_LINK_DEGRADED);
+    }
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+    /* Update rate */
+    if (link != kamea_governor_link) {
+        LOG_INF("Link quality is %s, telemetry rate %u bytes/s",
+                kamea_governor_link_names[link],
+                CONFIG_WIND_TURBINE_KAMEA_GOVERNOR_RATE >> link);
+        kamea_governor_link = link;
+    }
+}
+
+/**
+ * @brief Initialization of the governor
+ */
+SYS_INIT(kamea_governor_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
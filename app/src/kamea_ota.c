@@ -0,0 +1,635 @@
+/**
+ * @file      kamea_ota.c
+ * @brief     Kamea firmware download
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_kamea_ota, LOG_LEVEL_INF);
+
+#include <zephyr/data/json.h>
+#ifdef CONFIG_BOOTLOADER_MCUBOOT
+#include <zephyr/dfu/mcuboot.h>
+#endif /* CONFIG_BOOTLOADER_MCUBOOT */
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif /* CONFIG_SHELL */
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/storage/stream_flash.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <mbedtls/sha256.h>
+
+#include "app/subsys/kamea.h"
+#include "kamea_ota.h"
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+#include "kamea_ota_delta.h"
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+
+/**
+ * @brief Size of the chunk header, little-endian offset of the chunk data in the image (bytes)
+ */
+#define KAMEA_OTA_CHUNK_HEADER_SIZE (4)
+
+/**
+ * @brief Size of the SHA-256 digest (bytes)
+ */
+#define KAMEA_OTA_SHA256_SIZE (32)
+
+/**
+ * @brief Delay before publishing again the download status when the high priority queue is full (milliseconds)
+ */
+#define KAMEA_OTA_REPORT_RETRY_MS (500)
+
+/**
+ * @brief Work queue stack size (Bytes)
+ */
+#define KAMEA_OTA_WORK_QUEUE_STACK_SIZE (2048)
+
+/**
+ * @brief Work queue priority, lower than the Kamea MQTT thread so that flash operations do not delay the other messages
+ */
+#define KAMEA_OTA_WORK_QUEUE_PRIORITY (12)
+
+/**
+ * @brief Download start request received on the 'ota/start' topic
+ */
+struct kamea_ota_start {
+    int32_t size;   /**< Size of the image, or patch, transferred (bytes) */
+    char   *sha256; /**< Image SHA-256, hexadecimal string */
+    bool    delta;  /**< A patch to apply to the running image is transferred instead of the image */
+};
+
+/**
+ * @brief Payload slice copied from the MQTT Rx buffer, handled by the work queue
+ */
+struct kamea_ota_slice {
+    bool    start;                                  /**< The slice belongs to a download start request, to a chunk otherwise */
+    size_t  len;                                    /**< Length of payload slice */
+    size_t  offset;                                 /**< Offset of the slice in the payload */
+    size_t  total_len;                              /**< Total length of payload */
+    uint8_t data[CONFIG_KAMEA_MQTT_RX_BUFFER_SIZE]; /**< Payload slice */
+};
+
+/**
+ * @brief Download context
+ */
+struct kamea_ota_transfer {
+    enum kamea_ota_state    state;                         /**< Download state */
+    size_t                  offset;                        /**< Confirmed offset (bytes) */
+    size_t                  size;                          /**< Size of the image, or patch, transferred (bytes) */
+    int                     error;                         /**< Error code of the latest aborted download */
+    bool                    skip;                          /**< The chunk being received is ignored */
+    size_t                  next;                          /**< Offset of the next slice expected in the chunk being received */
+    uint8_t                 sha256[KAMEA_OTA_SHA256_SIZE]; /**< Expected image SHA-256 */
+    mbedtls_sha256_context  sha256_ctx;                    /**< SHA-256 of the data written, computed on the fly */
+    struct stream_flash_ctx stream;                        /**< Streaming writer to the update slot */
+    bool                    delta;                         /**< A patch is transferred */
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+    struct kamea_ota_delta  patch;                         /**< Patch decoder */
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+};
+
+/**
+ * @brief Firmware download topics handler, copies the slices to the download queue
+ * @param slice Payload slice
+ * @param user_data User data
+ */
+static void kamea_ota_handler(const kamea_mqtt_slice_t *slice, void *user_data);
+
+/**
+ * @brief Work handler used to handle the queued slices, flash operations are performed here
+ * @param handle Work handle
+ */
+static void kamea_ota_work_handler(struct k_work *handle);
+
+/**
+ * @brief Start a new download, or resume the download in progress if the same image is requested
+ * @param slice Download start request payload slice
+ */
+static void kamea_ota_start(const kamea_mqtt_slice_t *slice);
+
+/**
+ * @brief Write a chunk of the image to the update slot
+ * @param slice Chunk payload slice
+ */
+static void kamea_ota_chunk(const kamea_mqtt_slice_t *slice);
+
+/**
+ * @brief Compute SHA-256 and write data to the update slot
+ * @param data Image data
+ * @param len Length of data
+ * @param flush The data are the last ones of the image
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_write(const uint8_t *data, size_t len, bool flush);
+
+/**
+ * @brief Verify the image SHA-256 once all the chunks are written, then request the upgrade
+ */
+static void kamea_ota_finish(void);
+
+/**
+ * @brief Abort the download
+ * @param error Error code
+ */
+static void kamea_ota_abort(int error);
+
+/**
+ * @brief Report the download status as telemetry
+ */
+static void kamea_ota_report(void);
+
+/**
+ * @brief Work handler used to publish again the download status
+ * @param handle Work handle
+ */
+static void kamea_ota_report_work_handler(struct k_work *handle);
+
+/**
+ * @brief Check if the topic of a payload slice is the given one
+ * @param slice Payload slice
+ * @param topic Topic, relative to the device topic
+ * @return true if the topic matches, false otherwise
+ */
+static bool kamea_ota_topic_is(const kamea_mqtt_slice_t *slice, const char *topic);
+
+#ifdef CONFIG_SHELL
+
+/**
+ * @brief Shell command used to display the download status
+ * @param sh Shell instance
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_cmd(const struct shell *sh, size_t argc, char **argv);
+
+#endif /* CONFIG_SHELL */
+
+/**
+ * @brief Kamea cloud MQTT client instance
+ */
+KAMEA_MQTT_DECLARE(kamea_cloud);
+
+/**
+ * @brief Download start request description
+ */
+static const struct json_obj_descr kamea_ota_start_descr[] = {
+    JSON_OBJ_DESCR_PRIM(struct kamea_ota_start, size, JSON_TOK_NUMBER),
+    JSON_OBJ_DESCR_PRIM(struct kamea_ota_start, sha256, JSON_TOK_STRING),
+    JSON_OBJ_DESCR_PRIM(struct kamea_ota_start, delta, JSON_TOK_TRUE),
+};
+
+/**
+ * @brief Names of the download states
+ */
+static const char *kamea_ota_state_names[KAMEA_OTA_STATE_COUNT] = {
+    [KAMEA_OTA_STATE_IDLE]        = "idle",
+    [KAMEA_OTA_STATE_DOWNLOADING] = "downloading",
+    [KAMEA_OTA_STATE_READY]       = "ready",
+    [KAMEA_OTA_STATE_ERROR]       = "error",
+};
+
+/**
+ * @brief Download context, only modified from the download work queue
+ */
+static struct kamea_ota_transfer kamea_ota;
+
+/**
+ * @brief Download queue, the slices are copied there by the Kamea MQTT thread and handled by the work queue
+ */
+K_MSGQ_DEFINE(kamea_ota_msgq, sizeof(struct kamea_ota_slice), CONFIG_WIND_TURBINE_KAMEA_OTA_QUEUE_SIZE, 4);
+
+/**
+ * @brief Download work queue stack
+ */
+K_THREAD_STACK_DEFINE(kamea_ota_work_queue_stack, KAMEA_OTA_WORK_QUEUE_STACK_SIZE);
+
+/**
+ * @brief Download work queue, flash erase and write, and the SHA-256 computations are performed there instead of the Kamea MQTT thread
+ */
+static struct k_work_q kamea_ota_work_queue_handle;
+
+/**
+ * @brief Work used to handle the queued slices
+ */
+static struct k_work kamea_ota_work_handle;
+
+/**
+ * @brief Work used to publish again the download status, the server waits for the offset to send the next chunk
+ */
+static struct k_work_delayable kamea_ota_report_work_handle;
+
+/**
+ * @brief Streaming writer buffer, written to the flash when full so that pages are programmed at once
+ */
+static uint8_t kamea_ota_buffer[CONFIG_WIND_TURBINE_KAMEA_OTA_BUFFER_SIZE] __aligned(4);
+
+int
+kamea_ota_init(void) {
+
+    int result;
+
+    /* Chunks are received in slices, the whole image and chunks are never buffered */
+    mbedtls_sha256_init(&kamea_ota.sha256_ctx);
+    k_work_queue_init(&kamea_ota_work_queue_handle);
+    k_work_queue_start(&kamea_ota_work_queue_handle, kamea_ota_work_queue_stack, KAMEA_OTA_WORK_QUEUE_STACK_SIZE, KAMEA_OTA_WORK_QUEUE_PRIORITY, NULL);
+    k_thread_name_set(k_work_queue_thread_get(&kamea_ota_work_queue_handle), "kamea_ota_work_queue");
+    k_work_init(&kamea_ota_work_handle, kamea_ota_work_handler);
+    k_work_init_delayable(&kamea_ota_report_work_handle, kamea_ota_report_work_handler);
+    if (0 != (result = kamea_mqtt_subscribe(&kamea_cloud, "ota/+", MQTT_QOS_1_AT_LEAST_ONCE, kamea_ota_handler, NULL))) {
+        LOG_ERR("Unable to subscribe to firmware download topics, result = %d", result);
+        return result;
+    }
+
+    return 0;
+}
+
+void
+kamea_ota_connected(void) {
+
+    /* Request the chunks from the confirmed offset, the download is resumed after a disconnection */
+    if (KAMEA_OTA_STATE_IDLE != kamea_ota.state) {
+        k_work_reschedule_for_queue(&kamea_ota_work_queue_handle, &kamea_ota_report_work_handle, K_NO_WAIT);
+    }
+}
+
+void
+kamea_ota_get_status(struct kamea_ota_status *status) {
+
+    status->state  = kamea_ota.state;
+    status->offset = kamea_ota.offset;
+    status->size   = kamea_ota.size;
+    status->error  = kamea_ota.error;
+}
+
+static void
+kamea_ota_handler(const kamea_mqtt_slice_t *slice, void *user_data) {
+
+    ARG_UNUSED(user_data);
+    static struct kamea_ota_slice copy; /* Only used from the Kamea MQTT thread */
+
+    /* Copy the slice, the Kamea MQTT thread is not blocked by the flash operations */
+    if (true == kamea_ota_topic_is(slice, "ota/start")) {
+        copy.start = true;
+    } else if (true == kamea_ota_topic_is(slice, "ota/chunk")) {
+        copy.start = false;
+    } else {
+        return;
+    }
+    copy.len       = MIN(slice->len, sizeof(copy.data));
+    copy.offset    = slice->offset;
+    copy.total_len = slice->total_len;
+    memcpy(copy.data, slice->data, copy.len);
+
+    /* A slice dropped when the queue is full interrupts the chunk, it is sent again from the confirmed offset */
+    if (0 != k_msgq_put(&kamea_ota_msgq, &copy, K_NO_WAIT)) {
+        LOG_WRN("Firmware download queue is full, dropping slice");
+        k_work_reschedule_for_queue(&kamea_ota_work_queue_handle, &kamea_ota_report_work_handle, K_MSEC(KAMEA_OTA_REPORT_RETRY_MS));
+        return;
+    }
+    k_work_submit_to_queue(&kamea_ota_work_queue_handle, &kamea_ota_work_handle);
+}
+
+static void
+kamea_ota_work_handler(struct k_work *handle) {
+
+    ARG_UNUSED(handle);
+    static struct kamea_ota_slice copy; /* Only used from the download work queue */
+    kamea_mqtt_slice_t            slice;
+
+    /* Handle all the queued slices */
+    while (0 == k_msgq_get(&kamea_ota_msgq, &copy, K_NO_WAIT)) {
+        slice.data      = copy.data;
+        slice.len       = copy.len;
+        slice.offset    = copy.offset;
+        slice.total_len = copy.total_len;
+        if (true == copy.start) {
+            kamea_ota_start(&slice);
+        } else {
+            kamea_ota_chunk(&slice);
+        }
+    }
+}
+
+static void
+kamea_ota_start(const kamea_mqtt_slice_t *slice) {
+
+    struct kamea_ota_start   request = { 0 };
+    uint8_t                  sha256[KAMEA_OTA_SHA256_SIZE];
+    const struct flash_area *fa;
+    struct flash_pages_info  info;
+    int                      fields, result;
+
+    /* Request is parsed in place, it must be received in a single slice */
+    if (slice->len != slice->total_len) {
+        if (0 == slice->offset) {
+            LOG_ERR("Unable to parse download request, payload is too large (%u bytes)", (uint32_t)slice->total_len);
+        }
+        return;
+    }
+    if ((fields = json_obj_parse((char *)slice->data, slice->len, kamea_ota_start_descr, ARRAY_SIZE(kamea_ota_start_descr), &request)) < 0) {
+        LOG_ERR("Unable to parse download request, result = %d", fields);
+        return;
+    }
+    if (((BIT(0) | BIT(1)) != (fields & (BIT(0) | BIT(1)))) || (request.size <= 0) || (2 * KAMEA_OTA_SHA256_SIZE != strlen(request.sha256))
+        || (KAMEA_OTA_SHA256_SIZE != hex2bin(request.sha256, strlen(request.sha256), sha256, sizeof(sha256)))) {
+        LOG_ERR("Invalid download request");
+        return;
+    }
+
+    /* Resume the download in progress, or report the image is ready, if the same image is requested again */
+    if (((KAMEA_OTA_STATE_DOWNLOADING == kamea_ota.state) || (KAMEA_OTA_STATE_READY == kamea_ota.state)) && (request.size == kamea_ota.size)
+        && (request.delta == kamea_ota.delta) && (0 == memcmp(sha256, kamea_ota.sha256, sizeof(sha256)))) {
+        LOG_INF("Resuming firmware download at offset %u/%u", (uint32_t)kamea_ota.offset, (uint32_t)kamea_ota.size);
+        kamea_ota_report();
+        return;
+    }
+
+    /* Start a new download */
+    kamea_ota.state  = KAMEA_OTA_STATE_DOWNLOADING;
+    kamea_ota.offset = 0;
+    kamea_ota.size   = request.size;
+    kamea_ota.skip   = true;
+    kamea_ota.delta  = request.delta;
+    memcpy(kamea_ota.sha256, sha256, sizeof(sha256));
+#ifndef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+    if (true == kamea_ota.delta) {
+        LOG_ERR("Delta updates are not supported");
+        kamea_ota_abort(-ENOTSUP);
+        return;
+    }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+    if (0 != (result = flash_area_open(FIXED_PARTITION_ID(slot1_partition), &fa))) {
+        LOG_ERR("Unable to open update slot, result = %d", result);
+        kamea_ota_abort(result);
+        return;
+    }
+
+    /* The last page of the slot holds the MCUboot trailer, it is erased now as the image may not reach it */
+    if (0 != (result = flash_get_page_info_by_offs(flash_area_get_device(fa), fa->fa_off + fa->fa_size - 1, &info))) {
+        LOG_ERR("Unable to retrieve update slot page layout, result = %d", result);
+        goto END;
+    }
+    if ((false == kamea_ota.delta) && (kamea_ota.size > info.start_offset - fa->fa_off)) {
+        LOG_ERR("Image is too large (%u bytes), update slot is %u bytes", (uint32_t)kamea_ota.size, (uint32_t)(info.start_offset - fa->fa_off));
+        result = -EFBIG;
+        goto END;
+    }
+    if (0 != (result = flash_area_erase(fa, info.start_offset - fa->fa_off, info.size))) {
+        LOG_ERR("Unable to erase update slot trailer, result = %d", result);
+        goto END;
+    }
+
+    /* Other pages are erased by the streaming writer when they are reached */
+    if (0 != (result = stream_flash_init(
+                  &kamea_ota.stream, flash_area_get_device(fa), kamea_ota_buffer, sizeof(kamea_ota_buffer), fa->fa_off, fa->fa_size, NULL))) {
+        LOG_ERR("Unable to initialize streaming writer, result = %d", result);
+        goto END;
+    }
+    if (0 != (result = mbedtls_sha256_starts(&kamea_ota.sha256_ctx, 0))) {
+        LOG_ERR("Unable to start SHA-256 computation, result = %d", result);
+        goto END;
+    }
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+    /* The patch is applied as it is received, the target image size is checked against the slot once the patch header is received */
+    if (true == kamea_ota.delta) {
+        kamea_ota_delta_init(&kamea_ota.patch, info.start_offset - fa->fa_off, kamea_ota.sha256, kamea_ota_write);
+    }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+    LOG_INF("Starting firmware download, %u bytes%s", (uint32_t)kamea_ota.size, (true == kamea_ota.delta) ? " patch" : "");
+
+END:
+
+    flash_area_close(fa);
+
+    /* Report status, the server sends the chunks from the confirmed offset */
+    if (0 != result) {
+        kamea_ota_abort(result);
+    } else {
+        kamea_ota_report();
+    }
+}
+
+static void
+kamea_ota_chunk(const kamea_mqtt_slice_t *slice) {
+
+    const uint8_t *data = slice->data;
+    size_t         len  = slice->len;
+    uint32_t       offset;
+    int            result;
+
+    /* Slices of the chunk being received may have been dropped, the chunk is sent again from the confirmed offset */
+    if ((0 != slice->offset) && (slice->offset != kamea_ota.next) && (false == kamea_ota.skip)) {
+        LOG_WRN("Firmware chunk interrupted at offset %u", (uint32_t)kamea_ota.offset);
+        kamea_ota.skip = true;
+        kamea_ota_report();
+    }
+    kamea_ota.next = slice->offset + slice->len;
+
+    /* First slice holds the chunk header, chunks not starting at the confirmed offset are ignored, duplicates included */
+    if (0 == slice->offset) {
+        kamea_ota.skip = true;
+        if (KAMEA_OTA_STATE_DOWNLOADING != kamea_ota.state) {
+            return;
+        }
+        if (len < KAMEA_OTA_CHUNK_HEADER_SIZE) {
+            LOG_ERR("Invalid firmware chunk");
+            return;
+        }
+        offset = sys_get_le32(data);
+        data += KAMEA_OTA_CHUNK_HEADER_SIZE;
+        len -= KAMEA_OTA_CHUNK_HEADER_SIZE;
+        if (offset != kamea_ota.offset) {
+            LOG_WRN("Ignoring firmware chunk at offset %u, expecting offset %u", offset, (uint32_t)kamea_ota.offset);
+            kamea_ota_report();
+            return;
+        }
+        kamea_ota.skip = false;
+    }
+    if (true == kamea_ota.skip) {
+        return;
+    }
+
+    /* Write slice, or apply patch slice, the buffer is flushed with the last bytes of the image */
+    if (len > kamea_ota.size - kamea_ota.offset) {
+        LOG_ERR("Firmware chunk exceeds image size");
+        kamea_ota_abort(-EFBIG);
+        return;
+    }
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+    if (true == kamea_ota.delta) {
+        result = kamea_ota_delta_apply(&kamea_ota.patch, data, len);
+    } else {
+        result = kamea_ota_write(data, len, kamea_ota.offset + len == kamea_ota.size);
+    }
+#else
+    result = kamea_ota_write(data, len, kamea_ota.offset + len == kamea_ota.size);
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+    if (0 != result) {
+        kamea_ota_abort(result);
+        return;
+    }
+    kamea_ota.offset += len;
+
+    /* Confirm the offset at the end of the chunk, a chunk interrupted by a disconnection is resumed from the last slice written */
+    if (kamea_ota.offset == kamea_ota.size) {
+#ifdef CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA
+        if ((true == kamea_ota.delta) && (false == kamea_ota_delta_done(&kamea_ota.patch))) {
+            LOG_ERR("Truncated patch");
+            kamea_ota_abort(-EBADMSG);
+            return;
+        }
+#endif /* CONFIG_WIND_TURBINE_KAMEA_OTA_DELTA */
+        kamea_ota_finish();
+    } else if (slice->offset + slice->len == slice->total_len) {
+        kamea_ota_report();
+    }
+}
+
+static int
+kamea_ota_write(const uint8_t *data, size_t len, bool flush) {
+
+    int result;
+
+    /* The SHA-256 is computed on the data written to the update slot, the reconstructed image for patches */
+    if (0 != (result = mbedtls_sha256_update(&kamea_ota.sha256_ctx, data, len))) {
+        LOG_ERR("Unable to compute SHA-256, result = %d", result);
+        return result;
+    }
+    if (0 != (result = stream_flash_buffered_write(&kamea_ota.stream, data, len, flush))) {
+        LOG_ERR("Unable to write update slot, result = %d", result);
+        return result;
+    }
+
+    return 0;
+}
+
+static void
+kamea_ota_finish(void) {
+
+    uint8_t sha256[KAMEA_OTA_SHA256_SIZE];
+    int     result;
+
+    /* Verify SHA-256 */
+    if (0 != (result = mbedtls_sha256_finish(&kamea_ota.sha256_ctx, sha256))) {
+        LOG_ERR("Unable to compute SHA-256, result = %d", result);
+        kamea_ota_abort(result);
+        return;
+    }
+    if (0 != memcmp(sha256, kamea_ota.sha256, sizeof(sha256))) {
+        LOG_ERR("Firmware image SHA-256 mismatch");
+        kamea_ota_abort(-EBADMSG);
+        return;
+    }
+
+#ifdef CONFIG_BOOTLOADER_MCUBOOT
+    /* Request a test upgrade, MCUboot validates the image signature at next reboot and reverts it if it is not confirmed */
+    if (0 != (result = boot_request_upgrade(BOOT_UPGRADE_TEST))) {
+        LOG_ERR("Unable to request upgrade, result = %d", result);
+        kamea_ota_abort(result);
+        return;
+    }
+#endif /* CONFIG_BOOTLOADER_MCUBOOT */
+
+    LOG_INF("Firmware image downloaded and verified, %u bytes transferred, installed at next reboot", (uint32_t)kamea_ota.size);
+    kamea_ota.state = KAMEA_OTA_STATE_READY;
+    kamea_ota_report();
+}
+
+static void
+kamea_ota_abort(int error) {
+
+    kamea_ota.state = KAMEA_OTA_STATE_ERROR;
+    kamea_ota.error = error;
+    kamea_ota.skip  = true;
+    kamea_ota_report();
+}
+
+static void
+kamea_ota_report(void) {
+
+    char payload[128];
+    int  len, result;
+
+    /* Status is published as high priority telemetry, the offset acknowledges the chunks received and must not wait behind telemetry */
+    len = snprintf(payload,
+                   sizeof(payload),
+                   "{ \"ota\": { \"state\": \"%s\", \"offset\": %u, \"size\": %u, \"error\": %d } }",
+                   kamea_ota_state_names[kamea_ota.state],
+                   (uint32_t)kamea_ota.offset,
+                   (uint32_t)kamea_ota.size,
+                   kamea_ota.error);
+    result = kamea_mqtt_publish_telemetry(&kamea_cloud, (uint8_t *)payload, len, MQTT_QOS_1_AT_LEAST_ONCE, KAMEA_PRIORITY_HIGH);
+
+    /* The download stalls if the status is lost, it is published again later if the queue is full */
+    if (-ENOBUFS == result) {
+        LOG_WRN("Unable to publish firmware download status, queue is full, trying again");
+        k_work_reschedule_for_queue(&kamea_ota_work_queue_handle, &kamea_ota_report_work_handle, K_MSEC(KAMEA_OTA_REPORT_RETRY_MS));
+    } else if (0 != result) {
+        LOG_ERR("Unable to publish firmware download status, result = %d", result);
+    }
+}
+
+static void
+kamea_ota_report_work_handler(struct k_work *handle) {
+
+    ARG_UNUSED(handle);
+
+    kamea_ota_report();
+}
+
+static bool
+kamea_ota_topic_is(const kamea_mqtt_slice_t *slice, const char *topic) {
+
+    return (strlen(topic) == slice->topic_len) && (0 == memcmp(slice->topic, topic, slice->topic_len));
+}
+
+#ifdef CONFIG_SHELL
+
+static int
+kamea_ota_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+    struct kamea_ota_status status;
+
+    kamea_ota_get_status(&status);
+    shell_print(sh,
+                "Firmware download %s: %u/%u bytes, error %d",
+                kamea_ota_state_names[status.state],
+                (uint32_t)status.offset,
+                (uint32_t)status.size,
+                status.error);
+
+    return 0;
+}
+
+/**
+ * @brief Shell command definition
+ */
+SHELL_CMD_REGISTER(kamea_ota, NULL, "Display firmware download status", kamea_ota_cmd);
+
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,390 @@
+/**
+ * @file      kamea_ota_delta.c
+ * @brief     Kamea firmware delta patches
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_kamea_ota_delta, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <mbedtls/sha256.h>
+
+#include "kamea_ota_delta.h"
+
+/**
+ * @brief Patch magic and commands
+ * @note The format is described in 'ota/make_delta.py'
+ */
+#define KAMEA_OTA_DELTA_MAGIC  "WTDP"
+#define KAMEA_OTA_DELTA_ADD    (0x00)
+#define KAMEA_OTA_DELTA_INSERT (0x01)
+
+/**
+ * @brief Size of the SHA-256 digest (bytes)
+ */
+#define KAMEA_OTA_DELTA_SHA256_SIZE (32)
+
+/**
+ * @brief Parse the header and verify the source image
+ * @param delta Patch decoder context
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_header(struct kamea_ota_delta *delta);
+
+/**
+ * @brief Receive a byte of a varint, then process the field once it is complete
+ * @param delta Patch decoder context
+ * @param byte Varint byte
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_varint(struct kamea_ota_delta *delta, uint8_t byte);
+
+/**
+ * @brief Copy bytes from the source image to the target image
+ * @param delta Patch decoder context
+ * @param len Number of bytes to copy
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_copy(struct kamea_ota_delta *delta, size_t len);
+
+/**
+ * @brief Add diff bytes to the source image bytes and write them to the target image
+ * @param delta Patch decoder context
+ * @param diff Diff bytes
+ * @param len Number of diff bytes, lower or equal to the buffer size
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_add(struct kamea_ota_delta *delta, const uint8_t *diff, size_t len);
+
+/**
+ * @brief Write reconstructed data to the target image
+ * @param delta Patch decoder context
+ * @param data Reconstructed data
+ * @param len Length of data
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_write(struct kamea_ota_delta *delta, const uint8_t *data, size_t len);
+
+/**
+ * @brief Terminate the current ADD packet, or command, once all its bytes are reconstructed
+ * @param delta Patch decoder context
+ */
+static void kamea_ota_delta_next(struct kamea_ota_delta *delta);
+
+/**
+ * @brief Read source image
+ * @param offset Offset in the source image
+ * @param buf Buffer
+ * @param len Number of bytes to read
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_ota_delta_read(size_t offset, void *buf, size_t len);
+
+void
+kamea_ota_delta_init(struct kamea_ota_delta *delta, size_t max_size, const uint8_t *sha256, kamea_ota_delta_write_t write) {
+
+    memset(delta, 0, sizeof(struct kamea_ota_delta));
+    delta->state    = KAMEA_OTA_DELTA_STATE_HEADER;
+    delta->max_size = max_size;
+    delta->sha256   = sha256;
+    delta->write    = write;
+}
+
+int
+kamea_ota_delta_apply(struct kamea_ota_delta *delta, const uint8_t *data, size_t len) {
+
+    size_t n;
+    int    res;
+
+    while (len > 0) {
+        switch (delta->state) {
+            case KAMEA_OTA_DELTA_STATE_HEADER:
+                /* Header is buffered, the source image is verified once it is received */
+                n = MIN(len, sizeof(delta->header) - delta->header_len);
+                memcpy(&delta->header[delta->header_len], data, n);
+                delta->header_len += n;
+                if ((sizeof(delta->header) == delta->header_len) && (0 != (res = kamea_ota_delta_header(delta)))) {
+                    return res;
+                }
+                break;
+            case KAMEA_OTA_DELTA_STATE_COMMAND:
+                delta->command = data[0];
+                if (KAMEA_OTA_DELTA_ADD == delta->command) {
+                    delta->state = KAMEA_OTA_DELTA_STATE_OFFSET;
+                } else if (KAMEA_OTA_DELTA_INSERT == delta->command) {
+                    delta->state = KAMEA_OTA_DELTA_STATE_LENGTH;
+                } else {
+                    LOG_ERR("Invalid patch command 0x%02x", delta->command);
+                    return -EINVAL;
+                }
+                n = 1;
+                break;
+            case KAMEA_OTA_DELTA_STATE_OFFSET:
+            case KAMEA_OTA_DELTA_STATE_LENGTH:
+            case KAMEA_OTA_DELTA_STATE_ZEROS:
+            case KAMEA_OTA_DELTA_STATE_COUNT:
+                if (0 != (res = kamea_ota_delta_varint(delta, data[0]))) {
+                    return res;
+                }
+                n = 1;
+                break;
+            case KAMEA_OTA_DELTA_STATE_DIFF:
+                /* Diff bytes are added to the source by blocks of the buffer size */
+                n = MIN(MIN(len, delta->count), sizeof(delta->buffer));
+                if (0 != (res = kamea_ota_delta_add(delta, data, n))) {
+                    return res;
+                }
+                delta->count -= n;
+                if (0 == delta->count) {
+                    kamea_ota_delta_next(delta);
+                }
+                break;
+            case KAMEA_OTA_DELTA_STATE_INSERT:
+                /* Inserted bytes are written as they are received */
+                n = MIN(len, delta->remaining);
+                if (0 != (res = kamea_ota_delta_write(delta, data, n))) {
+                    return res;
+                }
+                delta->remaining -= n;
+                if (0 == delta->remaining) {
+                    kamea_ota_delta_next(delta);
+                }
+                break;
+            default:
+                LOG_ERR("Unexpected data after the end of the patch");
+                return -EINVAL;
+        }
+        data += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+bool
+kamea_ota_delta_done(const struct kamea_ota_delta *delta) {
+
+    return (KAMEA_OTA_DELTA_STATE_DONE == delta->state);
+}
+
+static int
+kamea_ota_delta_header(struct kamea_ota_delta *delta) {
+
+    mbedtls_sha256_context ctx;
+    uint8_t                sha256[KAMEA_OTA_DELTA_SHA256_SIZE];
+    size_t                 offset, len;
+    int                    res;
+
+    /* Check header */
+    if (0 != memcmp(delta->header, KAMEA_OTA_DELTA_MAGIC, strlen(KAMEA_OTA_DELTA_MAGIC))) {
+        LOG_ERR("Invalid patch");
+        return -EINVAL;
+    }
+    delta->source_size = sys_get_le32(&delta->header[4]);
+    delta->target_size = sys_get_le32(&delta->header[40]);
+    if (delta->target_size > delta->max_size) {
+        LOG_ERR("Target image is too large (%u bytes)", delta->target_size);
+        return -EFBIG;
+    }
+    if (0 != memcmp(&delta->header[44], delta->sha256, KAMEA_OTA_DELTA_SHA256_SIZE)) {
+        LOG_ERR("Patch target image does not match the download request");
+        return -EINVAL;
+    }
+
+    /* Verify the patch applies to the running image */
+    mbedtls_sha256_init(&ctx);
+    if (0 != (res = mbedtls_sha256_starts(&ctx, 0))) {
+        goto END;
+    }
+    for (offset = 0; offset < delta->source_size; offset += len) {
+        len = MIN(delta->source_size - offset, sizeof(delta->buffer));
+        if ((0 != (res = kamea_ota_delta_read(offset, delta->buffer, len))) || (0 != (res = mbedtls_sha256_update(&ctx, delta->buffer, len)))) {
+            goto END;
+        }
+    }
+    if (0 != (res = mbedtls_sha256_finish(&ctx, sha256))) {
+        goto END;
+    }
+    if (0 != memcmp(&delta->header[8], sha256, sizeof(sha256))) {
+        LOG_ERR("Patch does not apply to the running image");
+        res = -ENOENT;
+        goto END;
+    }
+    LOG_INF("Applying patch to the running image, %u bytes to %u bytes", delta->source_size, delta->target_size);
+    delta->state = (0 == delta->target_size) ? KAMEA_OTA_DELTA_STATE_DONE : KAMEA_OTA_DELTA_STATE_COMMAND;
+
+END:
+
+    mbedtls_sha256_free(&ctx);
+
+    return res;
+}
+
+static int
+kamea_ota_delta_varint(struct kamea_ota_delta *delta, uint8_t byte) {
+
+    uint32_t value;
+    bool     invalid;
+
+    /* Accumulate varint, the fifth byte only holds the 4 most significant bits of a 32 bits value */
+    if ((delta->shift > 28) || ((28 == delta->shift) && (0 != (byte & 0x70)))) {
+        LOG_ERR("Invalid patch varint");
+        return -EINVAL;
+    }
+    delta->varint |= (uint32_t)(byte & 0x7f) << delta->shift;
+    delta->shift += 7;
+    if (0 != (byte & 0x80)) {
+        return 0;
+    }
+    value         = delta->varint;
+    delta->varint = 0;
+    delta->shift  = 0;
+
+    /* Process field */
+    switch (delta->state) {
+        case KAMEA_OTA_DELTA_STATE_OFFSET:
+            delta->source_offset = value;
+            delta->state         = KAMEA_OTA_DELTA_STATE_LENGTH;
+            break;
+        case KAMEA_OTA_DELTA_STATE_LENGTH:
+            /* The length must fit in the target image, and in the source image for an ADD command */
+            invalid = (value > delta->target_size - delta->written);
+            if (KAMEA_OTA_DELTA_ADD == delta->command) {
+                invalid |= (delta->source_offset > delta->source_size) || (value > delta->source_size - delta->source_offset);
+            }
+            if (true == invalid) {
+                LOG_ERR("Invalid patch command length");
+                return -EINVAL;
+            }
+            delta->remaining = value;
+            delta->state     = (KAMEA_OTA_DELTA_ADD == delta->command) ? KAMEA_OTA_DELTA_STATE_ZEROS : KAMEA_OTA_DELTA_STATE_INSERT;
+            if (0 == delta->remaining) {
+                kamea_ota_delta_next(delta);
+            }
+            break;
+        case KAMEA_OTA_DELTA_STATE_ZEROS:
+            if (value > delta->remaining) {
+                LOG_ERR("Invalid patch packet length");
+                return -EINVAL;
+            }
+            delta->remaining -= value;
+            delta->state = KAMEA_OTA_DELTA_STATE_COUNT;
+            return kamea_ota_delta_copy(delta, value);
+        case KAMEA_OTA_DELTA_STATE_COUNT:
+            if (value > delta->remaining) {
+                LOG_ERR("Invalid patch packet length");
+                return -EINVAL;
+            }
+            delta->remaining -= value;
+            delta->count = value;
+            delta->state = KAMEA_OTA_DELTA_STATE_DIFF;
+            if (0 == delta->count) {
+                kamea_ota_delta_next(delta);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static int
+kamea_ota_delta_copy(struct kamea_ota_delta *delta, size_t len) {
+
+    size_t n;
+    int    res;
+
+    /* Copy source by blocks of the buffer size */
+    for (; len > 0; len -= n) {
+        n = MIN(len, sizeof(delta->buffer));
+        if (0 != (res = kamea_ota_delta_read(delta->source_offset, delta->buffer, n))) {
+            LOG_ERR("Unable to read source image, error %d", res);
+            return res;
+        }
+        delta->source_offset += n;
+        if (0 != (res = kamea_ota_delta_write(delta, delta->buffer, n))) {
+            return res;
+        }
+    }
+
+    return 0;
+}
+
+static int
+kamea_ota_delta_add(struct kamea_ota_delta *delta, const uint8_t *diff, size_t len) {
+
+    int res;
+
+    /* Add diff bytes to the source bytes, modulo 256 */
+    if (0 != (res = kamea_ota_delta_read(delta->source_offset, delta->buffer, len))) {
+        LOG_ERR("Unable to read source image, error %d", res);
+        return res;
+    }
+    delta->source_offset += len;
+    for (size_t index = 0; index < len; index++) {
+        delta->buffer[index] += diff[index];
+    }
+
+    return kamea_ota_delta_write(delta, delta->buffer, len);
+}
+
+static int
+kamea_ota_delta_write(struct kamea_ota_delta *delta, const uint8_t *data, size_t len) {
+
+    /* Command lengths are checked against the target size, the last bytes flush the writer */
+    delta->written += len;
+
+    return delta->write(data, len, delta->written == delta->target_size);
+}
+
+static void
+kamea_ota_delta_next(struct kamea_ota_delta *delta) {
+
+    /* Next ADD packet */
+    if ((KAMEA_OTA_DELTA_ADD == delta->command) && (0 != delta->remaining)) {
+        delta->state = KAMEA_OTA_DELTA_STATE_ZEROS;
+        return;
+    }
+
+    /* Next command */
+    delta->state = (delta->written == delta->target_size) ? KAMEA_OTA_DELTA_STATE_DONE : KAMEA_OTA_DELTA_STATE_COMMAND;
+}
+
+static int
+kamea_ota_delta_read(size_t offset, void *buf, size_t len) {
+
+    const struct flash_area *fa;
+    int                      res;
+
+    /* Source image is the one running from the application slot */
+    if (0 != (res = flash_area_open(FIXED_PARTITION_ID(slot0_partition), &fa))) {
+        return res;
+    }
+    res = flash_area_read(fa, offset, buf, len);
+    flash_area_close(fa);
+
+    return res;
+}
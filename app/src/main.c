@@ -30,9 +30,7 @@ LOG_MODULE_REGISTER(wind_turbine_demo, LOG_LEVEL_INF);
 int
 main(void) {
 
-    /* FIXME: this should be a initialized in display.c instead of here */
-    extern int display_init(void);
-    display_init();
+    /* Nothing to do, all the modules are initialized with SYS_INIT */
 
     return 0;
 }
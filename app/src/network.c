@@ -26,6 +26,10 @@
 LOG_MODULE_REGISTER(wind_turbine_network, LOG_LEVEL_INF);
 
 #include <zephyr/net/net_mgmt.h>
+#if defined(CONFIG_NET_STATISTICS_TCP) && defined(CONFIG_NET_STATISTICS_USER_API)
+#include <zephyr/net/net_stats.h>
+#define NETWORK_LINK_STATS_TCP
+#endif
 #include <zephyr/net/conn_mgr_connectivity_impl.h>
 #ifdef CONFIG_WIFI
 #include <zephyr/net/wifi_mgmt.h>
@@ -33,6 +37,9 @@ LOG_MODULE_REGISTER(wind_turbine_network, LOG_LEVEL_INF);
 #endif /* CONFIG_WIFI */
 #include <zephyr/zbus/zbus.h>
 
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+#include "boot_profile.h"
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
 #include "messages.h"
 
 /**
@@ -45,6 +52,11 @@ LOG_MODULE_REGISTER(wind_turbine_network, LOG_LEVEL_INF);
  */
 #define NETWORK_WORK_QUEUE_PRIORITY (5)
 
+/**
+ * @brief Link statistics period (seconds)
+ */
+#define NETWORK_LINK_STATS_PERIOD (5)
+
 /**
  * @brief Initialize network interface
  * @return 0 if the function succeeds, error code otherwise
@@ -63,6 +75,12 @@ static void network_timer_callback(struct k_timer *handle);
  */
 static void network_work_handle_handler(struct k_work *handle);
 
+/**
+ * @brief Function used to periodically publish link statistics
+ * @param handle Work handler
+ */
+static void network_link_stats_work_handler(struct k_work *handle);
+
 /**
  * @brief Connection manager event handler
  * @param mgmt_event Event type
@@ -86,6 +104,11 @@ static void network_print_dhcpv4_addr(struct net_if *iface, struct net_if_addr *
  */
 ZBUS_CHAN_DEFINE(network_status_chan, struct network_status_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
 
+/**
+ * @brief Network link statistics channel
+ */
+ZBUS_CHAN_DEFINE(network_link_chan, struct network_link_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
+
 /**
  * @brief Network connect work queue stack
  */
@@ -106,6 +129,11 @@ static struct k_work_q network_work_queue_handle;
  */
 static struct k_work network_work_handle;
 
+/**
+ * @brief Link statistics work
+ */
+static struct k_work_delayable network_link_stats_work_handle;
+
 static int
 network_init(void) {
 
@@ -114,11 +142,16 @@ network_init(void) {
     k_work_queue_start(&network_work_queue_handle, network_work_queue_stack, NETWORK_WORK_QUEUE_STACK_SIZE, NETWORK_WORK_QUEUE_PRIORITY, NULL);
     k_thread_name_set(k_work_queue_thread_get(&network_work_queue_handle), "network_work_queue");
     k_work_init(&network_work_handle, network_work_handle_handler);
+    k_work_init_delayable(&network_link_stats_work_handle, network_link_stats_work_handler);
     k_timer_init(&network_timer_handle, network_timer_callback, NULL);
 
     /* Connect to the network */
     k_timer_start(&network_timer_handle, K_NO_WAIT, K_SECONDS(10));
 
+#ifdef CONFIG_WIND_TURBINE_BOOT_PROFILE
+    boot_profile_record(BOOT_PHASE_NETWORK);
+#endif /* CONFIG_WIND_TURBINE_BOOT_PROFILE */
+
     return 0;
 }
 
@@ -179,6 +212,43 @@ network_work_handle_handler(struct k_work *handle) {
 #endif /* CONFIG_WIFI */
 }
 
+static void
+network_link_stats_work_handler(struct k_work *handle) {
+
+    ARG_UNUSED(handle);
+    struct network_link_msg network_link_msg = { 0 };
+#ifdef CONFIG_WIFI
+    struct wifi_iface_status wifi_status = { 0 };
+#endif /* CONFIG_WIFI */
+#ifdef NETWORK_LINK_STATS_TCP
+    struct net_stats_tcp tcp_stats;
+    static uint32_t      retransmits = 0;
+#endif /* NETWORK_LINK_STATS_TCP */
+
+#ifdef CONFIG_WIFI
+    /* Retrieve RSSI */
+    if (0 == net_mgmt(NET_REQUEST_WIFI_IFACE_STATUS, net_if_get_default(), &wifi_status, sizeof(wifi_status))) {
+        network_link_msg.rssi_valid = true;
+        network_link_msg.rssi       = wifi_status.rssi;
+    }
+#endif /* CONFIG_WIFI */
+
+#ifdef NETWORK_LINK_STATS_TCP
+    /* Retrieve number of TCP segments retransmitted since the previous statistics */
+    if (0 == net_mgmt(NET_REQUEST_STATS_GET_TCP, net_if_get_default(), &tcp_stats, sizeof(tcp_stats))) {
+        network_link_msg.retransmits_valid = true;
+        network_link_msg.retransmits       = tcp_stats.rexmit - retransmits;
+        retransmits                        = tcp_stats.rexmit;
+    }
+#endif /* NETWORK_LINK_STATS_TCP */
+
+    /* Send link statistics */
+    zbus_chan_pub(&network_link_chan, &network_link_msg, K_MSEC(10));
+
+    /* Schedule next statistics */
+    k_work_schedule_for_queue(&network_work_queue_handle, &network_link_stats_work_handle, K_SECONDS(NETWORK_LINK_STATS_PERIOD));
+}
+
 static void
 network_print_dhcpv4_addr(struct net_if *iface, struct net_if_addr *if_addr, void *user_data) {
 
@@ -222,10 +292,14 @@ network_l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *info,
         k_timer_stop(&network_timer_handle);
         /* Print interface information */
         net_if_ipv4_addr_foreach(iface, network_print_dhcpv4_addr, NULL);
+        /* Start periodic link statistics */
+        k_work_schedule_for_queue(&network_work_queue_handle, &network_link_stats_work_handle, K_SECONDS(NETWORK_LINK_STATS_PERIOD));
     } else if (NET_EVENT_L4_DISCONNECTED == mgmt_event) {
         LOG_WRN("Network is disconnected");
         /* Start periodic connection request to reconnect the interface */
         k_timer_start(&network_timer_handle, K_NO_WAIT, K_SECONDS(10));
+        /* Stop periodic link statistics */
+        k_work_cancel_delayable(&network_link_stats_work_handle);
         /* Send network status */
         network_status_msg.connected = false;
         zbus_chan_pub(&network_status_chan, &network_status_msg, K_MSEC(10));
@@ -0,0 +1,213 @@
+/**
+ * @file      replay.c
+ * @brief     Replay of recorded wind profiles through the ADC emulator
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_replay, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+
+#include "cmdline.h"
+#include "posix_board_if.h"
+#include "posix_native_task.h"
+
+#include "replay.h"
+#include "replay_bottom.h"
+
+/**
+ * @brief Replay initialization
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int replay_init(void);
+
+/**
+ * @brief Register replay command line options
+ */
+static void replay_add_options(void);
+
+/**
+ * @brief ADC emulator raw value callback
+ * @param dev ADC emulator device
+ * @param chan ADC channel
+ * @param data User data (not used)
+ * @param result Raw 12 bits ADC sample
+ * @return Always returns 0
+ */
+static int replay_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result);
+
+/**
+ * @brief Function used to handle the end of the replay
+ * @param handle Work handler
+ */
+static void replay_work_handler(struct k_work *handle);
+
+/**
+ * @brief ADC channel driven by the replay
+ */
+static const struct adc_dt_spec replay_adc_channel = ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 0);
+
+/**
+ * @brief Replay options
+ */
+static char   *replay_file   = CONFIG_WIND_TURBINE_REPLAY_FILE;
+static char   *replay_output = CONFIG_WIND_TURBINE_REPLAY_OUTPUT;
+static int32_t replay_speed  = CONFIG_WIND_TURBINE_REPLAY_SPEED;
+static bool    replay_loop   = IS_ENABLED(CONFIG_WIND_TURBINE_REPLAY_LOOP);
+
+/**
+ * @brief Replay status
+ */
+static long     replay_samples_count  = 0;
+static int64_t  replay_start_time     = -1;
+static atomic_t replay_captured_count = ATOMIC_INIT(0);
+static atomic_t replay_done           = ATOMIC_INIT(0);
+
+/**
+ * @brief Work used to terminate the replay
+ */
+static struct k_work replay_work_handle;
+
+static int
+replay_init(void) {
+
+    int result;
+
+    LOG_INF("Initializing wind profile replay...");
+
+    /* Load wind profile */
+    if ((replay_samples_count = replay_bottom_load(replay_file)) <= 0) {
+        LOG_ERR("Unable to load wind profile '%s'", replay_file);
+        return -1;
+    }
+    LOG_INF("Loaded %ld samples from '%s', playback speed %d%%", replay_samples_count, replay_file, replay_speed);
+
+    /* Open telemetry output */
+    if (0 != (result = replay_bottom_output_open(replay_output))) {
+        LOG_ERR("Unable to open telemetry output '%s'", replay_output);
+        return result;
+    }
+
+    /* Drive the ADC emulator with the raw samples, so that they are replayed without any conversion */
+    k_work_init(&replay_work_handle, replay_work_handler);
+    if (0 != (result = adc_emul_raw_value_func_set(replay_adc_channel.dev, replay_adc_channel.channel_id, replay_adc_value_callback, NULL))) {
+        LOG_ERR("Unable to set ADC emulator raw value function, result = %d", result);
+        return result;
+    }
+
+    LOG_INF("Initializing wind profile replay: DONE");
+
+    return 0;
+}
+
+static void
+replay_add_options(void) {
+
+    static struct args_struct_t replay_options[] = {
+        { .option = "wind-profile", .name = "path", .type = 's', .dest = (void *)&replay_file, .descript = "Wind profile to be replayed" },
+        { .option = "wind-profile-speed", .name = "percent", .type = 'i', .dest = (void *)&replay_speed, .descript = "Wind profile playback speed" },
+        { .is_switch = true, .option = "wind-profile-loop", .type = 'b', .dest = (void *)&replay_loop, .descript = "Loop wind profile" },
+        { .option = "wind-profile-output", .name = "path", .type = 's', .dest = (void *)&replay_output, .descript = "Telemetry output file" },
+        ARG_TABLE_ENDMARKER
+    };
+
+    native_add_command_line_opts(replay_options);
+}
+
+static int
+replay_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result) {
+
+    ARG_UNUSED(dev);
+    ARG_UNUSED(chan);
+    ARG_UNUSED(data);
+    int64_t now = k_uptime_get();
+    long    index;
+
+    /* Start the replay on the first sampling */
+    if (replay_start_time < 0) {
+        replay_start_time = now;
+    }
+
+    /* Retrieve the sample matching the elapsed time */
+    index = (long)(((now - replay_start_time) * replay_speed) / (100 * CONFIG_WIND_TURBINE_REPLAY_SAMPLE_PERIOD_MS));
+    if (index >= replay_samples_count) {
+        if (true == replay_loop) {
+            index %= replay_samples_count;
+        } else {
+            index = replay_samples_count - 1;
+            if (atomic_cas(&replay_done, 0, 1)) {
+                k_work_submit(&replay_work_handle);
+            }
+        }
+    }
+
+    /* Return raw sample */
+    *result = replay_bottom_sample(index);
+
+    return 0;
+}
+
+static void
+replay_work_handler(struct k_work *handle) {
+
+    ARG_UNUSED(handle);
+
+    /* Dump telemetry and terminate the simulation */
+    replay_bottom_output_close();
+    LOG_INF("Wind profile replay done: %ld samples in %lld ms, %ld payloads captured in '%s'",
+            replay_samples_count,
+            (long long)(k_uptime_get() - replay_start_time),
+            (long)atomic_get(&replay_captured_count),
+            replay_output);
+    posix_exit(0);
+}
+
+void
+replay_capture(const char *topic, const char *payload, size_t len) {
+
+    char header[48];
+
+    /* Check if the replay is still running */
+    if (0 != atomic_get(&replay_done)) {
+        return;
+    }
+
+    /* Write payload with the simulated time, deterministic from one run to another */
+    snprintf(header, sizeof(header), "%lld %s ", (long long)k_uptime_get(), topic);
+    replay_bottom_output_write(header, strlen(header));
+    replay_bottom_output_write(payload, len);
+    replay_bottom_output_write("\n", 1);
+    atomic_inc(&replay_captured_count);
+}
+
+/**
+ * @brief Register command line options
+ */
+NATIVE_TASK(replay_add_options, PRE_BOOT_1, 10);
+
+/**
+ * @brief Initialization of replay, before the wind turbine starts sampling
+ */
+SYS_INIT(replay_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,163 @@
+/**
+ * @file      replay_bottom.c
+ * @brief     Wind profile replay host side implementation
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file is built with the native simulator runner and has access to the host C library */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay_bottom.h"
+
+/**
+ * @brief ADC full scale (12 bits resolution)
+ */
+#define REPLAY_BOTTOM_ADC_FULL_SCALE (4096)
+
+/**
+ * @brief Maximum wind speed (km/h), matching the full scale of the ADC
+ */
+#define REPLAY_BOTTOM_WIND_SPEED_MAX (100)
+
+/**
+ * @brief Wind profile samples
+ */
+static uint16_t *replay_bottom_samples          = NULL;
+static long      replay_bottom_samples_count    = 0;
+static long      replay_bottom_samples_capacity = 0;
+
+/**
+ * @brief Telemetry output file
+ */
+static FILE *replay_bottom_output = NULL;
+
+/**
+ * @brief Append sample to the wind profile
+ * @param sample Raw 12 bits ADC sample
+ * @return 0 if the function succeeds, -1 otherwise
+ */
+static int
+replay_bottom_append(uint16_t sample) {
+
+    uint16_t *samples;
+
+    /* Grow samples buffer when needed */
+    if (replay_bottom_samples_count >= replay_bottom_samples_capacity) {
+        replay_bottom_samples_capacity = (0 != replay_bottom_samples_capacity) ? (2 * replay_bottom_samples_capacity) : 1024;
+        if (NULL == (samples = realloc(replay_bottom_samples, replay_bottom_samples_capacity * sizeof(uint16_t)))) {
+            return -1;
+        }
+        replay_bottom_samples = samples;
+    }
+
+    /* Saturate sample to the ADC full scale */
+    replay_bottom_samples[replay_bottom_samples_count++] = (sample < REPLAY_BOTTOM_ADC_FULL_SCALE) ? sample : (REPLAY_BOTTOM_ADC_FULL_SCALE - 1);
+
+    return 0;
+}
+
+long
+replay_bottom_load(const char *path) {
+
+    FILE   *file;
+    char    line[64];
+    double  wind_speed;
+    uint8_t raw[2];
+    size_t  len    = strlen(path);
+    long    result = -1;
+
+    /* Open wind profile */
+    if (NULL == (file = fopen(path, "rb"))) {
+        fprintf(stderr, "replay: unable to open wind profile '%s'\n", path);
+        return -1;
+    }
+
+    /* Parse samples */
+    if ((len > 4) && (0 == strcmp(&path[len - 4], ".csv"))) {
+        while (NULL != fgets(line, sizeof(line), file)) {
+            /* Skip empty lines, comments and header */
+            if (1 != sscanf(line, "%lf", &wind_speed)) {
+                continue;
+            }
+            if (wind_speed < 0) {
+                wind_speed = 0;
+            }
+            if (0 != replay_bottom_append((uint16_t)((wind_speed * REPLAY_BOTTOM_ADC_FULL_SCALE) / REPLAY_BOTTOM_WIND_SPEED_MAX))) {
+                goto END;
+            }
+        }
+    } else {
+        while (sizeof(raw) == fread(raw, 1, sizeof(raw), file)) {
+            if (0 != replay_bottom_append((uint16_t)(raw[0] | (raw[1] << 8)))) {
+                goto END;
+            }
+        }
+    }
+
+    result = replay_bottom_samples_count;
+
+END:
+
+    /* Release file */
+    fclose(file);
+
+    return result;
+}
+
+uint16_t
+replay_bottom_sample(long index) {
+
+    if ((index < 0) || (index >= replay_bottom_samples_count)) {
+        return 0;
+    }
+
+    return replay_bottom_samples[index];
+}
+
+int
+replay_bottom_output_open(const char *path) {
+
+    /* Open telemetry output file */
+    if (NULL == (replay_bottom_output = fopen(path, "w"))) {
+        fprintf(stderr, "replay: unable to open telemetry output '%s'\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+replay_bottom_output_write(const char *data, size_t len) {
+
+    if (NULL != replay_bottom_output) {
+        fwrite(data, 1, len, replay_bottom_output);
+    }
+}
+
+void
+replay_bottom_output_close(void) {
+
+    if (NULL != replay_bottom_output) {
+        fclose(replay_bottom_output);
+        replay_bottom_output = NULL;
+    }
+}
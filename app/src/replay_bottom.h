@@ -0,0 +1,71 @@
+/**
+ * @file      replay_bottom.h
+ * @brief     Wind profile replay host side APIs
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REPLAY_BOTTOM_H__
+#define __REPLAY_BOTTOM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Load wind profile from the host
+ * @note Files ending with ".csv" contain one wind speed (km/h) per line, other files contain raw little-endian 16 bits ADC samples
+ * @param path Wind profile file path
+ * @return Number of samples loaded, negative value if the file can not be loaded
+ */
+long replay_bottom_load(const char *path);
+
+/**
+ * @brief Get sample of the wind profile
+ * @param index Sample index
+ * @return Raw 12 bits ADC sample
+ */
+uint16_t replay_bottom_sample(long index);
+
+/**
+ * @brief Open telemetry output file on the host
+ * @param path Telemetry output file path
+ * @return 0 if the function succeeds, negative value otherwise
+ */
+int replay_bottom_output_open(const char *path);
+
+/**
+ * @brief Write to telemetry output file
+ * @param data Data to be written
+ * @param len Length of data
+ */
+void replay_bottom_output_write(const char *data, size_t len);
+
+/**
+ * @brief Close telemetry output file
+ */
+void replay_bottom_output_close(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __REPLAY_BOTTOM_H__ */
@@ -0,0 +1,302 @@
+/**
+ * @file      soak.c
+ * @brief     Accelerated-time soak test
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wind_turbine_soak, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/sys/sys_heap.h>
+#if defined(CONFIG_NET_STATISTICS_TCP) && defined(CONFIG_NET_STATISTICS_USER_API)
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/net_stats.h>
+#endif /* CONFIG_NET_STATISTICS_TCP && CONFIG_NET_STATISTICS_USER_API */
+#ifdef CONFIG_LVGL
+#include <lvgl_mem.h>
+#endif /* CONFIG_LVGL */
+#ifdef CONFIG_MBEDTLS_MEMORY_DEBUG
+#include <mbedtls/memory_buffer_alloc.h>
+#endif /* CONFIG_MBEDTLS_MEMORY_DEBUG */
+
+#include "cmdline.h"
+#include "posix_board_if.h"
+#include "posix_native_task.h"
+
+#include "app/subsys/kamea.h"
+
+#include "soak.h"
+
+/**
+ * @brief ADC full scale (12 bits resolution)
+ */
+#define SOAK_ADC_FULL_SCALE (4096)
+
+/**
+ * @brief Maximum step of the simulated wind profile between two samplings (ADC counts)
+ */
+#define SOAK_ADC_MAX_STEP (64)
+
+/**
+ * @brief Soak test initialization
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int soak_init(void);
+
+/**
+ * @brief Register soak test command line options
+ */
+static void soak_add_options(void);
+
+#ifndef CONFIG_WIND_TURBINE_REPLAY
+
+/**
+ * @brief ADC emulator value callback
+ * @note Simulates a deterministic wind profile using a pseudo-random walk with a fixed seed
+ * @param dev ADC emulator device
+ * @param chan ADC channel
+ * @param data User data (not used)
+ * @param result Input voltage (millivolts)
+ * @return Always returns 0
+ */
+static int soak_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result);
+
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+/**
+ * @brief Print stack usage of a thread
+ * @param thread Thread
+ * @param user_data User data (not used)
+ */
+static void soak_print_thread_stack(const struct k_thread *thread, void *user_data);
+
+/**
+ * @brief Function used to print the report at the end of the soak test
+ * @param handle Work handler
+ */
+static void soak_work_handler(struct k_work *handle);
+
+/**
+ * @brief Soak test duration (seconds of simulated time)
+ */
+static uint32_t soak_duration = CONFIG_WIND_TURBINE_SOAK_DURATION;
+
+/**
+ * @brief Soak test counters
+ */
+static atomic_t soak_publish_succeeded = ATOMIC_INIT(0);
+static atomic_t soak_publish_dropped   = ATOMIC_INIT(0);
+static atomic_t soak_connections       = ATOMIC_INIT(0);
+static atomic_t soak_disconnections    = ATOMIC_INIT(0);
+
+/**
+ * @brief Work used to terminate the soak test
+ */
+static struct k_work_delayable soak_work_handle;
+
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+
+/**
+ * @brief Kamea cloud MQTT client instance
+ */
+KAMEA_MQTT_DECLARE(kamea_cloud);
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+#ifndef CONFIG_WIND_TURBINE_REPLAY
+
+/**
+ * @brief ADC channel driven by the soak test
+ */
+static const struct adc_dt_spec soak_adc_channel = ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 0);
+
+/**
+ * @brief Simulated wind profile
+ */
+static uint32_t soak_adc_seed  = 0x5eed;
+static int32_t  soak_adc_value = SOAK_ADC_FULL_SCALE / 2;
+static uint16_t soak_adc_ref_mv;
+
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+static int
+soak_init(void) {
+
+    LOG_INF("Initializing soak test...");
+
+#ifndef CONFIG_WIND_TURBINE_REPLAY
+    int result;
+
+    /* Drive the ADC emulator, unless a wind profile is replayed */
+    soak_adc_ref_mv = adc_ref_internal(soak_adc_channel.dev);
+    if (0 != (result = adc_emul_value_func_set(soak_adc_channel.dev, soak_adc_channel.channel_id, soak_adc_value_callback, NULL))) {
+        LOG_ERR("Unable to set ADC emulator value function, result = %d", result);
+        return result;
+    }
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+    /* Schedule the end of the soak test */
+    k_work_init_delayable(&soak_work_handle, soak_work_handler);
+    k_work_schedule(&soak_work_handle, K_SECONDS(soak_duration));
+
+    LOG_INF("Initializing soak test: DONE, running for %u seconds", soak_duration);
+
+    return 0;
+}
+
+static void
+soak_add_options(void) {
+
+    static struct args_struct_t soak_options[] = {
+        { .option = "soak-duration", .name = "seconds", .type = 'u', .dest = (void *)&soak_duration, .descript = "Soak test duration (simulated time)" },
+        ARG_TABLE_ENDMARKER
+    };
+
+    native_add_command_line_opts(soak_options);
+}
+
+#ifndef CONFIG_WIND_TURBINE_REPLAY
+
+static int
+soak_adc_value_callback(const struct device *dev, unsigned int chan, void *data, uint32_t *result) {
+
+    ARG_UNUSED(dev);
+    ARG_UNUSED(chan);
+    ARG_UNUSED(data);
+
+    /* Pseudo-random walk, the sequence only depends on the number of samplings */
+    soak_adc_seed = (soak_adc_seed * 1103515245U) + 12345U;
+    soak_adc_value += (int32_t)((soak_adc_seed >> 16) % (2 * SOAK_ADC_MAX_STEP + 1)) - SOAK_ADC_MAX_STEP;
+    soak_adc_value = CLAMP(soak_adc_value, 0, SOAK_ADC_FULL_SCALE - 1);
+
+    /* Convert raw value to input voltage */
+    *result = ((uint32_t)soak_adc_value * soak_adc_ref_mv) / SOAK_ADC_FULL_SCALE;
+
+    return 0;
+}
+
+#endif /* CONFIG_WIND_TURBINE_REPLAY */
+
+void
+soak_record_publish(int result) {
+
+    if (0 == result) {
+        atomic_inc(&soak_publish_succeeded);
+    } else {
+        atomic_inc(&soak_publish_dropped);
+    }
+}
+
+void
+soak_record_connection(bool connected) {
+
+    if (true == connected) {
+        atomic_inc(&soak_connections);
+    } else {
+        atomic_inc(&soak_disconnections);
+    }
+}
+
+static void
+soak_print_thread_stack(const struct k_thread *thread, void *user_data) {
+
+    ARG_UNUSED(user_data);
+    size_t      unused = 0;
+    const char *name   = k_thread_name_get((k_tid_t)thread);
+
+    /* Print stack high-water mark */
+    if (0 == k_thread_stack_space_get(thread, &unused)) {
+        LOG_INF("  stack %s: %zu / %zu bytes", (NULL != name) ? name : "?", thread->stack_info.size - unused, thread->stack_info.size);
+    }
+}
+
+static void
+soak_work_handler(struct k_work *handle) {
+
+    ARG_UNUSED(handle);
+    uint32_t connections = atomic_get(&soak_connections);
+
+    /* Print report */
+    LOG_INF("Soak test report after %u seconds", soak_duration);
+    LOG_INF("  publishes: %ld succeeded, %ld dropped", atomic_get(&soak_publish_succeeded), atomic_get(&soak_publish_dropped));
+    LOG_INF("  connections: %u, disconnections: %ld, reconnects: %u",
+            connections,
+            atomic_get(&soak_disconnections),
+            (connections > 0) ? (connections - 1) : 0);
+#ifdef CONFIG_KAMEA_CHANNEL_MQTT
+    kamea_mqtt_duty_stats_t duty;
+    kamea_mqtt_get_duty_stats(&kamea_cloud, &duty);
+    LOG_INF("  kamea: %u connection attempts, connected %u s (%u%% of the time)",
+            duty.connections,
+            (uint32_t)(duty.connected_ms / 1000),
+            (uint32_t)((100 * duty.connected_ms) / (1000ULL * soak_duration)));
+    kamea_mqtt_session_stats_t session;
+    kamea_mqtt_get_session_stats(&kamea_cloud, &session);
+    LOG_INF("  kamea: %u sessions (%u resumed), %u QoS 1 messages sent again", session.sessions, session.resumed, session.resent);
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+#ifdef CONFIG_KAMEA_CHANNEL_COAP
+    kamea_coap_stats_t coap;
+    kamea_coap_get_stats(&coap);
+    LOG_INF("  kamea: %u messages, %u bytes per message, %u retransmissions, %u timeouts, %u handshakes, last one %u ms",
+            coap.messages,
+            (coap.messages > 0) ? (coap.bytes / coap.messages) : 0,
+            coap.retransmissions,
+            coap.timeouts,
+            coap.connections,
+            coap.handshake_ms);
+#endif /* CONFIG_KAMEA_CHANNEL_COAP */
+#if defined(CONFIG_NET_STATISTICS_TCP) && defined(CONFIG_NET_STATISTICS_USER_API)
+    struct net_stats_tcp tcp_stats;
+    if (0 == net_mgmt(NET_REQUEST_STATS_GET_TCP, net_if_get_default(), &tcp_stats, sizeof(tcp_stats))) {
+        LOG_INF("  tcp: %u bytes sent, %u bytes received, %u bytes per hour",
+                tcp_stats.bytes.sent,
+                tcp_stats.bytes.received,
+                (uint32_t)((3600ULL * (tcp_stats.bytes.sent + tcp_stats.bytes.received)) / soak_duration));
+    }
+#endif /* CONFIG_NET_STATISTICS_TCP && CONFIG_NET_STATISTICS_USER_API */
+#if defined(CONFIG_LV_Z_MEM_POOL_SYS_HEAP) && defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+    struct sys_memory_stats stats;
+    lvgl_heap_stats(&stats);
+    LOG_INF("  heap lvgl: %zu / %zu bytes", stats.max_allocated_bytes, stats.free_bytes + stats.allocated_bytes);
+#endif /* CONFIG_LV_Z_MEM_POOL_SYS_HEAP && CONFIG_SYS_HEAP_RUNTIME_STATS */
+#ifdef CONFIG_MBEDTLS_MEMORY_DEBUG
+    size_t max_used, max_blocks;
+    mbedtls_memory_buffer_alloc_max_get(&max_used, &max_blocks);
+    LOG_INF("  heap mbedtls: %zu / %d bytes, %zu blocks", max_used, CONFIG_MBEDTLS_HEAP_SIZE, max_blocks);
+#endif /* CONFIG_MBEDTLS_MEMORY_DEBUG */
+    k_thread_foreach(soak_print_thread_stack, NULL);
+
+    /* Flush the deferred log messages, the report would be lost otherwise, and terminate the simulation */
+    LOG_PANIC();
+    posix_exit(0);
+}
+
+/**
+ * @brief Register command line options
+ */
+NATIVE_TASK(soak_add_options, PRE_BOOT_1, 10);
+
+/**
+ * @brief Initialization of soak test
+ */
+SYS_INIT(soak_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -49,6 +49,16 @@ LOG_MODULE_REGISTER(wind_turbine_wind_turbine, LOG_LEVEL_INF);
  */
 ZBUS_CHAN_DEFINE(wind_turbine_status_chan, struct wind_turbine_status_msg, NULL, NULL, ZBUS_OBSERVERS_EMPTY, ZBUS_MSG_INIT(0));
 
+/**
+ * @brief Wind turbine configuration channel, applied to the motor at the next sampling
+ */
+ZBUS_CHAN_DEFINE(wind_turbine_config_chan,
+                 struct wind_turbine_config_msg,
+                 NULL,
+                 NULL,
+                 ZBUS_OBSERVERS_EMPTY,
+                 ZBUS_MSG_INIT(.turned_on = true, .limiter = CONFIG_WIND_TURBINE_LIMITER_DEFAULT));
+
 /**
  * @brief Ensure ADC channel has been defined in the device tree
  */
@@ -92,6 +102,9 @@ wind_turbine_thread(void) {
         .buffer_size = sizeof(adc_value),
     };
     struct wind_turbine_status_msg wind_turbine_status_msg = { 0 };
+#ifdef CONFIG_PWM
+    struct wind_turbine_config_msg wind_turbine_config_msg = { .turned_on = true, .limiter = CONFIG_WIND_TURBINE_LIMITER_DEFAULT };
+#endif /* CONFIG_PWM */
     double                         raw_value, voltage;
 
     LOG_INF("Initializing wind turbine...");
@@ -129,8 +142,15 @@ wind_turbine_thread(void) {
 
 #ifdef CONFIG_PWM
 
-        /* Drive motor according to current wind turbine simulated parameters */
-        pwm_set(wind_turbine_motor_timer_pwm, WIND_TURBINE_MOTOR_TIMER_PWM_CHANNEL, 1000000, (raw_value * 1000000) / 4096, 0);
+        /* Retrieve configuration, the previous one is kept if the channel is busy */
+        zbus_chan_read(&wind_turbine_config_chan, &wind_turbine_config_msg, K_NO_WAIT);
+
+        /* Drive motor according to current wind turbine simulated parameters, limited by the configuration */
+        pwm_set(wind_turbine_motor_timer_pwm,
+                WIND_TURBINE_MOTOR_TIMER_PWM_CHANNEL,
+                1000000,
+                (true == wind_turbine_config_msg.turned_on) ? MIN((raw_value * 1000000) / 4096, 10000 * wind_turbine_config_msg.limiter) : 0,
+                0);
 
 #endif /* CONFIG_PWM */
 
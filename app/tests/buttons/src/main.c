@@ -0,0 +1,274 @@
+/**
+ * @file      main.c
+ * @brief     Buttons debounce and publish rate test, bounce patterns are injected with the GPIO emulator
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/input/input.h>
+#include <zephyr/zbus/zbus.h>
+#include <zephyr/ztest.h>
+
+#include "messages.h"
+
+/**
+ * @brief Button under test
+ */
+#define BUTTONS_TEST_NODE DT_ALIAS(wind_turbine_top_button)
+
+/**
+ * @brief Name of the button under test, published in the button status
+ */
+#define BUTTONS_TEST_NAME "Wind Turbine Top Button"
+
+/**
+ * @brief Debounce interval of the gpio-keys driver (milliseconds)
+ */
+#define BUTTONS_TEST_DEBOUNCE_MS DT_PROP(DT_PARENT(BUTTONS_TEST_NODE), debounce_interval_ms)
+
+/**
+ * @brief Delay after which the debounced state is published (milliseconds)
+ */
+#define BUTTONS_TEST_SETTLE_MS (BUTTONS_TEST_DEBOUNCE_MS + CONFIG_WIND_TURBINE_BUTTONS_MIN_INTERVAL_MS + 100)
+
+/**
+ * @brief Period of the bounces, shorter than the debounce interval (microseconds)
+ */
+#define BUTTONS_TEST_BOUNCE_PERIOD_US (200)
+
+/**
+ * @brief Number of toggles of a bounce, lasting less than the debounce interval
+ */
+#define BUTTONS_TEST_BOUNCE_TOGGLES (50)
+
+/**
+ * @brief Input event callback, counts the events of the button under test
+ * @param evt Input event
+ * @param user_data User data (not used)
+ */
+static void buttons_test_input_callback(struct input_event *evt, void *user_data);
+
+/**
+ * @brief Button status callback, counts the status published for the button under test
+ * @param chan Channel
+ */
+static void buttons_test_status_cb(const struct zbus_channel *chan);
+
+/**
+ * @brief Function used to inject a bounce pattern, then to set the final state of the button
+ * @param toggles Number of toggles
+ * @param pressed Final state of the button
+ */
+static void buttons_test_bounce(int toggles, bool pressed);
+
+/**
+ * @brief Suite setup, the button status listener is registered
+ * @return Not used
+ */
+static void *buttons_test_setup(void);
+
+/**
+ * @brief Test setup, the button is released and the counters are cleared
+ * @param fixture Not used
+ */
+static void buttons_test_before(void *fixture);
+
+/**
+ * @brief Buttons status channel
+ */
+ZBUS_CHAN_DECLARE(buttons_status_chan);
+
+/**
+ * @brief Buttons status listener
+ */
+ZBUS_LISTENER_DEFINE(buttons_test_status_listenner, buttons_test_status_cb);
+
+/**
+ * @brief Input callback definition
+ */
+INPUT_CALLBACK_DEFINE(DEVICE_DT_GET(DT_PARENT(BUTTONS_TEST_NODE)), buttons_test_input_callback, NULL);
+
+/**
+ * @brief GPIO of the button under test
+ */
+static const struct gpio_dt_spec buttons_test_gpio = GPIO_DT_SPEC_GET(BUTTONS_TEST_NODE, gpios);
+
+static atomic_t buttons_test_events;     /**< Number of input events received */
+static atomic_t buttons_test_published;  /**< Number of button status published */
+static atomic_t buttons_test_pressed;    /**< Number of press published */
+static atomic_t buttons_test_long_press; /**< Number of long press published */
+static atomic_t buttons_test_state;      /**< Last published state */
+
+static void
+buttons_test_input_callback(struct input_event *evt, void *user_data) {
+
+    ARG_UNUSED(user_data);
+
+    if ((INPUT_EV_KEY == evt->type) && (DT_PROP(BUTTONS_TEST_NODE, zephyr_code) == evt->code)) {
+        atomic_inc(&buttons_test_events);
+    }
+}
+
+static void
+buttons_test_status_cb(const struct zbus_channel *chan) {
+
+    const struct button_status_msg *msg = zbus_chan_const_msg(chan);
+
+    if (0 != strcmp(msg->name, BUTTONS_TEST_NAME)) {
+        return;
+    }
+    if (true == msg->long_press) {
+        atomic_inc(&buttons_test_long_press);
+    } else {
+        atomic_inc(&buttons_test_published);
+        if (true == msg->state) {
+            atomic_inc(&buttons_test_pressed);
+        }
+    }
+    atomic_set(&buttons_test_state, (true == msg->state) ? 1 : 0);
+}
+
+static void
+buttons_test_bounce(int toggles, bool pressed) {
+
+    /* Toggle the GPIO, the GPIO is active low */
+    for (int toggle = 0; toggle < toggles; toggle++) {
+        gpio_emul_input_set(buttons_test_gpio.port, buttons_test_gpio.pin, toggle % 2);
+        k_sleep(K_USEC(BUTTONS_TEST_BOUNCE_PERIOD_US));
+    }
+    gpio_emul_input_set(buttons_test_gpio.port, buttons_test_gpio.pin, (true == pressed) ? 0 : 1);
+}
+
+static void *
+buttons_test_setup(void) {
+
+    zassert_ok(zbus_chan_add_obs(&buttons_status_chan, &buttons_test_status_listenner, K_MSEC(10)));
+
+    return NULL;
+}
+
+static void
+buttons_test_before(void *fixture) {
+
+    ARG_UNUSED(fixture);
+
+    /* Release the button and wait for the state to be published */
+    gpio_emul_input_set(buttons_test_gpio.port, buttons_test_gpio.pin, 1);
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+    atomic_clear(&buttons_test_events);
+    atomic_clear(&buttons_test_published);
+    atomic_clear(&buttons_test_pressed);
+    atomic_clear(&buttons_test_long_press);
+}
+
+/**
+ * @brief A bounce storm ending released is filtered, no event is reported
+ */
+ZTEST(buttons, test_bounce_storm_released) {
+
+    buttons_test_bounce(BUTTONS_TEST_BOUNCE_TOGGLES, false);
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+
+    zassert_equal(atomic_get(&buttons_test_events), 0, "Bounces reported as input events");
+    zassert_equal(atomic_get(&buttons_test_published), 0, "Bounces published");
+}
+
+/**
+ * @brief A press and a release with bounces are reported once each
+ */
+ZTEST(buttons, test_bouncy_press) {
+
+    buttons_test_bounce(BUTTONS_TEST_BOUNCE_TOGGLES, true);
+    k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + 100));
+    zassert_equal(atomic_get(&buttons_test_state), 1, "Press not published");
+    buttons_test_bounce(BUTTONS_TEST_BOUNCE_TOGGLES, false);
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+
+    zassert_equal(atomic_get(&buttons_test_events), 2, "Unexpected number of input events");
+    zassert_equal(atomic_get(&buttons_test_published), 2, "Unexpected number of button status published");
+    zassert_equal(atomic_get(&buttons_test_state), 0, "Release not published");
+}
+
+/**
+ * @brief Presses faster than the publish interval are coalesced, a press and the latest state are published
+ */
+ZTEST(buttons, test_coalesced_presses) {
+
+    /* Press and release longer than the debounce interval, but faster than the publish interval */
+    for (int press = 0; press < 4; press++) {
+        buttons_test_bounce(0, true);
+        k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + 10));
+        buttons_test_bounce(0, false);
+        k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + 10));
+    }
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+
+    zassert_equal(atomic_get(&buttons_test_events), 8, "Unexpected number of input events");
+    zassert_true(atomic_get(&buttons_test_published) < atomic_get(&buttons_test_events), "Button status not coalesced");
+    zassert_true(atomic_get(&buttons_test_pressed) >= 1, "Press not published");
+    zassert_equal(atomic_get(&buttons_test_state), 0, "Latest state not published");
+}
+
+/**
+ * @brief A press and a release within the publish interval following a publish are both published
+ */
+ZTEST(buttons, test_press_within_interval) {
+
+    /* Press then release, the release is published at the end of the publish interval following the press */
+    buttons_test_bounce(0, true);
+    k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + 10));
+    buttons_test_bounce(0, false);
+    k_sleep(K_MSEC(CONFIG_WIND_TURBINE_BUTTONS_MIN_INTERVAL_MS + 10));
+    zassert_equal(atomic_get(&buttons_test_state), 0, "Release not published");
+
+    /* Press and release again before the end of the publish interval following the release */
+    atomic_clear(&buttons_test_published);
+    atomic_clear(&buttons_test_pressed);
+    buttons_test_bounce(0, true);
+    k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + 10));
+    buttons_test_bounce(0, false);
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+
+    zassert_equal(atomic_get(&buttons_test_pressed), 1, "Press not published");
+    zassert_equal(atomic_get(&buttons_test_published), 2, "Unexpected number of button status published");
+    zassert_equal(atomic_get(&buttons_test_state), 0, "Release not published");
+}
+
+/**
+ * @brief A button held down is reported as a long press
+ */
+ZTEST(buttons, test_long_press) {
+
+    buttons_test_bounce(BUTTONS_TEST_BOUNCE_TOGGLES, true);
+    k_sleep(K_MSEC(BUTTONS_TEST_DEBOUNCE_MS + CONFIG_WIND_TURBINE_BUTTONS_LONG_PRESS_MS + 100));
+    buttons_test_bounce(BUTTONS_TEST_BOUNCE_TOGGLES, false);
+    k_sleep(K_MSEC(BUTTONS_TEST_SETTLE_MS));
+
+    zassert_equal(atomic_get(&buttons_test_events), 2, "Unexpected number of input events");
+    zassert_equal(atomic_get(&buttons_test_long_press), 1, "Long press not published");
+}
+
+/**
+ * @brief Buttons test suite
+ */
+ZTEST_SUITE(buttons, NULL, buttons_test_setup, buttons_test_before, NULL, NULL);
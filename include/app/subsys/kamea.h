@@ -27,19 +27,449 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Kamea publish priorities
+ */
+typedef enum {
+    KAMEA_PRIORITY_HIGH = 0, /**< Alerts, sent before any other message */
+    KAMEA_PRIORITY_NORMAL,   /**< Periodic telemetry and configs */
+    KAMEA_PRIORITY_LOW,      /**< Bulk data, sent only when no other message is pending */
+    KAMEA_PRIORITY_COUNT     /**< Number of priorities */
+} kamea_priority_t;
+
+/**
+ * @brief TLS cipher suites offered during the handshakes (IANA identifiers), all the suites enabled in mbedTLS are offered if not defined
+ */
+#if defined(CONFIG_KAMEA_TLS_CIPHER_PROFILE_ECDHE_ECDSA_AES128_GCM)
+#define KAMEA_TLS_CIPHERSUITES { 0xC02B } /* TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 */
+#elif defined(CONFIG_KAMEA_TLS_CIPHER_PROFILE_ECDHE_ECDSA_AES128_CCM_8)
+#define KAMEA_TLS_CIPHERSUITES { 0xC0AE } /* TLS_ECDHE_ECDSA_WITH_AES_128_CCM_8 */
+#elif defined(CONFIG_KAMEA_TLS_CIPHER_PROFILE_ECDHE_RSA_AES128_GCM)
+#define KAMEA_TLS_CIPHERSUITES { 0xC02F } /* TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 */
+#endif
+
 #ifdef CONFIG_KAMEA_CHANNEL_MQTT
 
+#include <zephyr/kernel.h>
 #include <zephyr/net/mqtt.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+
+/**
+ * @brief Maximum number of QoS 1 messages waiting for PUBACK tracked to measure the round-trip time
+ */
+#define KAMEA_MQTT_INFLIGHT_COUNT (8)
+
+/**
+ * @brief Maximum number of QoS 2 messages received waiting for PUBREL tracked to deliver them once
+ */
+#define KAMEA_MQTT_QOS2_COUNT (4)
+
+/**
+ * @brief Number of buckets of the latency histograms, bucket n counts values lower than 2^n milliseconds, the last one counts all the greater values
+ */
+#define KAMEA_MQTT_HISTOGRAM_BUCKETS (14)
+
+/**
+ * @brief Kamea MQTT client instance
+ */
+typedef struct kamea_mqtt kamea_mqtt_t;
 
 /**
  * @brief Kamea MQTT callbacks
  */
 typedef struct {
-    void (*connected)(void);          /**< Invoked when Kamea client is connected to the server */
-    void (*disconnected)(void);       /**< Invoked when Kamea client is disconnected of the server */
-    void (*published)(uint16_t, int); /**< Invoked to inform of payload published result */
+    void (*connected)(kamea_mqtt_t *);                /**< Invoked when Kamea client is connected to the server */
+    void (*disconnected)(kamea_mqtt_t *);             /**< Invoked when Kamea client is disconnected of the server */
+    void (*published)(kamea_mqtt_t *, uint16_t, int); /**< Invoked to inform of payload published result */
 } kamea_mqtt_callbacks_t;
 
+/**
+ * @brief Kamea MQTT client configuration
+ */
+typedef struct {
+    const char            *client_id;       /**< Client ID, copied */
+    const char            *hostname;        /**< Broker host name, must remain valid */
+    uint16_t               port;            /**< Broker port */
+    sec_tag_t              sec_tag;         /**< TLS credential tag of the device certificate and private key */
+    sec_tag_t              ca_sec_tag;      /**< TLS credential tag of the server CA certificate */
+    uint8_t               *public_cert;     /**< Device certificate, NULL if the credentials are already registered under the tags */
+    uint32_t               public_cert_len; /**< Length of device certificate */
+    uint8_t               *private_key;     /**< Device private key */
+    uint32_t               private_key_len; /**< Length of device private key */
+    uint8_t               *ca_cert;         /**< Server CA certificate */
+    uint32_t               ca_cert_len;     /**< Length of server CA certificate */
+    kamea_mqtt_callbacks_t callbacks;       /**< Callbacks */
+} kamea_mqtt_config_t;
+
+/**
+ * @brief Kamea MQTT duty cycle statistics
+ */
+typedef struct {
+    uint32_t connections;  /**< Number of connections, successful or not */
+    uint64_t connected_ms; /**< Time spent connecting and connected (milliseconds) */
+} kamea_mqtt_duty_stats_t;
+
+/**
+ * @brief Kamea MQTT session statistics, used to compare persistent and clean sessions
+ */
+typedef struct {
+    uint32_t sessions;        /**< Number of connections accepted by the broker */
+    uint32_t resumed;         /**< Number of connections resuming a persistent session */
+    uint32_t resent;          /**< Number of QoS 1 messages sent again after reconnecting */
+    uint32_t received;        /**< Number of connections on which a message has been received */
+    uint32_t received_ms;     /**< Time from opening the latest of these connections to the first message received (milliseconds) */
+    uint32_t acknowledged;    /**< Number of connections on which a PUBACK has been received */
+    uint32_t acknowledged_ms; /**< Time from opening the latest of these connections to the first PUBACK received (milliseconds) */
+} kamea_mqtt_session_stats_t;
+
+/**
+ * @brief Kamea MQTT channel statistics, since initialization
+ */
+typedef struct {
+    uint32_t published;                                /**< Number of messages written to the socket */
+    uint32_t failed;                                   /**< Number of messages which could not be written to the socket */
+    uint32_t dropped;                                  /**< Number of messages dropped while disconnected or because the queue was full */
+    uint32_t acknowledged;                             /**< Number of PUBACK received */
+    uint32_t received;                                 /**< Number of messages received */
+    uint64_t bytes_sent;                               /**< Payload bytes written to the socket */
+    uint64_t bytes_received;                           /**< Payload bytes received */
+    uint32_t handshakes;                               /**< Number of successful TCP and TLS handshakes */
+    uint32_t handshake_failures;                       /**< Number of failed TCP and TLS handshakes */
+    uint32_t handshake_ms;                             /**< Duration of the latest successful TCP and TLS handshake (milliseconds) */
+    uint32_t ciphersuite;                              /**< TLS cipher suite negotiated during the latest handshake (IANA identifier) */
+    uint32_t disconnections;                           /**< Number of connections closed, lost or graceful */
+    uint32_t uptime_s;                                 /**< Time since CONNACK of the current connection (seconds), 0 if disconnected */
+    uint32_t handshake[KAMEA_MQTT_HISTOGRAM_BUCKETS];  /**< TCP and TLS handshake durations histogram */
+    uint32_t puback_rtt[KAMEA_MQTT_HISTOGRAM_BUCKETS]; /**< PUBACK round-trip times histogram */
+} kamea_mqtt_stats_t;
+
+/**
+ * @brief Kamea MQTT streamed payload
+ */
+typedef struct {
+    size_t len;                            /**< Total length of payload */
+    int (*next)(void *, const uint8_t **); /**< Invoked with user data to retrieve the next chunk, returns its length, 0 at the end or error code */
+    void *user_data;                       /**< User data given to the iterator */
+} kamea_mqtt_stream_t;
+
+/**
+ * @brief Kamea MQTT received payload slice
+ * @note Payloads larger than the space left in the MQTT Rx buffer after the message header are delivered in several slices
+ */
+typedef struct {
+    const char *topic;     /**< Topic, relative to the device topic, not null-terminated */
+    size_t      topic_len; /**< Length of topic */
+    uint8_t    *data;      /**< Payload slice, located in the MQTT Rx buffer, can be modified and is valid until the handler returns */
+    size_t      len;       /**< Length of payload slice */
+    size_t      offset;    /**< Offset of the slice in the payload */
+    size_t      total_len; /**< Total length of payload, the slice is the last one when offset + len equals total_len */
+} kamea_mqtt_slice_t;
+
+/**
+ * @brief Kamea MQTT subscription handler, invoked from the Kamea MQTT thread for each slice of a matching message
+ * @param slice Payload slice
+ * @param user_data User data given at subscription
+ */
+typedef void (*kamea_mqtt_handler_t)(const kamea_mqtt_slice_t *slice, void *user_data);
+
+/**
+ * @brief Kamea MQTT publish message
+ */
+struct kamea_mqtt_message {
+    void                             *fifo_reserved;                           /**< Reserved for FIFO use */
+    const char                       *topic;                                   /**< Topic, relative to the device topic */
+    enum mqtt_qos                     qos;                                     /**< MQTT QOS */
+    uint16_t                          message_id;                              /**< Message ID */
+    uint16_t                          len;                                     /**< Length of payload */
+    uint32_t                          timestamp;                               /**< Queuing timestamp (cycles) */
+    struct kamea_mqtt_stream_request *request;                                 /**< Streamed payload request, NULL if the payload is copied */
+    bool                              cancelled;                               /**< Streamed payload request has timed out and must not be used anymore */
+    uint8_t                           payload[CONFIG_KAMEA_MQTT_PAYLOAD_SIZE]; /**< Payload */
+};
+
+/**
+ * @brief Kamea MQTT message waiting for PUBACK
+ */
+struct kamea_mqtt_inflight {
+    bool                       used;       /**< Entry is used */
+    uint16_t                   message_id; /**< Message ID */
+    uint32_t                   timestamp;  /**< Publish timestamp (cycles) */
+    uint32_t                   queued;     /**< Queuing timestamp (cycles) */
+    kamea_priority_t           priority;   /**< Priority of the lane the message has been allocated from */
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+    struct kamea_mqtt_message *message;    /**< Message kept to be sent again after reconnecting, NULL for streamed messages */
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+};
+
+/**
+ * @brief Kamea MQTT subscription
+ */
+struct kamea_mqtt_subscription {
+    const char          *filter;     /**< Topic filter, relative to the device topic */
+    enum mqtt_qos        qos;        /**< Maximum MQTT QOS */
+    kamea_mqtt_handler_t handler;    /**< Handler */
+    void                *user_data;  /**< User data given to the handler */
+    bool                 subscribed; /**< Subscription has been sent to the server */
+};
+
+/**
+ * @brief Kamea MQTT publish lane, one per priority
+ */
+struct kamea_mqtt_lane {
+    struct k_mem_slab slab;                                           /**< Messages slab, bounds the number of queued messages */
+    struct k_fifo     fifo;                                           /**< Queued messages */
+    uint32_t          latency[CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];     /**< Latest publish latencies (microseconds) */
+    size_t            latency_count;                                  /**< Number of publish latencies recorded */
+    uint32_t          ack_latency[CONFIG_KAMEA_MQTT_LATENCY_SAMPLES]; /**< Latest QoS 1 latencies from queuing to PUBACK (microseconds) */
+    size_t            ack_latency_count;                              /**< Number of QoS 1 latencies recorded */
+};
+
+/**
+ * @brief Kamea MQTT client instance, defined with KAMEA_MQTT_DEFINE()
+ * @note Members are private, they are only accessed by the Kamea MQTT channel
+ */
+struct kamea_mqtt {
+    kamea_mqtt_config_t            config;                                               /**< Configuration */
+    char                           client_id[32];                                        /**< Client ID */
+    char                           device_topic[48];                                     /**< Device topic, prefix of all topics */
+    size_t                         device_topic_len;                                     /**< Length of device topic */
+    sec_tag_t                      sec_tag_list[2];                                      /**< TLS credential tags */
+    struct mqtt_client             client;                                               /**< MQTT client */
+    uint8_t                        rx_buffer[CONFIG_KAMEA_MQTT_RX_BUFFER_SIZE];          /**< MQTT Rx buffer */
+    uint8_t                        tx_buffer[CONFIG_KAMEA_MQTT_TX_BUFFER_SIZE];          /**< MQTT Tx buffer */
+    struct sockaddr_storage        broker;                                               /**< Broker address */
+    bool                           resolved;                                             /**< Broker address is resolved */
+    bool                           initialized;                                          /**< Instance is initialized */
+    size_t                         index;                                                /**< Index of the instance, in initialization order */
+    volatile bool                  open;                                                 /**< Connection is open, CONNACK may not be received yet */
+    volatile bool                  connected;                                            /**< CONNACK has been received */
+    atomic_t                       requested;                                            /**< Connection requested flag */
+    int64_t                        deadline;                                             /**< Next connection attempt or timeout (uptime in milliseconds) */
+    int64_t                        activity;                                             /**< Latest activity on the connection (uptime in milliseconds) */
+    struct kamea_mqtt_lane         lanes[KAMEA_PRIORITY_COUNT];                          /**< Publish lanes */
+    struct kamea_mqtt_message      messages_high[CONFIG_KAMEA_MQTT_QUEUE_HIGH_SIZE];     /**< High priority messages slab buffer */
+    struct kamea_mqtt_message      messages_normal[CONFIG_KAMEA_MQTT_QUEUE_NORMAL_SIZE]; /**< Normal priority messages slab buffer */
+    struct kamea_mqtt_message      messages_low[CONFIG_KAMEA_MQTT_QUEUE_LOW_SIZE];       /**< Low priority messages slab buffer */
+    struct k_spinlock              latency_lock;                                         /**< Protects latencies, dispatch times and statistics */
+    struct kamea_mqtt_inflight     inflight[KAMEA_MQTT_INFLIGHT_COUNT];                  /**< QoS 1 messages waiting for PUBACK */
+    size_t                         inflight_index;                                       /**< Next entry of the QoS 1 messages table */
+    uint16_t                       message_id;                                           /**< Latest message ID allocated */
+    struct kamea_mqtt_message     *stream;                                               /**< Streamed message being written, NULL if none */
+    struct kamea_mqtt_lane        *stream_lane;                                          /**< Lane the streamed message has been allocated from */
+    size_t                         stream_sent;                                          /**< Length of streamed payload written */
+    struct k_mutex                 stream_lock;                                          /**< Protects the streamed payload requests, detached on timeout */
+    struct kamea_mqtt_subscription subscriptions[CONFIG_KAMEA_MQTT_SUBSCRIPTIONS];       /**< Subscriptions, append-only */
+    atomic_t                       subscriptions_count;                                  /**< Number of subscriptions */
+    struct k_spinlock              subscriptions_lock;                                   /**< Serializes subscriptions */
+    atomic_t                       subscribe_pending;                                    /**< Subscriptions are waiting to be sent */
+    uint16_t                       qos2_received[KAMEA_MQTT_QOS2_COUNT];                 /**< QoS 2 messages waiting for PUBREL */
+    size_t                         qos2_index;                                           /**< Next entry of the QoS 2 messages table */
+    uint32_t                       dispatch_time[CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];     /**< Latest dispatch times (nanoseconds) */
+    size_t                         dispatch_count;                                       /**< Number of dispatch times recorded */
+    atomic_t                       puback_rtt;                                           /**< Smoothed PUBACK round-trip time (microseconds) */
+    atomic_t                       puback_time;                                          /**< Uptime of the latest PUBACK (milliseconds, 32 bits) */
+    kamea_mqtt_duty_stats_t        duty_stats;                                           /**< Duty cycle statistics */
+    int64_t                        duty_start;                                           /**< Start of the current connection, -1 if disconnected */
+    kamea_mqtt_stats_t             stats;                                                /**< Channel statistics */
+    int64_t                        connected_since;                                      /**< CONNACK of the current connection (uptime in milliseconds) */
+#ifdef CONFIG_KAMEA_MQTT_STATS_TELEMETRY
+    int64_t                        stats_deadline;                                       /**< Next statistics telemetry (uptime in milliseconds) */
+#endif /* CONFIG_KAMEA_MQTT_STATS_TELEMETRY */
+    kamea_mqtt_session_stats_t     session_stats;                                        /**< Session statistics */
+    int64_t                        session_start;                                        /**< Opening of the current connection (uptime in milliseconds) */
+    bool                           session_received;                                     /**< A message has been received on the current connection */
+    bool                           session_acknowledged;                                 /**< A PUBACK has been received on the current connection */
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+    bool                           session_stored;                                       /**< The session saved in the storage partition is not empty */
+    bool                           session_dirty;                                        /**< The in-flight messages have changed since the session was saved */
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+    struct k_timer                 batch_timer;                                          /**< Batch timer */
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+};
+
+/**
+ * @brief Define a Kamea MQTT client instance, initialized with kamea_mqtt_init()
+ * @param _name Name of the instance
+ */
+#define KAMEA_MQTT_DEFINE(_name) kamea_mqtt_t _name
+
+/**
+ * @brief Declare a Kamea MQTT client instance defined in another file
+ * @param _name Name of the instance
+ */
+#define KAMEA_MQTT_DECLARE(_name) extern kamea_mqtt_t _name
+
+/**
+ * @brief Initialize client instance and register it to the Kamea MQTT thread, which serves all the instances
+ * @param kamea Client instance
+ * @param config Client configuration
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_init(kamea_mqtt_t *kamea, const kamea_mqtt_config_t *config);
+
+/**
+ * @brief Open connection with the server
+ * @note The connection is established by the Kamea MQTT thread. When the connection manager is not used, this indicates that the network is available.
+ * @note In batch mode, the queued messages are sent then the client disconnects
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_connect(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Publish telemetry to the server
+ * @note The message is queued and sent by the Kamea MQTT thread, higher priorities first
+ * @param kamea Client instance
+ * @param data Telemetry data
+ * @param len Length of data
+ * @param qos MQTT QOS
+ * @param priority Publish priority
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_publish_telemetry(kamea_mqtt_t *kamea, uint8_t *data, uint32_t len, enum mqtt_qos qos, kamea_priority_t priority);
+
+/**
+ * @brief Publish telemetry streamed from an iterator to the server, the payload can be larger than the MQTT Tx buffer
+ * @note The message is queued and sent by the Kamea MQTT thread, which writes the header then one chunk per loop iteration directly to the socket
+ * @note The function blocks until the message is sent or dropped, it must not be called from the Kamea MQTT thread
+ * @note On timeout, the iterator is not invoked anymore and the message is dropped, closing the connection if it is partially written
+ * @param kamea Client instance
+ * @param stream Streamed payload, chunks must remain valid until the next invocation of the iterator
+ * @param qos MQTT QOS
+ * @param priority Publish priority
+ * @param timeout Maximum time to wait for the message to be sent
+ * @return 0 if the function succeeds, -ETIMEDOUT on timeout, error code otherwise
+ */
+int kamea_mqtt_publish_telemetry_stream(
+    kamea_mqtt_t *kamea, const kamea_mqtt_stream_t *stream, enum mqtt_qos qos, kamea_priority_t priority, k_timeout_t timeout);
+
+/**
+ * @brief Publish configs to the server
+ * @note The message is queued and sent by the Kamea MQTT thread, higher priorities first
+ * @param kamea Client instance
+ * @param data Configs data
+ * @param len Length of data
+ * @param qos MQTT QOS
+ * @param priority Publish priority
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_publish_configs(kamea_mqtt_t *kamea, uint8_t *data, uint32_t len, enum mqtt_qos qos, kamea_priority_t priority);
+
+/**
+ * @brief Subscribe to a topic filter
+ * @note Subscriptions are sent to the server by the Kamea MQTT thread, and sent again on each connection
+ * @note This function can be invoked before kamea_mqtt_init()
+ * @param kamea Client instance
+ * @param filter Topic filter, relative to the device topic, supporting '+' and '#' wildcards, must remain valid
+ * @param qos Maximum MQTT QOS of the messages received
+ * @param handler Handler invoked for each slice of the matching messages
+ * @param user_data User data given to the handler
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_subscribe(kamea_mqtt_t *kamea, const char *filter, enum mqtt_qos qos, kamea_mqtt_handler_t handler, void *user_data);
+
+/**
+ * @brief Get the smoothed round-trip time between QoS 1 publish and PUBACK
+ * @param kamea Client instance
+ * @return Round-trip time (microseconds), 0 if not measured yet or if no PUBACK has been received for CONFIG_KAMEA_MQTT_PUBACK_RTT_MAX_AGE seconds
+ */
+uint32_t kamea_mqtt_get_puback_rtt(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Get the latest publish latencies, from queuing to writing to the socket
+ * @param kamea Client instance
+ * @param priority Publish priority
+ * @param samples Buffer used to store the latencies (microseconds)
+ * @param count Maximum number of latencies to store
+ * @return Number of latencies stored
+ */
+size_t kamea_mqtt_get_latency(kamea_mqtt_t *kamea, kamea_priority_t priority, uint32_t *samples, size_t count);
+
+/**
+ * @brief Get the latest QoS 1 latencies, from queuing to receiving PUBACK
+ * @param kamea Client instance
+ * @param priority Publish priority
+ * @param samples Buffer used to store the latencies (microseconds)
+ * @param count Maximum number of latencies to store
+ * @return Number of latencies stored
+ */
+size_t kamea_mqtt_get_ack_latency(kamea_mqtt_t *kamea, kamea_priority_t priority, uint32_t *samples, size_t count);
+
+/**
+ * @brief Get the latest received messages dispatch times, from the PUBLISH event to the acknowledgement
+ * @param kamea Client instance
+ * @param samples Buffer used to store the dispatch times (nanoseconds)
+ * @param count Maximum number of dispatch times to store
+ * @return Number of dispatch times stored
+ */
+size_t kamea_mqtt_get_dispatch_time(kamea_mqtt_t *kamea, uint32_t *samples, size_t count);
+
+/**
+ * @brief Get the duty cycle statistics, used to compare the batch and always-on modes
+ * @param kamea Client instance
+ * @param stats Duty cycle statistics
+ */
+void kamea_mqtt_get_duty_stats(kamea_mqtt_t *kamea, kamea_mqtt_duty_stats_t *stats);
+
+/**
+ * @brief Get the session statistics, used to compare persistent and clean sessions
+ * @param kamea Client instance
+ * @param stats Session statistics
+ */
+void kamea_mqtt_get_session_stats(kamea_mqtt_t *kamea, kamea_mqtt_session_stats_t *stats);
+
+/**
+ * @brief Get the channel statistics
+ * @param kamea Client instance
+ * @param stats Channel statistics
+ */
+void kamea_mqtt_get_stats(kamea_mqtt_t *kamea, kamea_mqtt_stats_t *stats);
+
+/**
+ * @brief Check if the client is connected, CONNACK has been received
+ * @param kamea Client instance
+ * @return true if the client is connected, false otherwise
+ */
+bool kamea_mqtt_is_connected(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Close connection with the server
+ * @note The client disconnects once the queued messages are sent, until kamea_mqtt_connect() is invoked again
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+int kamea_mqtt_disconnect(kamea_mqtt_t *kamea);
+
+#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+
+#ifdef CONFIG_KAMEA_CHANNEL_COAP
+
+/**
+ * @brief Kamea CoAP callbacks
+ */
+typedef struct {
+    void (*connected)(void);          /**< Invoked when the DTLS session with the server is established */
+    void (*disconnected)(void);       /**< Invoked when the DTLS session with the server is closed */
+    void (*published)(uint16_t, int); /**< Invoked to inform of payload published result, when acknowledged for confirmable messages */
+} kamea_coap_callbacks_t;
+
+/**
+ * @brief Kamea CoAP statistics
+ */
+typedef struct {
+    uint32_t messages;        /**< Number of messages sent, including retransmissions */
+    uint32_t bytes;           /**< Number of CoAP bytes sent, excluding DTLS, UDP and IP overhead */
+    uint32_t retransmissions; /**< Number of confirmable messages retransmitted */
+    uint32_t timeouts;        /**< Number of confirmable messages never acknowledged */
+    uint32_t connections;     /**< Number of DTLS handshakes, successful or not */
+    uint32_t handshake_ms;    /**< Duration of the latest successful DTLS handshake (milliseconds) */
+} kamea_coap_stats_t;
+
 /**
  * @brief Initialize client
  * @param client_id Client ID
@@ -52,46 +482,56 @@ typedef struct {
  * @param callbacks Kamea callbacks
  * @return 0 if the function succeeds, error code otherwise
  */
-int kamea_mqtt_init(char                   *client_id,
+int kamea_coap_init(char                   *client_id,
                     uint8_t                *public_cert,
                     uint32_t                public_cert_len,
                     uint8_t                *private_key,
                     uint32_t                private_key_len,
                     uint8_t                *ca_cert,
                     uint32_t                ca_cert_len,
-                    kamea_mqtt_callbacks_t *callbacks);
+                    kamea_coap_callbacks_t *callbacks);
 
 /**
  * @brief Open connection with the server
+ * @note The DTLS session is established by the Kamea CoAP thread. When the connection manager is not used, this indicates that the network is available.
  * @return 0 if the function succeeds, error code otherwise
  */
-int kamea_mqtt_connect(void);
+int kamea_coap_connect(void);
 
 /**
  * @brief Publish telemetry to the server
+ * @note The message is copied in the lane of its priority and sent by the Kamea CoAP thread, alerts (high priority) as confirmable messages
+ * retransmitted until acknowledged, other priorities as non-confirmable messages. The published callback gives the result.
  * @param data Telemetry data
  * @param len Length of data
- * @param qos MQTT QOS
+ * @param priority Publish priority
  * @return 0 if the function succeeds, error code otherwise
  */
-int kamea_mqtt_publish_telemetry(uint8_t *data, uint32_t len, enum mqtt_qos qos);
+int kamea_coap_publish_telemetry(uint8_t *data, uint32_t len, kamea_priority_t priority);
 
 /**
  * @brief Publish configs to the server
+ * @note The message is copied in the lane of its priority and sent by the Kamea CoAP thread as a confirmable message
  * @param data Configs data
  * @param len Length of data
- * @param qos MQTT QOS
+ * @param priority Publish priority
  * @return 0 if the function succeeds, error code otherwise
  */
-int kamea_mqtt_publish_configs(uint8_t *data, uint32_t len, enum mqtt_qos qos);
+int kamea_coap_publish_configs(uint8_t *data, uint32_t len, kamea_priority_t priority);
+
+/**
+ * @brief Get the statistics, used to compare the CoAP and MQTT channels
+ * @param stats Statistics
+ */
+void kamea_coap_get_stats(kamea_coap_stats_t *stats);
 
 /**
  * @brief Close connection with the server
  * @return 0 if the function succeeds, error code otherwise
  */
-int kamea_mqtt_disconnect(void);
+int kamea_coap_disconnect(void);
 
-#endif /* CONFIG_KAMEA_CHANNEL_MQTT */
+#endif /* CONFIG_KAMEA_CHANNEL_COAP */
 
 #ifdef __cplusplus
 }
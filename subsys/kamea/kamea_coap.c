@@ -0,0 +1,865 @@
+/**
+ * @file      kamea_coap.c
+ * @brief     Kamea CoAP channel implementation
+ *
+ * Copyright (C) Witekio
+ *
+ * This file is part of Zephyr Wind Turbine demonstration.
+ *
+ * This demonstration is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This demonstration is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with This demonstration. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(kamea_coap, CONFIG_KAMEA_LOG_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/tls_credentials.h>
+#include <zephyr/zvfs/eventfd.h>
+
+#include "app/subsys/kamea.h"
+
+/**
+ * @brief Kamea CoAP client thread stack size (bytes)
+ */
+#define KAMEA_COAP_THREAD_STACK_SIZE (8192)
+
+/**
+ * @brief Kamea CoAP client thread priority
+ */
+#define KAMEA_COAP_THREAD_PRIORITY (10)
+
+/**
+ * @brief Kamea CoAP resource path maximum length, including the device ID
+ */
+#define KAMEA_COAP_PATH_SIZE (64)
+
+/**
+ * @brief Kamea CoAP pending confirmable message, retransmitted until acknowledged
+ */
+struct kamea_coap_pending {
+    struct coap_pending pending;                                /**< CoAP pending state, pending.data is NULL if the entry is unused */
+    uint8_t             buffer[CONFIG_KAMEA_COAP_MESSAGE_SIZE]; /**< Message */
+};
+
+/**
+ * @brief Kamea CoAP queued message
+ */
+struct kamea_coap_message {
+    void       *fifo_reserved;                           /**< Reserved for FIFO use */
+    const char *resource;                                /**< Resource, relative to the device resource */
+    uint8_t     type;                                    /**< CoAP message type, COAP_TYPE_CON or COAP_TYPE_NON_CON */
+    uint16_t    len;                                     /**< Length of payload */
+    uint8_t     payload[CONFIG_KAMEA_COAP_PAYLOAD_SIZE]; /**< Payload */
+};
+
+/**
+ * @brief Kamea CoAP publish lane, one per priority
+ */
+struct kamea_coap_lane {
+    struct k_mem_slab *slab; /**< Messages slab, bounds the number of queued messages */
+    struct k_fifo     *fifo; /**< Queued messages */
+};
+
+/**
+ * @brief Kamea CoAP client thread
+ */
+static void kamea_coap_thread(void);
+
+/**
+ * @brief Queue a message in the lane of its priority, the message is sent by the Kamea CoAP thread
+ * @param resource Resource, relative to the device resource
+ * @param data Payload, copied
+ * @param len Length of payload
+ * @param type CoAP message type, COAP_TYPE_CON or COAP_TYPE_NON_CON
+ * @param priority Publish priority
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_coap_queue(const char *resource, uint8_t *data, uint32_t len, uint8_t type, kamea_priority_t priority);
+
+/**
+ * @brief Check if messages are waiting to be sent
+ * @return true if at least one message is queued, false otherwise
+ */
+static bool kamea_coap_pending(void);
+
+/**
+ * @brief Build and send the queued message with the highest priority, confirmable messages are registered as pending
+ * @note Confirmable messages stay queued while all the pending entries are used
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_coap_send_next(void);
+
+/**
+ * @brief Release all queued messages
+ */
+static void kamea_coap_drop(void);
+
+/**
+ * @brief Build a POST request
+ * @param packet CoAP packet
+ * @param buffer Buffer of CONFIG_KAMEA_COAP_MESSAGE_SIZE bytes in which the message is built
+ * @param resource Resource, relative to the device resource
+ * @param data Payload
+ * @param len Length of payload
+ * @param type CoAP message type
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_coap_build(struct coap_packet *packet, uint8_t *buffer, const char *resource, uint8_t *data, uint32_t len, uint8_t type);
+
+/**
+ * @brief Send a message, the socket lock must be held
+ * @param data Message
+ * @param len Length of message
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_coap_send(const uint8_t *data, size_t len);
+
+/**
+ * @brief Receive and handle a message from the server, acknowledging pending confirmable messages
+ */
+static void kamea_coap_receive(void);
+
+/**
+ * @brief Retransmit the expired pending confirmable messages and release the ones never acknowledged
+ * @param timeout Time until the next pending message expires (milliseconds), SYS_FOREVER_MS if none
+ * @return 0 if the function succeeds, -ETIMEDOUT if a message has never been acknowledged
+ */
+static int kamea_coap_retransmit(int *timeout);
+
+/**
+ * @brief Release all pending confirmable messages
+ * @param result Result given to the published callback
+ */
+static void kamea_coap_flush(int result);
+
+/**
+ * @brief Client ID
+ */
+static char kamea_client_id[32];
+
+/**
+ * @brief Server address
+ */
+static struct sockaddr_storage kamea_coap_server;
+
+/**
+ * @brief DTLS socket, -1 if not connected
+ */
+static int kamea_coap_socket = -1;
+
+/**
+ * @brief Socket lock, protects the socket, the pending messages, the Tx buffer and the statistics
+ */
+static K_MUTEX_DEFINE(kamea_coap_lock);
+
+/**
+ * @brief Tx buffer, used by the Kamea CoAP thread only to build non-confirmable messages
+ */
+static uint8_t kamea_coap_tx_buffer[CONFIG_KAMEA_COAP_MESSAGE_SIZE];
+
+/**
+ * @brief Rx buffer, used by the Kamea CoAP thread only
+ */
+static uint8_t kamea_coap_rx_buffer[CONFIG_KAMEA_COAP_MESSAGE_SIZE];
+
+/**
+ * @brief Pending confirmable messages
+ */
+static struct kamea_coap_pending kamea_coap_pendings[CONFIG_KAMEA_COAP_PENDING];
+
+/**
+ * @brief Queued messages slabs, one per priority
+ */
+K_MEM_SLAB_DEFINE_STATIC(kamea_coap_messages_high, sizeof(struct kamea_coap_message), CONFIG_KAMEA_COAP_QUEUE_HIGH_SIZE, sizeof(void *));
+K_MEM_SLAB_DEFINE_STATIC(kamea_coap_messages_normal, sizeof(struct kamea_coap_message), CONFIG_KAMEA_COAP_QUEUE_NORMAL_SIZE, sizeof(void *));
+K_MEM_SLAB_DEFINE_STATIC(kamea_coap_messages_low, sizeof(struct kamea_coap_message), CONFIG_KAMEA_COAP_QUEUE_LOW_SIZE, sizeof(void *));
+
+/**
+ * @brief Queued messages FIFOs, one per priority
+ */
+static K_FIFO_DEFINE(kamea_coap_fifo_high);
+static K_FIFO_DEFINE(kamea_coap_fifo_normal);
+static K_FIFO_DEFINE(kamea_coap_fifo_low);
+
+/**
+ * @brief Publish lanes
+ */
+static struct kamea_coap_lane kamea_coap_lanes[KAMEA_PRIORITY_COUNT] = {
+    [KAMEA_PRIORITY_HIGH]   = { .slab = &kamea_coap_messages_high, .fifo = &kamea_coap_fifo_high },
+    [KAMEA_PRIORITY_NORMAL] = { .slab = &kamea_coap_messages_normal, .fifo = &kamea_coap_fifo_normal },
+    [KAMEA_PRIORITY_LOW]    = { .slab = &kamea_coap_messages_low, .fifo = &kamea_coap_fifo_low },
+};
+
+/**
+ * @brief Statistics
+ */
+static kamea_coap_stats_t kamea_coap_stats;
+
+/**
+ * @brief Network connected flag
+ */
+volatile static bool kamea_coap_network_connected = false;
+
+/**
+ * @brief Kamea CoAP callbacks
+ */
+static kamea_coap_callbacks_t kamea_callbacks;
+
+/**
+ * @brief Event used to wake up the Kamea CoAP thread when a message is queued or on disconnection request
+ */
+static int kamea_coap_eventfd = -1;
+
+#ifdef KAMEA_TLS_CIPHERSUITES
+
+/**
+ * @brief DTLS cipher suites of the selected profile
+ */
+static const int kamea_coap_ciphersuites[] = KAMEA_TLS_CIPHERSUITES;
+
+#endif /* KAMEA_TLS_CIPHERSUITES */
+
+#ifdef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+
+/**
+ * @brief Connection manager event handler
+ * @param mgmt_event Event type
+ * @param iface Network interface
+ * @param info A valid pointer on a data understood by the handler
+ * @param info_length Length in bytes of the memory pointed by @p info
+ * @param user_data User data
+ */
+static void kamea_coap_l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *info, size_t info_length, void *user_data);
+
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+
+int
+kamea_coap_init(char                   *client_id,
+                uint8_t                *public_cert,
+                uint32_t                public_cert_len,
+                uint8_t                *private_key,
+                uint32_t                private_key_len,
+                uint8_t                *ca_cert,
+                uint32_t                ca_cert_len,
+                kamea_coap_callbacks_t *callbacks) {
+
+    assert(NULL != client_id);
+    assert(NULL != public_cert);
+    assert(NULL != private_key);
+    assert(NULL != ca_cert);
+    assert(NULL != callbacks);
+    int result;
+
+    /* Copy client ID */
+    strncpy(kamea_client_id, client_id, sizeof(kamea_client_id));
+    kamea_client_id[sizeof(kamea_client_id) - 1] = '\0';
+
+    /* Register device certificate */
+    if (0
+        != (result = tls_credential_add(
+                CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, TLS_CREDENTIAL_PUBLIC_CERTIFICATE, public_cert, public_cert_len))) {
+        LOG_ERR("Unable to register device certificate, result = %d", result);
+        goto END;
+    }
+
+    /* Register device private key */
+    if (0
+        != (result
+            = tls_credential_add(CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, TLS_CREDENTIAL_PRIVATE_KEY, private_key, private_key_len))) {
+        LOG_ERR("Unable to register device private key, result = %d", result);
+        goto END;
+    }
+
+    /* Register server CA certificate */
+    if (0 != (result = tls_credential_add(CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, ca_cert, ca_cert_len))) {
+        LOG_ERR("Unable to register server CA certificate, result = %d", result);
+        goto END;
+    }
+
+    /* Save callbacks */
+    memcpy(&kamea_callbacks, callbacks, sizeof(kamea_coap_callbacks_t));
+
+END:
+
+    return result;
+}
+
+int
+kamea_coap_connect(void) {
+
+#ifndef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+    /* The network is managed by the application */
+    kamea_coap_network_connected = true;
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+
+    return 0;
+}
+
+int
+kamea_coap_publish_telemetry(uint8_t *data, uint32_t len, kamea_priority_t priority) {
+
+    /* Alerts are confirmable, periodic telemetry and bulk data can be lost */
+    return kamea_coap_queue("telemetries", data, len, (KAMEA_PRIORITY_HIGH == priority) ? COAP_TYPE_CON : COAP_TYPE_NON_CON, priority);
+}
+
+int
+kamea_coap_publish_configs(uint8_t *data, uint32_t len, kamea_priority_t priority) {
+
+    /* Reported configs are published on changes only and must not be lost */
+    return kamea_coap_queue("configs/reported", data, len, COAP_TYPE_CON, priority);
+}
+
+void
+kamea_coap_get_stats(kamea_coap_stats_t *stats) {
+
+    assert(NULL != stats);
+
+    /* Copy statistics */
+    k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+    memcpy(stats, &kamea_coap_stats, sizeof(kamea_coap_stats_t));
+    k_mutex_unlock(&kamea_coap_lock);
+}
+
+int
+kamea_coap_disconnect(void) {
+
+    /* Indicate the network is not available anymore and wake up the thread */
+    kamea_coap_network_connected = false;
+    if (kamea_coap_eventfd >= 0) {
+        zvfs_eventfd_write(kamea_coap_eventfd, 1);
+    }
+
+    return 0;
+}
+
+static void
+kamea_coap_thread(void) {
+
+    int                    result;
+    struct zsock_addrinfo  hints;
+    struct zsock_addrinfo *addr = NULL;
+    char                   port[6];
+    struct pollfd          fds[2];
+    zvfs_eventfd_t         value;
+    int64_t                start;
+    uint32_t               handshake_ms;
+    int                    ciphersuite;
+    socklen_t              len = sizeof(ciphersuite);
+    int                    timeout;
+    int                    verify = TLS_PEER_VERIFY_REQUIRED;
+    static const sec_tag_t sec_tag_list[]
+        = { CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG };
+
+    /* Wait until the network is connected */
+    while (false == kamea_coap_network_connected) {
+        /* Wait before trying again */
+        k_sleep(K_SECONDS(CONFIG_KAMEA_COAP_RECONNECT_INTERVAL));
+    }
+    LOG_INF("Trying to resolve Kamea CoAP server address...");
+
+    /* Set hints */
+    memset(&hints, 0, sizeof(hints));
+    if (IS_ENABLED(CONFIG_NET_IPV6)) {
+        hints.ai_family = AF_INET6;
+    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
+        hints.ai_family = AF_INET;
+    }
+    hints.ai_socktype = SOCK_DGRAM;
+
+    /* Perform DNS resolution of the host */
+    snprintf(port, sizeof(port), "%d", CONFIG_KAMEA_CHANNEL_COAP_PORT);
+    while (0 != (result = zsock_getaddrinfo(CONFIG_KAMEA_CHANNEL_COAP_URL, port, &hints, &addr))) {
+        LOG_ERR("Unable to resolve host name '%s:%d', result = %d, errno = %d", CONFIG_KAMEA_CHANNEL_COAP_URL, CONFIG_KAMEA_CHANNEL_COAP_PORT, result, errno);
+        /* Wait before trying again */
+        k_sleep(K_SECONDS(CONFIG_KAMEA_COAP_RECONNECT_INTERVAL));
+    }
+    LOG_INF("Resolved Kamea CoAP server address");
+
+    /* CoAP server configuration */
+    if (IS_ENABLED(CONFIG_NET_IPV6)) {
+        struct sockaddr_in6 *server6 = (struct sockaddr_in6 *)&kamea_coap_server;
+        server6->sin6_family         = AF_INET6;
+        server6->sin6_port           = htons(CONFIG_KAMEA_CHANNEL_COAP_PORT);
+        net_ipaddr_copy(&server6->sin6_addr, &net_sin6(addr->ai_addr)->sin6_addr);
+    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
+        struct sockaddr_in *server4 = (struct sockaddr_in *)&kamea_coap_server;
+        server4->sin_family         = AF_INET;
+        server4->sin_port           = htons(CONFIG_KAMEA_CHANNEL_COAP_PORT);
+        net_ipaddr_copy(&server4->sin_addr, &net_sin(addr->ai_addr)->sin_addr);
+    }
+
+    /* Release memory */
+    zsock_freeaddrinfo(addr);
+
+    /* Create event used to wake up the thread when a message is queued */
+    if ((kamea_coap_eventfd = zvfs_eventfd(0, ZVFS_EFD_NONBLOCK)) < 0) {
+        LOG_ERR("Unable to create publish event, errno = %d", errno);
+        return;
+    }
+
+    /* Infinite loop */
+    while (1) {
+
+        /* Wait until the network is connected */
+        while (false == kamea_coap_network_connected) {
+            k_sleep(K_SECONDS(CONFIG_KAMEA_COAP_RECONNECT_INTERVAL));
+        }
+        LOG_INF("Initializing Kamea CoAP client...");
+
+        /* Create DTLS socket */
+        if ((fds[0].fd = zsock_socket(kamea_coap_server.ss_family, SOCK_DGRAM, IPPROTO_DTLS_1_2)) < 0) {
+            LOG_ERR("Unable to create DTLS socket, errno = %d", errno);
+            goto END;
+        }
+
+        /* DTLS configuration */
+        if ((zsock_setsockopt(fds[0].fd, SOL_TLS, TLS_SEC_TAG_LIST, sec_tag_list, sizeof(sec_tag_list)) < 0)
+            || (zsock_setsockopt(fds[0].fd, SOL_TLS, TLS_HOSTNAME, CONFIG_KAMEA_CHANNEL_COAP_URL, strlen(CONFIG_KAMEA_CHANNEL_COAP_URL)) < 0)
+            || (zsock_setsockopt(fds[0].fd, SOL_TLS, TLS_PEER_VERIFY, &verify, sizeof(verify)) < 0)) {
+            LOG_ERR("Unable to configure DTLS socket, errno = %d", errno);
+            goto END;
+        }
+#ifdef KAMEA_TLS_CIPHERSUITES
+        /* Offer only the cipher suites of the selected profile */
+        if (zsock_setsockopt(fds[0].fd, SOL_TLS, TLS_CIPHERSUITE_LIST, kamea_coap_ciphersuites, sizeof(kamea_coap_ciphersuites)) < 0) {
+            LOG_ERR("Unable to configure DTLS cipher suites, errno = %d", errno);
+            goto END;
+        }
+#endif /* KAMEA_TLS_CIPHERSUITES */
+
+        /* Connect to CoAP server, the DTLS handshake is performed here and timed as the reconnect latency */
+        start = k_uptime_get();
+        k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+        kamea_coap_stats.connections++;
+        k_mutex_unlock(&kamea_coap_lock);
+        if (zsock_connect(fds[0].fd, (struct sockaddr *)&kamea_coap_server, sizeof(kamea_coap_server)) < 0) {
+            LOG_ERR("Unable to connect to the CoAP server '%s:%d', errno = %d", CONFIG_KAMEA_CHANNEL_COAP_URL, CONFIG_KAMEA_CHANNEL_COAP_PORT, errno);
+            goto END;
+        }
+        handshake_ms = (uint32_t)(k_uptime_get() - start);
+        if (zsock_getsockopt(fds[0].fd, SOL_TLS, TLS_CIPHERSUITE_USED, &ciphersuite, &len) < 0) {
+            ciphersuite = 0;
+        }
+        k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+        kamea_coap_stats.handshake_ms = handshake_ms;
+        kamea_coap_socket             = fds[0].fd;
+        k_mutex_unlock(&kamea_coap_lock);
+        LOG_INF("Kamea client connected to CoAP server, DTLS handshake %u ms, cipher suite 0x%04x", handshake_ms, ciphersuite);
+
+        /* Client connected */
+        if (NULL != kamea_callbacks.connected) {
+            kamea_callbacks.connected();
+        }
+
+        /* Prepare file descriptors */
+        fds[0].events = POLLIN;
+        fds[1].fd     = kamea_coap_eventfd;
+        fds[1].events = POLLIN;
+
+        /* Loop while the network is connected, queued messages are sent one per iteration, acknowledgements are received and confirmable messages
+         * retransmitted */
+        while (true == kamea_coap_network_connected) {
+            if (0 != kamea_coap_retransmit(&timeout)) {
+                LOG_WRN("Confirmable message not acknowledged, the DTLS session may be lost");
+                goto END;
+            }
+            if (true == kamea_coap_pending()) {
+                if (-EAGAIN != kamea_coap_send_next()) {
+                    timeout = 0;
+                }
+            }
+            if (poll(fds, 2, timeout) < 0) {
+                goto END;
+            }
+            if (0 != (fds[1].revents & POLLIN)) {
+                zvfs_eventfd_read(kamea_coap_eventfd, &value);
+            }
+            if (0 != (fds[0].revents & (POLLERR | POLLHUP))) {
+                goto END;
+            }
+            if (0 != (fds[0].revents & POLLIN)) {
+                kamea_coap_receive();
+            }
+        }
+
+    END:
+        /* Close socket and release pending messages */
+        k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+        kamea_coap_socket = -1;
+        k_mutex_unlock(&kamea_coap_lock);
+        if (fds[0].fd >= 0) {
+            zsock_close(fds[0].fd);
+        }
+        kamea_coap_flush(-ENOTCONN);
+        kamea_coap_drop();
+
+        /* Client disconnected */
+        if (NULL != kamea_callbacks.disconnected) {
+            kamea_callbacks.disconnected();
+        }
+        LOG_ERR("Kamea client disconnected, waiting before trying to connect again to the server");
+
+        /* Wait before trying again */
+        k_sleep(K_SECONDS(CONFIG_KAMEA_COAP_RECONNECT_INTERVAL));
+    }
+}
+
+static int
+kamea_coap_queue(const char *resource, uint8_t *data, uint32_t len, uint8_t type, kamea_priority_t priority) {
+
+    assert(priority < KAMEA_PRIORITY_COUNT);
+    struct kamea_coap_lane    *lane = &kamea_coap_lanes[priority];
+    struct kamea_coap_message *message;
+
+    /* Check if the DTLS session is established */
+    if (kamea_coap_socket < 0) {
+        return -ENOTCONN;
+    }
+
+    /* Check payload length */
+    if (len > CONFIG_KAMEA_COAP_PAYLOAD_SIZE) {
+        LOG_ERR("Unable to publish data, payload is too large (%u bytes)", len);
+        return -EMSGSIZE;
+    }
+
+    /* Allocate message, never wait so that the calling thread is not blocked by a stalled uplink */
+    if (0 != k_mem_slab_alloc(lane->slab, (void **)&message, K_NO_WAIT)) {
+        LOG_DBG("Unable to publish data, priority %d queue is full", priority);
+        return -ENOBUFS;
+    }
+    message->resource = resource;
+    message->type     = type;
+    message->len      = len;
+    memcpy(message->payload, data, len);
+
+    /* Queue message and wake up the Kamea CoAP thread */
+    k_fifo_put(lane->fifo, message);
+    zvfs_eventfd_write(kamea_coap_eventfd, 1);
+
+    return 0;
+}
+
+static bool
+kamea_coap_pending(void) {
+
+    /* Check all lanes */
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        if (!k_fifo_is_empty(kamea_coap_lanes[priority].fifo)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int
+kamea_coap_send_next(void) {
+
+    struct kamea_coap_lane    *lane    = NULL;
+    struct kamea_coap_message *message = NULL;
+    struct kamea_coap_pending *entry   = NULL;
+    uint8_t                   *buffer  = kamea_coap_tx_buffer;
+    struct coap_packet         packet;
+    uint16_t                   id = 0;
+    int                        result;
+
+    /* Retrieve the message with the highest priority, bulk messages are sent only if no other message is pending */
+    for (int priority = 0; (priority < KAMEA_PRIORITY_COUNT) && (NULL == message); priority++) {
+        lane    = &kamea_coap_lanes[priority];
+        message = k_fifo_peek_head(lane->fifo);
+    }
+    if (NULL == message) {
+        return 0;
+    }
+
+    k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+
+    /* Confirmable messages are built in a pending entry to be retransmitted until acknowledged, they stay queued until an entry is released */
+    if (COAP_TYPE_CON == message->type) {
+        for (size_t index = 0; index < CONFIG_KAMEA_COAP_PENDING; index++) {
+            if (NULL == kamea_coap_pendings[index].pending.data) {
+                entry  = &kamea_coap_pendings[index];
+                buffer = entry->buffer;
+                break;
+            }
+        }
+        if (NULL == entry) {
+            k_mutex_unlock(&kamea_coap_lock);
+            return -EAGAIN;
+        }
+    }
+    k_fifo_get(lane->fifo, K_NO_WAIT);
+
+    /* Build message */
+    if (0 != (result = kamea_coap_build(&packet, buffer, message->resource, message->payload, message->len, message->type))) {
+        LOG_ERR("Unable to build CoAP message, result = %d", result);
+        goto END;
+    }
+    id = coap_header_get_id(&packet);
+
+    /* Register pending confirmable message, the first cycle computes the initial acknowledgement timeout */
+    if (NULL != entry) {
+        if (0 != (result = coap_pending_init(&entry->pending, &packet, (struct sockaddr *)&kamea_coap_server, NULL))) {
+            goto END;
+        }
+        coap_pending_cycle(&entry->pending);
+    }
+
+    /* Send message */
+    if ((0 != (result = kamea_coap_send(packet.data, packet.offset))) && (NULL != entry)) {
+        coap_pending_clear(&entry->pending);
+    }
+
+END:
+
+    k_mutex_unlock(&kamea_coap_lock);
+
+    /* Release message */
+    k_mem_slab_free(lane->slab, message);
+
+    /* Non-confirmable messages are published as soon as they are sent, confirmable messages when acknowledged */
+    if (((NULL == entry) || (0 != result)) && (NULL != kamea_callbacks.published)) {
+        kamea_callbacks.published(id, result);
+    }
+
+    return result;
+}
+
+static void
+kamea_coap_drop(void) {
+
+    struct kamea_coap_message *message;
+
+    /* Release queued messages, they are not sent on the next DTLS session */
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        while (NULL != (message = k_fifo_get(kamea_coap_lanes[priority].fifo, K_NO_WAIT))) {
+            k_mem_slab_free(kamea_coap_lanes[priority].slab, message);
+        }
+    }
+}
+
+static int
+kamea_coap_build(struct coap_packet *packet, uint8_t *buffer, const char *resource, uint8_t *data, uint32_t len, uint8_t type) {
+
+    char  path[KAMEA_COAP_PATH_SIZE];
+    char *segment, *next;
+    int   result;
+
+    /* Initialize POST request, the token is empty as responses are matched with the message ID */
+    if (0 != (result = coap_packet_init(packet, buffer, CONFIG_KAMEA_COAP_MESSAGE_SIZE, COAP_VERSION_1, type, 0, NULL, COAP_METHOD_POST, coap_next_id()))) {
+        return result;
+    }
+
+    /* Append one Uri-Path option per segment of the resource path */
+    if (snprintf(path, sizeof(path), "device/%s/%s", kamea_client_id, resource) >= (int)sizeof(path)) {
+        return -ENAMETOOLONG;
+    }
+    for (segment = path; NULL != segment; segment = next) {
+        if (NULL != (next = strchr(segment, '/'))) {
+            *next++ = '\0';
+        }
+        if (0 != (result = coap_packet_append_option(packet, COAP_OPTION_URI_PATH, (uint8_t *)segment, strlen(segment)))) {
+            return result;
+        }
+    }
+
+    /* Append content format */
+    if (0 != (result = coap_append_option_int(packet, COAP_OPTION_CONTENT_FORMAT, COAP_CONTENT_FORMAT_APP_JSON))) {
+        return result;
+    }
+
+    /* Append payload */
+    if (0 != (result = coap_packet_append_payload_marker(packet))) {
+        return result;
+    }
+
+    return coap_packet_append_payload(packet, data, len);
+}
+
+static int
+kamea_coap_send(const uint8_t *data, size_t len) {
+
+    /* Send datagram */
+    if (zsock_send(kamea_coap_socket, data, len, 0) < 0) {
+        return -errno;
+    }
+
+    /* Update statistics */
+    kamea_coap_stats.messages++;
+    kamea_coap_stats.bytes += len;
+
+    return 0;
+}
+
+static void
+kamea_coap_receive(void) {
+
+    struct coap_packet   packet;
+    struct coap_pending *pending;
+    ssize_t              len;
+    uint8_t              type;
+    uint16_t             id;
+    bool                 acknowledged = false;
+    int                  result       = 0;
+
+    k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+
+    /* Read datagram */
+    if ((len = zsock_recv(kamea_coap_socket, kamea_coap_rx_buffer, sizeof(kamea_coap_rx_buffer), ZSOCK_MSG_DONTWAIT)) <= 0) {
+        goto END;
+    }
+    if (0 != coap_packet_parse(&packet, kamea_coap_rx_buffer, len, NULL, 0)) {
+        LOG_WRN("Invalid CoAP message received");
+        goto END;
+    }
+
+    /* Acknowledgements and resets release the matching pending confirmable message */
+    type = coap_header_get_type(&packet);
+    if ((COAP_TYPE_ACK != type) && (COAP_TYPE_RESET != type)) {
+        LOG_DBG("Ignoring CoAP request from the server");
+        goto END;
+    }
+    for (size_t index = 0; index < CONFIG_KAMEA_COAP_PENDING; index++) {
+        pending = &kamea_coap_pendings[index].pending;
+        if ((NULL != pending->data) && (pending->id == coap_header_get_id(&packet))) {
+            id           = pending->id;
+            result       = (COAP_TYPE_RESET == type) ? -ECONNRESET : 0;
+            acknowledged = true;
+            coap_pending_clear(pending);
+            break;
+        }
+    }
+
+END:
+
+    k_mutex_unlock(&kamea_coap_lock);
+
+    /* Confirmable message published */
+    if ((true == acknowledged) && (NULL != kamea_callbacks.published)) {
+        kamea_callbacks.published(id, result);
+    }
+}
+
+static int
+kamea_coap_retransmit(int *timeout) {
+
+    struct coap_pending *pending;
+    uint16_t             expired[CONFIG_KAMEA_COAP_PENDING];
+    size_t               count = 0;
+    int64_t              now   = k_uptime_get();
+    int64_t              left;
+
+    *timeout = SYS_FOREVER_MS;
+
+    k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+
+    for (size_t index = 0; index < CONFIG_KAMEA_COAP_PENDING; index++) {
+        pending = &kamea_coap_pendings[index].pending;
+        if (NULL == pending->data) {
+            continue;
+        }
+
+        /* Retransmit expired message with exponential back-off, release it when all retransmissions are done */
+        if (now >= pending->t0 + pending->timeout) {
+            if (false == coap_pending_cycle(pending)) {
+                expired[count++] = pending->id;
+                kamea_coap_stats.timeouts++;
+                coap_pending_clear(pending);
+                continue;
+            }
+            kamea_coap_stats.retransmissions++;
+            kamea_coap_send(pending->data, pending->len);
+        }
+
+        /* Compute time until the next expiration */
+        left = pending->t0 + pending->timeout - now;
+        if ((SYS_FOREVER_MS == *timeout) || (left < *timeout)) {
+            *timeout = (int)MAX(left, 0);
+        }
+    }
+
+    k_mutex_unlock(&kamea_coap_lock);
+
+    /* Confirmable messages not published */
+    for (size_t index = 0; (index < count) && (NULL != kamea_callbacks.published); index++) {
+        kamea_callbacks.published(expired[index], -ETIMEDOUT);
+    }
+
+    return (0 == count) ? 0 : -ETIMEDOUT;
+}
+
+static void
+kamea_coap_flush(int result) {
+
+    struct coap_pending *pending;
+    uint16_t             released[CONFIG_KAMEA_COAP_PENDING];
+    size_t               count = 0;
+
+    /* Release pending messages */
+    k_mutex_lock(&kamea_coap_lock, K_FOREVER);
+    for (size_t index = 0; index < CONFIG_KAMEA_COAP_PENDING; index++) {
+        pending = &kamea_coap_pendings[index].pending;
+        if (NULL != pending->data) {
+            released[count++] = pending->id;
+            coap_pending_clear(pending);
+        }
+    }
+    k_mutex_unlock(&kamea_coap_lock);
+
+    /* Confirmable messages not published */
+    for (size_t index = 0; (index < count) && (NULL != kamea_callbacks.published); index++) {
+        kamea_callbacks.published(released[index], result);
+    }
+}
+
+#ifdef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+
+static void
+kamea_coap_l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *info, size_t info_length, void *user_data) {
+
+    ARG_UNUSED(iface);
+    ARG_UNUSED(info);
+    ARG_UNUSED(info_length);
+    ARG_UNUSED(user_data);
+
+    if (NET_EVENT_L4_CONNECTED == mgmt_event) {
+        /* Indicate the network is available */
+        LOG_INF("Network is connected");
+        kamea_coap_network_connected = true;
+    } else if (NET_EVENT_L4_DISCONNECTED == mgmt_event) {
+        LOG_WRN("Network is disconnected");
+        kamea_coap_network_connected = false;
+        if (kamea_coap_eventfd >= 0) {
+            zvfs_eventfd_write(kamea_coap_eventfd, 1);
+        }
+    }
+}
+
+/**
+ * Register connection manager handler
+ */
+NET_MGMT_REGISTER_EVENT_HANDLER(kamea_coap_init_event_handler, NET_EVENT_L4_CONNECTED | NET_EVENT_L4_DISCONNECTED, &kamea_coap_l4_event_handler, NULL);
+
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+
+/**
+ * @brief Create Kamea CoAP client thread
+ */
+K_THREAD_DEFINE(kamea_coap_thread_id, KAMEA_COAP_THREAD_STACK_SIZE, kamea_coap_thread, NULL, NULL, NULL, KAMEA_COAP_THREAD_PRIORITY, 0, 0);
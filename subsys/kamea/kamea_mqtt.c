@@ -30,7 +30,15 @@ LOG_MODULE_REGISTER(kamea_mqtt, CONFIG_KAMEA_LOG_LEVEL);
 #include <zephyr/kernel.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/net/mqtt.h>
-#include <zephyr/random/random.h>
+#ifdef CONFIG_KAMEA_MQTT_SHELL
+#include <zephyr/shell/shell.h>
+#endif /* CONFIG_KAMEA_MQTT_SHELL */
+#include <zephyr/sys/byteorder.h>
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/crc.h>
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+#include <zephyr/zvfs/eventfd.h>
 
 #include "app/subsys/kamea.h"
 
@@ -45,41 +53,112 @@ LOG_MODULE_REGISTER(kamea_mqtt, CONFIG_KAMEA_LOG_LEVEL);
 #define KAMEA_MQTT_THREAD_PRIORITY (10)
 
 /**
- * @brief MQTT client instance
+ * @brief Maximum time waiting for CONNACK once connected to the broker (milliseconds)
  */
-static struct mqtt_client kamea_mqtt_client;
+#define KAMEA_MQTT_CONNACK_TIMEOUT (10000)
 
 /**
- * @brief MQTT client ID
+ * @brief Maximum length of the topics of the published messages
  */
-static char kamea_client_id[32];
+#define KAMEA_MQTT_TOPIC_SIZE (64)
 
 /**
- * @brief MQTT client buffers
+ * @brief Maximum size of the header of a streamed message: fixed header, topic and message ID
  */
-static uint8_t kamea_mqtt_rx_buffer[CONFIG_KAMEA_MQTT_RX_BUFFER_SIZE];
-static uint8_t kamea_mqtt_tx_buffer[CONFIG_KAMEA_MQTT_TX_BUFFER_SIZE];
+#define KAMEA_MQTT_STREAM_HEADER_SIZE (1 + 4 + 2 + KAMEA_MQTT_TOPIC_SIZE + 2)
 
 /**
- * @brief MQTT broker configuration
+ * @brief Maximum remaining length of a MQTT packet
  */
-static struct sockaddr_storage kamea_mqtt_broker;
+#define KAMEA_MQTT_REMAINING_LENGTH_MAX (268435455)
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+
+/**
+ * @brief Session record magic ("KMSS") and version
+ */
+#define KAMEA_MQTT_SESSION_MAGIC   (0x53534d4b)
+#define KAMEA_MQTT_SESSION_VERSION (1)
 
 /**
- * @brief MQTT connected flag
+ * @brief Session record header, stored at the beginning of the slot of the instance, written last
  */
-volatile static bool kamea_mqtt_connected = false;
+struct kamea_mqtt_session_header {
+    uint32_t magic;                                /**< Session record magic */
+    uint16_t version;                              /**< Session record version */
+    uint16_t count;                                /**< Number of messages */
+    char     client_id[32];                        /**< Client ID, the session is discarded if it has changed */
+    uint16_t qos2_received[KAMEA_MQTT_QOS2_COUNT]; /**< QoS 2 messages waiting for PUBREL */
+    uint32_t crc;                                  /**< CRC32 of the messages */
+} __packed;
+
+/**
+ * @brief Session record message, followed by its payload, messages are stored every sizeof(entry) + CONFIG_KAMEA_MQTT_PAYLOAD_SIZE bytes
+ */
+struct kamea_mqtt_session_entry {
+    uint16_t message_id; /**< Message ID */
+    uint8_t  priority;   /**< Publish priority */
+    uint8_t  topic;      /**< Index of the topic */
+    uint16_t len;        /**< Length of payload */
+} __packed;
+
+BUILD_ASSERT(sizeof(struct kamea_mqtt_session_header)
+                     + KAMEA_MQTT_INFLIGHT_COUNT * (sizeof(struct kamea_mqtt_session_entry) + CONFIG_KAMEA_MQTT_PAYLOAD_SIZE)
+                 <= CONFIG_KAMEA_MQTT_SESSION_STORAGE_SLOT_SIZE,
+             "Session storage slot is too small");
+
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
 
 /**
- * @brief Kamea MQTT callbacks
+ * @brief Kamea MQTT streamed publish request, allocated by the thread waiting for its completion
  */
-static kamea_mqtt_callbacks_t kamea_callbacks;
+struct kamea_mqtt_stream_request {
+    const kamea_mqtt_stream_t *stream;  /**< Streamed payload */
+    struct kamea_mqtt_message *message; /**< Queued message, detached on timeout */
+    struct k_sem               done;    /**< Given when the message is sent or dropped */
+    int                        result;  /**< Publish result */
+};
 
 /**
- * @brief Thread used to connect and handle data with Kamea server
+ * @brief Thread used to connect and handle data with Kamea servers, serves all the client instances
  */
 static void kamea_mqtt_thread(void);
 
+/**
+ * @brief Update the connection of a client instance before polling: connect, check CONNACK timeout, send subscriptions or disconnect
+ * @param kamea Client instance
+ * @param timeout Poll timeout (milliseconds), lowered to the next deadline of the instance
+ */
+static void kamea_mqtt_update(kamea_mqtt_t *kamea, int *timeout);
+
+/**
+ * @brief Handle the events polled on the socket of a client instance
+ * @param kamea Client instance
+ * @param revents Events polled
+ */
+static void kamea_mqtt_process(kamea_mqtt_t *kamea, short revents);
+
+/**
+ * @brief Resolve broker address
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_resolve(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Connect to the broker, CONNACK is received later by the Kamea MQTT thread
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_open(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Close connection and release queued messages
+ * @param kamea Client instance
+ * @param graceful The connection has been closed on purpose, a new connection can be established immediately
+ */
+static void kamea_mqtt_close(kamea_mqtt_t *kamea, bool graceful);
+
 /**
  * @brief MQTT event handler
  * @param client MQTT client instance
@@ -87,13 +166,310 @@ static void kamea_mqtt_thread(void);
  */
 static void kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt *evt);
 
-#ifdef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+/**
+ * @brief Queue a message to be published by the Kamea MQTT thread
+ * @param kamea Client instance
+ * @param topic Topic, relative to the device topic
+ * @param data Payload, copied in the message, NULL if the payload is streamed
+ * @param len Length of payload
+ * @param request Streamed payload request, NULL if the payload is copied
+ * @param qos MQTT QOS
+ * @param priority Publish priority
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_queue(kamea_mqtt_t                     *kamea,
+                            const char                       *topic,
+                            uint8_t                          *data,
+                            uint32_t                          len,
+                            struct kamea_mqtt_stream_request *request,
+                            enum mqtt_qos                     qos,
+                            kamea_priority_t                  priority);
+
+/**
+ * @brief Check if messages are waiting to be published
+ * @param kamea Client instance
+ * @return true if at least one message is queued, false otherwise
+ */
+static bool kamea_mqtt_pending(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Check if a message can be published now, queued QoS 1 messages may have to wait for the in-flight table
+ * @param kamea Client instance
+ * @return true if a message or a chunk of the streamed message can be written, false otherwise
+ */
+static bool kamea_mqtt_sendable(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Retrieve the queued message with the highest priority which can be published, without removing it from its lane
+ * @param kamea Client instance
+ * @param lane Lane of the message
+ * @return Message, NULL if no message can be published
+ */
+static struct kamea_mqtt_message *kamea_mqtt_next_message(kamea_mqtt_t *kamea, struct kamea_mqtt_lane **lane);
+
+/**
+ * @brief Allocate a message ID, never 0 and not used by a message waiting for PUBACK
+ * @param kamea Client instance
+ * @return Message ID
+ */
+static uint16_t kamea_mqtt_next_message_id(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Publish the queued message with the highest priority, or the next chunk of the streamed message being written
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_send_next(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Record a message once it is published, track it until PUBACK, then complete and release it
+ * @param kamea Client instance
+ * @param lane Lane the message has been allocated from
+ * @param message Message
+ * @param result Publish result
+ */
+static void kamea_mqtt_sent(kamea_mqtt_t *kamea, struct kamea_mqtt_lane *lane, struct kamea_mqtt_message *message, int result);
+
+/**
+ * @brief Publish a message
+ * @param kamea Client instance
+ * @param message Message
+ * @param dup The message is sent again after reconnecting
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_publish(kamea_mqtt_t *kamea, struct kamea_mqtt_message *message, bool dup);
+
+/**
+ * @brief Write the header of a streamed message directly to the socket, the payload is written by kamea_mqtt_send_stream_chunk()
+ * @param kamea Client instance
+ * @param topic Topic
+ * @param message Message
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_send_stream_header(kamea_mqtt_t *kamea, const char *topic, struct kamea_mqtt_message *message);
+
+/**
+ * @brief Write the next chunk of the streamed message being written directly to the socket
+ * @param kamea Client instance
+ * @return 0 if the payload is complete, -EINPROGRESS if chunks remain, error code otherwise
+ */
+static int kamea_mqtt_send_stream_chunk(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Write data to the socket
+ * @param kamea Client instance
+ * @param data Data
+ * @param len Length of data
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_write(kamea_mqtt_t *kamea, const uint8_t *data, size_t len);
+
+/**
+ * @brief Complete a queued message, invoke the published callback and wake up the thread waiting for a streamed message
+ * @param kamea Client instance
+ * @param message Message
+ * @param result Publish result
+ */
+static void kamea_mqtt_complete(kamea_mqtt_t *kamea, struct kamea_mqtt_message *message, int result);
+
+/**
+ * @brief Release all queued messages, invoked when the connection is lost
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_flush(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Send the subscriptions not sent yet to the server
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_send_subscriptions(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Handle received message, the payload is read slice by slice and dispatched to the matching subscriptions
+ * @param kamea Client instance
+ * @param publish Publish parameters of the received message
+ */
+static void kamea_mqtt_receive(kamea_mqtt_t *kamea, const struct mqtt_publish_param *publish);
+
+/**
+ * @brief Retrieve the subscriptions matching a topic
+ * @param kamea Client instance
+ * @param topic Topic, relative to the device topic
+ * @param len Length of topic
+ * @return Bitmask of the matching subscriptions
+ */
+static uint32_t kamea_mqtt_route(kamea_mqtt_t *kamea, const char *topic, size_t len);
+
+/**
+ * @brief Check if a topic matches a topic filter
+ * @param filter Topic filter, supporting '+' and '#' wildcards
+ * @param topic Topic
+ * @param len Length of topic
+ * @return true if the topic matches, false otherwise
+ */
+static bool kamea_mqtt_topic_match(const char *filter, const char *topic, size_t len);
+
+/**
+ * @brief Release a QoS 2 message when PUBREL is received, and send PUBCOMP
+ * @param kamea Client instance
+ * @param message_id Message ID
+ */
+static void kamea_mqtt_release(kamea_mqtt_t *kamea, uint16_t message_id);
+
+/**
+ * @brief Update the PUBACK round-trip time when a PUBACK is received
+ * @param kamea Client instance
+ * @param message_id Message ID
+ */
+static void kamea_mqtt_update_puback_rtt(kamea_mqtt_t *kamea, uint16_t message_id);
+
+/**
+ * @brief Record the time from opening the connection to the first message received or acknowledged
+ * @param kamea Client instance
+ * @param received A message has been received, a PUBACK otherwise
+ */
+static void kamea_mqtt_record_delivery(kamea_mqtt_t *kamea, bool received);
+
+/**
+ * @brief Record the result of a publish in the channel statistics
+ * @param kamea Client instance
+ * @param result Publish result
+ * @param len Length of payload
+ */
+static void kamea_mqtt_record_publish(kamea_mqtt_t *kamea, int result, size_t len);
+
+/**
+ * @brief Add a value to a latency histogram
+ * @param histogram Histogram
+ * @param value Value (milliseconds)
+ */
+static void kamea_mqtt_histogram_add(uint32_t *histogram, uint32_t value);
+
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+
+/**
+ * @brief Send again the QoS 1 messages not acknowledged before reconnecting
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_resend(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Forget a QoS 1 message waiting for PUBACK and release it
+ * @param kamea Client instance
+ * @param inflight Message waiting for PUBACK
+ */
+static void kamea_mqtt_forget(kamea_mqtt_t *kamea, struct kamea_mqtt_inflight *inflight);
+
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+
+/**
+ * @brief Save the QoS 1 messages waiting for PUBACK and the QoS 2 messages waiting for PUBREL in the storage partition
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_session_save(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Restore the session saved in the storage partition, the messages are sent again on the first connection
+ * @param kamea Client instance
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_session_restore(kamea_mqtt_t *kamea);
+
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+
+/**
+ * @brief Request a connection to the server and wake up the Kamea MQTT thread
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_request(kamea_mqtt_t *kamea);
+
+/**
+ * @brief Wake up the Kamea MQTT thread
+ */
+static void kamea_mqtt_wake(void);
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+
+/**
+ * @brief Batch timer handler, requests a connection to flush queued messages
+ * @param timer Timer
+ */
+static void kamea_mqtt_batch_timer_handler(struct k_timer *timer);
+
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+#ifdef CONFIG_KAMEA_MQTT_STATS_TELEMETRY
+
+/**
+ * @brief Publish the channel statistics as telemetry
+ * @param kamea Client instance
+ */
+static void kamea_mqtt_publish_stats(kamea_mqtt_t *kamea);
+
+#endif /* CONFIG_KAMEA_MQTT_STATS_TELEMETRY */
+
+#ifdef CONFIG_KAMEA_MQTT_SHELL
+
+/**
+ * @brief Shell command used to display the channel statistics of all the client instances
+ * @param sh Shell
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return 0 if the function succeeds, error code otherwise
+ */
+static int kamea_mqtt_stats_cmd(const struct shell *sh, size_t argc, char **argv);
+
+/**
+ * @brief Display the non-empty buckets of a latency histogram
+ * @param sh Shell
+ * @param name Name of the histogram
+ * @param histogram Histogram
+ */
+static void kamea_mqtt_stats_print_histogram(const struct shell *sh, const char *name, const uint32_t *histogram);
+
+#endif /* CONFIG_KAMEA_MQTT_SHELL */
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+
+/**
+ * @brief Topics of the published messages, indexes are stored in the session record
+ */
+static const char *const kamea_mqtt_topics[] = { "telemetries", "configs/reported" };
+
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+
+#ifdef KAMEA_TLS_CIPHERSUITES
 
 /**
- * @brief Network status
+ * @brief TLS cipher suites of the selected profile
+ */
+static const int kamea_mqtt_ciphersuites[] = KAMEA_TLS_CIPHERSUITES;
+
+#endif /* KAMEA_TLS_CIPHERSUITES */
+
+/**
+ * @brief Client instances served by the Kamea MQTT thread, append-only
+ */
+static kamea_mqtt_t *kamea_mqtt_instances[CONFIG_KAMEA_MQTT_INSTANCES];
+static atomic_t      kamea_mqtt_instances_count = ATOMIC_INIT(0);
+static K_MUTEX_DEFINE(kamea_mqtt_instances_lock);
+
+/**
+ * @brief Network status, given by the connection manager or by kamea_mqtt_connect() otherwise, shared by all the instances
  */
 volatile static bool kamea_mqtt_network_connected = false;
 
+/**
+ * @brief Event used to wake up the Kamea MQTT thread when a message is queued or a connection is requested
+ */
+static int kamea_mqtt_eventfd = -1;
+
+#ifdef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+
 /**
  * @brief Connection manager event handler
  * @param mgmt_event Event type
@@ -107,50 +483,89 @@ static void kamea_mqtt_l4_event_handler(uint64_t mgmt_event, struct net_if *ifac
 #endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
 
 int
-kamea_mqtt_init(char                   *client_id,
-                uint8_t                *public_cert,
-                uint32_t                public_cert_len,
-                uint8_t                *private_key,
-                uint32_t                private_key_len,
-                uint8_t                *ca_cert,
-                uint32_t                ca_cert_len,
-                kamea_mqtt_callbacks_t *callbacks) {
-
-    assert(NULL != client_id);
-    assert(NULL != public_cert);
-    assert(NULL != private_key);
-    assert(NULL != ca_cert);
-    assert(NULL != callbacks);
-    int result;
-
-    /* Copy client ID */
-    strncpy(kamea_client_id, client_id, sizeof(kamea_client_id));
-    kamea_client_id[sizeof(kamea_client_id) - 1] = '\0';
-
-    /* Register device certificate */
-    if (0
-        != (result = tls_credential_add(
-                CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, TLS_CREDENTIAL_PUBLIC_CERTIFICATE, public_cert, public_cert_len))) {
-        LOG_ERR("Unable to register device certificate, result = %d", result);
-        goto END;
+kamea_mqtt_init(kamea_mqtt_t *kamea, const kamea_mqtt_config_t *config) {
+
+    assert(NULL != kamea);
+    assert(NULL != config);
+    assert(NULL != config->client_id);
+    assert(NULL != config->hostname);
+    int result = 0;
+
+    /* Copy configuration and client ID */
+    memcpy(&kamea->config, config, sizeof(kamea_mqtt_config_t));
+    strncpy(kamea->client_id, config->client_id, sizeof(kamea->client_id));
+    kamea->client_id[sizeof(kamea->client_id) - 1] = '\0';
+    kamea->device_topic_len = snprintf(kamea->device_topic, sizeof(kamea->device_topic), "device/%s/", kamea->client_id);
+    kamea->sec_tag_list[0]  = config->sec_tag;
+    kamea->sec_tag_list[1]  = config->ca_sec_tag;
+
+    /* Register credentials, several instances may share the same tags */
+    if (NULL != config->public_cert) {
+
+        /* Register device certificate */
+        if ((0 != (result = tls_credential_add(config->sec_tag, TLS_CREDENTIAL_PUBLIC_CERTIFICATE, config->public_cert, config->public_cert_len)))
+            && (-EEXIST != result)) {
+            LOG_ERR("Unable to register device certificate, result = %d", result);
+            goto END;
+        }
+
+        /* Register device private key */
+        if ((0 != (result = tls_credential_add(config->sec_tag, TLS_CREDENTIAL_PRIVATE_KEY, config->private_key, config->private_key_len)))
+            && (-EEXIST != result)) {
+            LOG_ERR("Unable to register device private key, result = %d", result);
+            goto END;
+        }
+
+        /* Register server CA certificate */
+        if ((0 != (result = tls_credential_add(config->ca_sec_tag, TLS_CREDENTIAL_CA_CERTIFICATE, config->ca_cert, config->ca_cert_len)))
+            && (-EEXIST != result)) {
+            LOG_ERR("Unable to register server CA certificate, result = %d", result);
+            goto END;
+        }
+        result = 0;
     }
 
-    /* Register device private key */
-    if (0
-        != (result
-            = tls_credential_add(CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, TLS_CREDENTIAL_PRIVATE_KEY, private_key, private_key_len))) {
-        LOG_ERR("Unable to register device private key, result = %d", result);
-        goto END;
+    /* Initialize publish lanes */
+    k_mem_slab_init(&kamea->lanes[KAMEA_PRIORITY_HIGH].slab, kamea->messages_high, sizeof(struct kamea_mqtt_message), ARRAY_SIZE(kamea->messages_high));
+    k_mem_slab_init(&kamea->lanes[KAMEA_PRIORITY_NORMAL].slab, kamea->messages_normal, sizeof(struct kamea_mqtt_message), ARRAY_SIZE(kamea->messages_normal));
+    k_mem_slab_init(&kamea->lanes[KAMEA_PRIORITY_LOW].slab, kamea->messages_low, sizeof(struct kamea_mqtt_message), ARRAY_SIZE(kamea->messages_low));
+    k_mutex_init(&kamea->stream_lock);
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        k_fifo_init(&kamea->lanes[priority].fifo);
     }
 
-    /* Register server CA certificate */
-    if (0 != (result = tls_credential_add(CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, ca_cert, ca_cert_len))) {
-        LOG_ERR("Unable to register server CA certificate, result = %d", result);
+    /* Connection is always requested in always-on mode */
+    atomic_set(&kamea->requested, IS_ENABLED(CONFIG_KAMEA_MQTT_BATCH) ? 0 : 1);
+    kamea->duty_start      = -1;
+    kamea->connected_since = -1;
+#ifdef CONFIG_KAMEA_MQTT_STATS_TELEMETRY
+    kamea->stats_deadline = k_uptime_get() + MSEC_PER_SEC * CONFIG_KAMEA_MQTT_STATS_TELEMETRY_INTERVAL;
+#endif /* CONFIG_KAMEA_MQTT_STATS_TELEMETRY */
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+    /* Start batch timer */
+    k_timer_init(&kamea->batch_timer, kamea_mqtt_batch_timer_handler, NULL);
+    k_timer_start(&kamea->batch_timer, K_SECONDS(CONFIG_KAMEA_MQTT_BATCH_INTERVAL), K_SECONDS(CONFIG_KAMEA_MQTT_BATCH_INTERVAL));
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+    /* Register instance to the Kamea MQTT thread */
+    k_mutex_lock(&kamea_mqtt_instances_lock, K_FOREVER);
+    if (atomic_get(&kamea_mqtt_instances_count) >= CONFIG_KAMEA_MQTT_INSTANCES) {
+        k_mutex_unlock(&kamea_mqtt_instances_lock);
+        LOG_ERR("Unable to register client '%s', instances table is full", kamea->client_id);
+        result = -ENOMEM;
         goto END;
     }
-
-    /* Save callbacks */
-    memcpy(&kamea_callbacks, callbacks, sizeof(kamea_mqtt_callbacks_t));
+    kamea->index       = atomic_get(&kamea_mqtt_instances_count);
+    kamea->initialized = true;
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+    /* Restore the session of the previous boot, the instance keeps the slot of its index */
+    kamea_mqtt_session_restore(kamea);
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+    kamea_mqtt_instances[kamea->index] = kamea;
+    atomic_inc(&kamea_mqtt_instances_count);
+    k_mutex_unlock(&kamea_mqtt_instances_lock);
+    kamea_mqtt_wake();
 
 END:
 
@@ -158,260 +573,592 @@ END:
 }
 
 int
-kamea_mqtt_connect(void) {
+kamea_mqtt_connect(kamea_mqtt_t *kamea) {
+
+    assert(NULL != kamea);
 
-    /* FIXME: to be completed to handle the case without CONFIG_KAMEA_USE_CONNECTION_MANAGER */
-    return -1;
+#ifndef CONFIG_KAMEA_USE_CONNECTION_MANAGER
+    /* The network is managed by the application */
+    kamea_mqtt_network_connected = true;
+#endif /* CONFIG_KAMEA_USE_CONNECTION_MANAGER */
+
+    /* Request connection, in batch mode the queued messages are flushed then the client disconnects */
+    kamea_mqtt_request(kamea);
+
+    return 0;
 }
 
 int
-kamea_mqtt_publish_telemetry(uint8_t *data, uint32_t len, enum mqtt_qos qos) {
+kamea_mqtt_publish_telemetry(kamea_mqtt_t *kamea, uint8_t *data, uint32_t len, enum mqtt_qos qos, kamea_priority_t priority) {
 
-    int                       result;
-    struct mqtt_publish_param param;
-    char                      topic[64];
+    return kamea_mqtt_queue(kamea, "telemetries", data, len, NULL, qos, priority);
+}
 
-    /* Check if client is connected */
-    if (false == kamea_mqtt_connected) {
-        LOG_DBG("Unable to publish data, client is not connected");
-        return -1;
-    }
+int
+kamea_mqtt_publish_telemetry_stream(kamea_mqtt_t *kamea, const kamea_mqtt_stream_t *stream, enum mqtt_qos qos, kamea_priority_t priority, k_timeout_t timeout) {
 
-    /* Set publish param */
-    param.message.topic.qos = qos;
-    snprintf(topic, sizeof(topic), "device/%s/telemetries", kamea_client_id);
-    param.message.topic.topic.utf8 = (uint8_t *)topic;
-    param.message.topic.topic.size = strlen(topic);
-    param.message.payload.data     = data;
-    param.message.payload.len      = len;
-    param.message_id               = sys_rand16_get();
-    param.dup_flag                 = 0U;
-    param.retain_flag              = 0U;
+    assert(NULL != stream);
+    assert(NULL != stream->next);
+    struct kamea_mqtt_stream_request request = { .stream = stream };
+    int                              result;
 
-    /* Publish data */
-    /* FIXME: the message should be passed to a queue handled by a separated thread */
-    /* FIXME: actually it blocks the calling function and cause issue if the calling function is an interrupt */
-    if (0 != (result = mqtt_publish(&kamea_mqtt_client, &param))) {
-        LOG_ERR("Unable to publish data, result = %d, errno = %d", result, errno);
-        goto END;
+    /* Queue message and wait until it is sent or dropped */
+    k_sem_init(&request.done, 0, 1);
+    if (0 != (result = kamea_mqtt_queue(kamea, "telemetries", NULL, 0, &request, qos, priority))) {
+        return result;
+    }
+    if (0 == k_sem_take(&request.done, timeout)) {
+        return request.result;
     }
 
-END:
-
-    /* Invoked published callback */
-    if (NULL != kamea_callbacks.published) {
-        kamea_callbacks.published(param.message_id, result);
+    /* Detach the request on timeout, unless the message has been completed meanwhile, the Kamea MQTT thread then drops the message */
+    k_mutex_lock(&kamea->stream_lock, K_FOREVER);
+    if (0 != k_sem_take(&request.done, K_NO_WAIT)) {
+        request.message->cancelled = true;
+        request.result             = -ETIMEDOUT;
     }
+    k_mutex_unlock(&kamea->stream_lock);
 
-    return result;
+    return request.result;
 }
 
 int
-kamea_mqtt_publish_configs(uint8_t *data, uint32_t len, enum mqtt_qos qos) {
+kamea_mqtt_publish_configs(kamea_mqtt_t *kamea, uint8_t *data, uint32_t len, enum mqtt_qos qos, kamea_priority_t priority) {
 
-    int                       result;
-    struct mqtt_publish_param param;
-    char                      topic[64];
+    return kamea_mqtt_queue(kamea, "configs/reported", data, len, NULL, qos, priority);
+}
 
-    /* Check if client is connected */
-    if (false == kamea_mqtt_connected) {
-        LOG_DBG("Unable to publish data, client is not connected");
-        return -1;
+int
+kamea_mqtt_subscribe(kamea_mqtt_t *kamea, const char *filter, enum mqtt_qos qos, kamea_mqtt_handler_t handler, void *user_data) {
+
+    assert(NULL != kamea);
+    assert(NULL != filter);
+    assert(NULL != handler);
+    struct kamea_mqtt_subscription *subscription;
+    atomic_val_t                    count;
+    k_spinlock_key_t                key;
+
+    /* Append subscription to the table */
+    key = k_spin_lock(&kamea->subscriptions_lock);
+    if ((count = atomic_get(&kamea->subscriptions_count)) >= CONFIG_KAMEA_MQTT_SUBSCRIPTIONS) {
+        k_spin_unlock(&kamea->subscriptions_lock, key);
+        LOG_ERR("Unable to subscribe to '%s', subscriptions table is full", filter);
+        return -ENOMEM;
     }
+    subscription             = &kamea->subscriptions[count];
+    subscription->filter     = filter;
+    subscription->qos        = qos;
+    subscription->handler    = handler;
+    subscription->user_data  = user_data;
+    subscription->subscribed = false;
+    atomic_set(&kamea->subscriptions_count, count + 1);
+    k_spin_unlock(&kamea->subscriptions_lock, key);
+
+    /* Wake up the Kamea MQTT thread to send the subscription, it is sent on connection otherwise */
+    atomic_set(&kamea->subscribe_pending, 1);
+    kamea_mqtt_wake();
+
+    return 0;
+}
 
-    /* Set publish param */
-    param.message.topic.qos = qos;
-    snprintf(topic, sizeof(topic), "device/%s/configs/reported", kamea_client_id);
-    param.message.topic.topic.utf8 = (uint8_t *)topic;
-    param.message.topic.topic.size = strlen(topic);
-    param.message.payload.data     = data;
-    param.message.payload.len      = len;
-    param.message_id               = sys_rand16_get();
-    param.dup_flag                 = 0U;
-    param.retain_flag              = 0U;
+uint32_t
+kamea_mqtt_get_puback_rtt(kamea_mqtt_t *kamea) {
 
-    /* Publish data */
-    /* FIXME: the message should be passed to a queue handled by a separated thread */
-    /* FIXME: actually it blocks the calling function and cause issue if the calling function is an interrupt */
-    if (0 != (result = mqtt_publish(&kamea_mqtt_client, &param))) {
-        LOG_ERR("Unable to publish data, result = %d, errno = %d", result, errno);
-        goto END;
+    assert(NULL != kamea);
+
+    /* The round-trip time is outdated if no PUBACK has been received for a while */
+    if ((k_uptime_get_32() - (uint32_t)atomic_get(&kamea->puback_time)) > MSEC_PER_SEC * CONFIG_KAMEA_MQTT_PUBACK_RTT_MAX_AGE) {
+        return 0;
     }
 
-END:
+    return (uint32_t)atomic_get(&kamea->puback_rtt);
+}
 
-    /* Invoked published callback */
-    if (NULL != kamea_callbacks.published) {
-        kamea_callbacks.published(param.message_id, result);
+size_t
+kamea_mqtt_get_latency(kamea_mqtt_t *kamea, kamea_priority_t priority, uint32_t *samples, size_t count) {
+
+    assert(NULL != kamea);
+    assert(priority < KAMEA_PRIORITY_COUNT);
+    assert(NULL != samples);
+    struct kamea_mqtt_lane *lane = &kamea->lanes[priority];
+    k_spinlock_key_t        key  = k_spin_lock(&kamea->latency_lock);
+
+    /* Copy the latest latencies, oldest first */
+    count = MIN(count, MIN(lane->latency_count, CONFIG_KAMEA_MQTT_LATENCY_SAMPLES));
+    for (size_t index = 0; index < count; index++) {
+        samples[index] = lane->latency[(lane->latency_count - count + index) % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];
     }
 
-    return result;
+    k_spin_unlock(&kamea->latency_lock, key);
+
+    return count;
 }
 
-int
-kamea_mqtt_disconnect(void) {
+size_t
+kamea_mqtt_get_ack_latency(kamea_mqtt_t *kamea, kamea_priority_t priority, uint32_t *samples, size_t count) {
+
+    assert(NULL != kamea);
+    assert(priority < KAMEA_PRIORITY_COUNT);
+    assert(NULL != samples);
+    struct kamea_mqtt_lane *lane = &kamea->lanes[priority];
+    k_spinlock_key_t        key  = k_spin_lock(&kamea->latency_lock);
+
+    /* Copy the latest latencies, oldest first */
+    count = MIN(count, MIN(lane->ack_latency_count, CONFIG_KAMEA_MQTT_LATENCY_SAMPLES));
+    for (size_t index = 0; index < count; index++) {
+        samples[index] = lane->ack_latency[(lane->ack_latency_count - count + index) % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];
+    }
 
-    /* FIXME: to be completed to handle the case without CONFIG_KAMEA_USE_CONNECTION_MANAGER */
-    return -1;
+    k_spin_unlock(&kamea->latency_lock, key);
+
+    return count;
 }
 
-static void
-kamea_mqtt_thread(void) {
+size_t
+kamea_mqtt_get_dispatch_time(kamea_mqtt_t *kamea, uint32_t *samples, size_t count) {
 
-    int                    result;
-    struct zsock_addrinfo  hints;
-    struct zsock_addrinfo *addr = NULL;
-    char                   port[6];
-    struct pollfd          fds[1];
+    assert(NULL != kamea);
+    assert(NULL != samples);
+    k_spinlock_key_t key = k_spin_lock(&kamea->latency_lock);
 
-    /* Wait until the network is connected */
-    while (false == kamea_mqtt_network_connected) {
-        /* Wait before trying again */
-        k_sleep(K_SECONDS(CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL));
+    /* Copy the latest dispatch times, oldest first */
+    count = MIN(count, MIN(kamea->dispatch_count, CONFIG_KAMEA_MQTT_LATENCY_SAMPLES));
+    for (size_t index = 0; index < count; index++) {
+        samples[index] = kamea->dispatch_time[(kamea->dispatch_count - count + index) % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES];
     }
-    LOG_INF("Trying to resolve Kamea MQTT broker address...");
 
-    /* Set hints */
-    memset(&hints, 0, sizeof(hints));
-    if (IS_ENABLED(CONFIG_NET_IPV6)) {
-        hints.ai_family = AF_INET6;
-    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
-        hints.ai_family = AF_INET;
-    }
-    hints.ai_socktype = SOCK_STREAM;
+    k_spin_unlock(&kamea->latency_lock, key);
 
-    /* Perform DNS resolution of the host */
-    snprintf(port, sizeof(port), "%d", CONFIG_KAMEA_CHANNEL_MQTT_PORT);
-    while (0 != (result = zsock_getaddrinfo(CONFIG_KAMEA_CHANNEL_MQTT_URL, port, &hints, &addr))) {
-        LOG_ERR("Unable to resolve host name '%s:%d', result = %d, errno = %d", CONFIG_KAMEA_CHANNEL_MQTT_URL, CONFIG_KAMEA_CHANNEL_MQTT_PORT, result, errno);
-        /* Wait before trying again */
-        k_sleep(K_SECONDS(CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL));
-    }
-    LOG_INF("Resolved Kamea MQTT broker address");
+    return count;
+}
 
-    /* MQTT broker configuration */
-    if (IS_ENABLED(CONFIG_NET_IPV6)) {
-        struct sockaddr_in6 *broker6 = (struct sockaddr_in6 *)&kamea_mqtt_broker;
-        broker6->sin6_family         = AF_INET6;
-        broker6->sin6_port           = htons(CONFIG_KAMEA_CHANNEL_MQTT_PORT);
-        net_ipaddr_copy(&broker6->sin6_addr, &net_sin6(addr->ai_addr)->sin6_addr);
-    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
-        struct sockaddr_in *broker4 = (struct sockaddr_in *)&kamea_mqtt_broker;
-        broker4->sin_family         = AF_INET;
-        broker4->sin_port           = htons(CONFIG_KAMEA_CHANNEL_MQTT_PORT);
-        net_ipaddr_copy(&broker4->sin_addr, &net_sin(addr->ai_addr)->sin_addr);
+void
+kamea_mqtt_get_duty_stats(kamea_mqtt_t *kamea, kamea_mqtt_duty_stats_t *stats) {
+
+    assert(NULL != kamea);
+    assert(NULL != stats);
+    k_spinlock_key_t key = k_spin_lock(&kamea->latency_lock);
+
+    /* Copy statistics, including the current connection */
+    memcpy(stats, &kamea->duty_stats, sizeof(kamea_mqtt_duty_stats_t));
+    if (kamea->duty_start >= 0) {
+        stats->connected_ms += k_uptime_get() - kamea->duty_start;
     }
 
-    /* Release memory */
-    zsock_freeaddrinfo(addr);
+    k_spin_unlock(&kamea->latency_lock, key);
+}
 
-    /* Infinite loop */
-    while (1) {
+void
+kamea_mqtt_get_session_stats(kamea_mqtt_t *kamea, kamea_mqtt_session_stats_t *stats) {
 
-        /* Wait until the network is connected */
-        while (false == kamea_mqtt_network_connected) {
-            /* Wait before trying again */
-            k_sleep(K_SECONDS(CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL));
-        }
-        LOG_INF("Initializing Kamea MQTT client...");
-
-        /* Initialize MQTT client */
-        mqtt_client_init(&kamea_mqtt_client);
-
-        /* MQTT client configuration */
-        kamea_mqtt_client.broker           = &kamea_mqtt_broker;
-        kamea_mqtt_client.evt_cb           = kamea_mqtt_event_handler;
-        kamea_mqtt_client.client_id.utf8   = (uint8_t *)kamea_client_id;
-        kamea_mqtt_client.client_id.size   = strlen(kamea_client_id);
-        kamea_mqtt_client.protocol_version = MQTT_VERSION_3_1_1;
-
-        /* MQTT buffers configuration */
-        kamea_mqtt_client.rx_buf      = kamea_mqtt_rx_buffer;
-        kamea_mqtt_client.rx_buf_size = CONFIG_KAMEA_MQTT_RX_BUFFER_SIZE;
-        kamea_mqtt_client.tx_buf      = kamea_mqtt_tx_buffer;
-        kamea_mqtt_client.tx_buf_size = CONFIG_KAMEA_MQTT_TX_BUFFER_SIZE;
-
-        /* Username and password */
-        kamea_mqtt_client.password  = NULL;
-        kamea_mqtt_client.user_name = NULL;
-
-        /* MQTT transport configuration */
-        kamea_mqtt_client.transport.type = MQTT_TRANSPORT_SECURE;
-
-        /* MQTT TLS configuration */
-        kamea_mqtt_client.transport.tls.config.peer_verify = TLS_PEER_VERIFY_REQUIRED;
-        kamea_mqtt_client.transport.tls.config.cipher_list = NULL;
-        static const sec_tag_t sec_tag_list[]
-            = { CONFIG_KAMEA_TLS_CREDENTIAL_DEVICE_KEY_AND_CERTIFICATE_TAG, CONFIG_KAMEA_TLS_CREDENTIAL_SERVER_CA_CERTIFICATE_TAG };
-        kamea_mqtt_client.transport.tls.config.sec_tag_list  = sec_tag_list;
-        kamea_mqtt_client.transport.tls.config.sec_tag_count = ARRAY_SIZE(sec_tag_list);
-        kamea_mqtt_client.transport.tls.config.hostname      = CONFIG_KAMEA_CHANNEL_MQTT_URL;
-
-        /* Connect to MQTT broker */
-        if (0 != (result = mqtt_connect(&kamea_mqtt_client))) {
-            LOG_ERR("Unable to connect to the MQTT broker '%s:%d', result = %d (%s), errno = %d",
-                    CONFIG_KAMEA_CHANNEL_MQTT_URL,
-                    CONFIG_KAMEA_CHANNEL_MQTT_PORT,
-                    result,
-                    zsock_gai_strerror(result),
-                    errno);
-            goto END;
-        }
-        if (NULL != kamea_callbacks.connected) {
-            kamea_callbacks.connected();
-        }
-        LOG_INF("Kamea client connected to MQTT broker");
+    assert(NULL != kamea);
+    assert(NULL != stats);
+    k_spinlock_key_t key = k_spin_lock(&kamea->latency_lock);
 
-        /* Prepare MQTT file descriptor */
-        if (MQTT_TRANSPORT_SECURE == kamea_mqtt_client.transport.type) {
-            fds[0].fd = kamea_mqtt_client.transport.tls.sock;
-        }
-        fds[0].events = POLLIN;
+    /* Copy statistics */
+    memcpy(stats, &kamea->session_stats, sizeof(kamea_mqtt_session_stats_t));
 
-        /* Poll file descriptor */
-        if ((result = poll(fds, 1, 10000)) < 0) {
-            goto END;
-        }
-        mqtt_input(&kamea_mqtt_client);
+    k_spin_unlock(&kamea->latency_lock, key);
+}
 
-        /* Check if connection is established */
-        if (false == kamea_mqtt_connected) {
-            goto END;
-        }
+void
+kamea_mqtt_get_stats(kamea_mqtt_t *kamea, kamea_mqtt_stats_t *stats) {
 
-        /* Loop while connection is established */
-        while ((true == kamea_mqtt_network_connected) && (true == kamea_mqtt_connected)) {
-            if ((result = poll(fds, 1, SYS_FOREVER_MS)) < 0) {
-                goto END;
-            }
-            mqtt_input(&kamea_mqtt_client);
-        }
+    assert(NULL != kamea);
+    assert(NULL != stats);
+    k_spinlock_key_t key = k_spin_lock(&kamea->latency_lock);
 
-    END:
-        /* Abort connection */
-        mqtt_abort(&kamea_mqtt_client);
+    /* Copy statistics and compute the uptime of the current connection */
+    memcpy(stats, &kamea->stats, sizeof(kamea_mqtt_stats_t));
+    stats->uptime_s = (kamea->connected_since >= 0) ? (uint32_t)((k_uptime_get() - kamea->connected_since) / MSEC_PER_SEC) : 0;
 
-        /* Client disconnected */
-        if (NULL != kamea_callbacks.disconnected) {
-            kamea_callbacks.disconnected();
-        }
-        LOG_ERR("Kamea client disconnected, waiting before trying to connect again to the broker");
+    k_spin_unlock(&kamea->latency_lock, key);
+}
 
-        /* Wait before trying again */
-        k_sleep(K_SECONDS(CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL));
-    }
+bool
+kamea_mqtt_is_connected(kamea_mqtt_t *kamea) {
+
+    assert(NULL != kamea);
+
+    return kamea->connected;
 }
 
-static void
-kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt *evt) {
+int
+kamea_mqtt_disconnect(kamea_mqtt_t *kamea) {
 
-    uint8_t                  data[33]; /* FIXME: buffer size to be checked */
-    int                      len, bytes_read;
-    struct mqtt_puback_param puback;
+    assert(NULL != kamea);
 
-    /* Treatment depending of the event */
+    /* Cancel connection request, the client disconnects once the queued messages are sent */
+    atomic_clear(&kamea->requested);
+    kamea_mqtt_wake();
+
+    return 0;
+}
+
+static void
+kamea_mqtt_thread(void) {
+
+    struct pollfd  fds[1 + CONFIG_KAMEA_MQTT_INSTANCES];
+    kamea_mqtt_t  *polled[CONFIG_KAMEA_MQTT_INSTANCES];
+    kamea_mqtt_t  *kamea;
+    zvfs_eventfd_t value;
+    int            timeout, count;
+
+    /* Create event used to wake up the thread when a message is queued or a connection is requested */
+    if ((kamea_mqtt_eventfd = zvfs_eventfd(0, ZVFS_EFD_NONBLOCK)) < 0) {
+        LOG_ERR("Unable to create publish event, errno = %d", errno);
+        return;
+    }
+    fds[0].fd     = kamea_mqtt_eventfd;
+    fds[0].events = POLLIN;
+
+    /* Infinite loop */
+    while (1) {
+
+        /* Update the connection of each instance and prepare the sockets to poll, queued messages are sent when the socket is writable */
+        timeout = SYS_FOREVER_MS;
+        count   = 0;
+        for (atomic_val_t index = 0; index < atomic_get(&kamea_mqtt_instances_count); index++) {
+            kamea = kamea_mqtt_instances[index];
+            kamea_mqtt_update(kamea, &timeout);
+            if (true == kamea->open) {
+                fds[1 + count].fd     = kamea->client.transport.tls.sock;
+                fds[1 + count].events = POLLIN | (((true == kamea->connected) && (true == kamea_mqtt_sendable(kamea))) ? POLLOUT : 0);
+                polled[count++]       = kamea;
+            }
+        }
+
+        /* Wait for socket events, a wake up event or the next deadline */
+        if (poll(fds, 1 + count, timeout) < 0) {
+            LOG_ERR("Unable to poll sockets, errno = %d", errno);
+            k_sleep(K_SECONDS(CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL));
+            continue;
+        }
+        if (0 != (fds[0].revents & POLLIN)) {
+            zvfs_eventfd_read(kamea_mqtt_eventfd, &value);
+        }
+
+        /* Handle socket events */
+        for (int index = 0; index < count; index++) {
+            kamea_mqtt_process(polled[index], fds[1 + index].revents);
+        }
+    }
+}
+
+static void
+kamea_mqtt_update(kamea_mqtt_t *kamea, int *timeout) {
+
+    int64_t now = k_uptime_get();
+    int64_t deadline;
+
+    if (false == kamea->open) {
+
+        /* Wait until the network is connected and a connection is requested */
+        if ((false == kamea_mqtt_network_connected) || (0 == atomic_get(&kamea->requested))) {
+            return;
+        }
+
+        /* Connect once the reconnect interval has elapsed, the other instances are not served until the TLS handshake is done */
+        if (now >= kamea->deadline) {
+            kamea_mqtt_open(kamea);
+            now = k_uptime_get();
+        }
+
+    } else if ((false == kamea_mqtt_network_connected) || ((false == kamea->connected) && (now >= kamea->deadline))) {
+
+        /* Close connection if the network is lost or if CONNACK is not received in time */
+        kamea_mqtt_close(kamea, false);
+        return;
+
+    } else if (true == kamea->connected) {
+
+        /* Send subscriptions registered while connected */
+        if (true == atomic_cas(&kamea->subscribe_pending, 1, 0)) {
+            kamea_mqtt_send_subscriptions(kamea);
+        }
+
+#ifdef CONFIG_KAMEA_MQTT_STATS_TELEMETRY
+        /* Publish statistics periodically, the publication is delayed to the next connection if the client is disconnected */
+        if (now >= kamea->stats_deadline) {
+            kamea_mqtt_publish_stats(kamea);
+            kamea->stats_deadline = now + MSEC_PER_SEC * CONFIG_KAMEA_MQTT_STATS_TELEMETRY_INTERVAL;
+        }
+        deadline = kamea->stats_deadline - now;
+        if ((SYS_FOREVER_MS == *timeout) || (deadline < *timeout)) {
+            *timeout = (int)deadline;
+        }
+#endif /* CONFIG_KAMEA_MQTT_STATS_TELEMETRY */
+
+        /* Disconnect once the queued messages are sent if the connection is not requested anymore, in batch mode after lingering */
+        if ((0 != atomic_get(&kamea->requested)) || (true == kamea_mqtt_pending(kamea))) {
+            return;
+        }
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+        kamea->deadline = kamea->activity + CONFIG_KAMEA_MQTT_BATCH_LINGER;
+#else
+        kamea->deadline = now;
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+        if (now >= kamea->deadline) {
+            LOG_INF("Disconnecting Kamea client '%s'", kamea->client_id);
+            mqtt_disconnect(&kamea->client, NULL);
+            kamea_mqtt_close(kamea, true);
+            return;
+        }
+    }
+
+    /* Wake up at the deadline of the instance */
+    deadline = MAX(kamea->deadline - now, 0);
+    if ((SYS_FOREVER_MS == *timeout) || (deadline < *timeout)) {
+        *timeout = (int)deadline;
+    }
+}
+
+static void
+kamea_mqtt_process(kamea_mqtt_t *kamea, short revents) {
+
+    bool connected = kamea->connected;
+
+    /* Read incoming packets, CONNACK is handled here */
+    if (0 != (revents & (POLLIN | POLLERR | POLLHUP))) {
+        kamea->activity = k_uptime_get();
+        if (mqtt_input(&kamea->client) < 0) {
+            kamea->connected = false;
+            connected        = true;
+        }
+    }
+
+    /* Send the queued message with the highest priority */
+    if ((0 != (revents & POLLOUT)) && (true == kamea->connected)) {
+        kamea->activity = k_uptime_get();
+        kamea_mqtt_send_next(kamea);
+    }
+
+    /* Close connection if it has been lost or refused */
+    if ((true == kamea->open) && (true == connected) && (false == kamea->connected)) {
+        kamea_mqtt_close(kamea, false);
+    }
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+    /* Save the session when the in-flight messages have changed, once the queued messages are sent so that a burst is saved once */
+    if ((true == kamea->session_dirty) && (false == kamea_mqtt_sendable(kamea))) {
+        kamea_mqtt_session_save(kamea);
+    }
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+}
+
+static int
+kamea_mqtt_resolve(kamea_mqtt_t *kamea) {
+
+    int                    result;
+    struct zsock_addrinfo  hints;
+    struct zsock_addrinfo *addr = NULL;
+    char                   port[6];
+
+    LOG_INF("Trying to resolve Kamea MQTT broker address...");
+
+    /* Set hints */
+    memset(&hints, 0, sizeof(hints));
+    if (IS_ENABLED(CONFIG_NET_IPV6)) {
+        hints.ai_family = AF_INET6;
+    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
+        hints.ai_family = AF_INET;
+    }
+    hints.ai_socktype = SOCK_STREAM;
+
+    /* Perform DNS resolution of the host */
+    snprintf(port, sizeof(port), "%d", kamea->config.port);
+    if (0 != (result = zsock_getaddrinfo(kamea->config.hostname, port, &hints, &addr))) {
+        LOG_ERR("Unable to resolve host name '%s:%d', result = %d, errno = %d", kamea->config.hostname, kamea->config.port, result, errno);
+        return result;
+    }
+    LOG_INF("Resolved Kamea MQTT broker address");
+
+    /* MQTT broker configuration */
+    if (IS_ENABLED(CONFIG_NET_IPV6)) {
+        struct sockaddr_in6 *broker6 = (struct sockaddr_in6 *)&kamea->broker;
+        broker6->sin6_family         = AF_INET6;
+        broker6->sin6_port           = htons(kamea->config.port);
+        net_ipaddr_copy(&broker6->sin6_addr, &net_sin6(addr->ai_addr)->sin6_addr);
+    } else if (IS_ENABLED(CONFIG_NET_IPV4)) {
+        struct sockaddr_in *broker4 = (struct sockaddr_in *)&kamea->broker;
+        broker4->sin_family         = AF_INET;
+        broker4->sin_port           = htons(kamea->config.port);
+        net_ipaddr_copy(&broker4->sin_addr, &net_sin(addr->ai_addr)->sin_addr);
+    }
+    kamea->resolved = true;
+
+    /* Release memory */
+    zsock_freeaddrinfo(addr);
+
+    return 0;
+}
+
+static int
+kamea_mqtt_open(kamea_mqtt_t *kamea) {
+
+    k_spinlock_key_t key;
+    int64_t          start;
+    int              ciphersuite;
+    socklen_t        len = sizeof(ciphersuite);
+    int              result;
+
+    /* Resolve broker address once */
+    if ((false == kamea->resolved) && (0 != (result = kamea_mqtt_resolve(kamea)))) {
+        kamea->deadline = k_uptime_get() + MSEC_PER_SEC * CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL;
+        return result;
+    }
+    LOG_INF("Initializing Kamea MQTT client '%s'...", kamea->client_id);
+
+    /* Record connection start */
+    key = k_spin_lock(&kamea->latency_lock);
+    kamea->duty_stats.connections++;
+    kamea->duty_start           = k_uptime_get();
+    kamea->session_start        = kamea->duty_start;
+    kamea->session_received     = false;
+    kamea->session_acknowledged = false;
+    k_spin_unlock(&kamea->latency_lock, key);
+
+    /* Initialize MQTT client */
+    mqtt_client_init(&kamea->client);
+
+    /* MQTT client configuration */
+    kamea->client.broker           = &kamea->broker;
+    kamea->client.evt_cb           = kamea_mqtt_event_handler;
+    kamea->client.client_id.utf8   = (uint8_t *)kamea->client_id;
+    kamea->client.client_id.size   = strlen(kamea->client_id);
+    kamea->client.protocol_version = MQTT_VERSION_3_1_1;
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+    /* The broker keeps the subscriptions and the QoS 1 messages waiting for the device while disconnected */
+    kamea->client.clean_session = 0;
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+
+    /* MQTT buffers configuration */
+    kamea->client.rx_buf      = kamea->rx_buffer;
+    kamea->client.rx_buf_size = CONFIG_KAMEA_MQTT_RX_BUFFER_SIZE;
+    kamea->client.tx_buf      = kamea->tx_buffer;
+    kamea->client.tx_buf_size = CONFIG_KAMEA_MQTT_TX_BUFFER_SIZE;
+
+    /* Username and password */
+    kamea->client.password  = NULL;
+    kamea->client.user_name = NULL;
+
+    /* MQTT transport configuration */
+    kamea->client.transport.type = MQTT_TRANSPORT_SECURE;
+
+    /* MQTT TLS configuration */
+    kamea->client.transport.tls.config.peer_verify   = TLS_PEER_VERIFY_REQUIRED;
+#ifdef KAMEA_TLS_CIPHERSUITES
+    kamea->client.transport.tls.config.cipher_list  = kamea_mqtt_ciphersuites;
+    kamea->client.transport.tls.config.cipher_count = ARRAY_SIZE(kamea_mqtt_ciphersuites);
+#else
+    kamea->client.transport.tls.config.cipher_list = NULL;
+#endif /* KAMEA_TLS_CIPHERSUITES */
+    kamea->client.transport.tls.config.sec_tag_list  = kamea->sec_tag_list;
+    kamea->client.transport.tls.config.sec_tag_count = ARRAY_SIZE(kamea->sec_tag_list);
+    kamea->client.transport.tls.config.hostname      = kamea->config.hostname;
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+    /* Resume the previous TLS session when the server allows it to shorten the handshake of each burst */
+    kamea->client.transport.tls.config.session_cache = TLS_SESSION_CACHE_ENABLED;
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+    /* Connect to MQTT broker, the TCP and TLS handshakes are done here */
+    start  = k_uptime_get();
+    result = mqtt_connect(&kamea->client);
+    if ((0 != result) || (0 != zsock_getsockopt(kamea->client.transport.tls.sock, SOL_TLS, TLS_CIPHERSUITE_USED, &ciphersuite, &len))) {
+        ciphersuite = 0;
+    }
+    key = k_spin_lock(&kamea->latency_lock);
+    if (0 == result) {
+        kamea->stats.handshakes++;
+        kamea->stats.handshake_ms = (uint32_t)(k_uptime_get() - start);
+        kamea->stats.ciphersuite  = ciphersuite;
+        kamea_mqtt_histogram_add(kamea->stats.handshake, kamea->stats.handshake_ms);
+    } else {
+        kamea->stats.handshake_failures++;
+    }
+    k_spin_unlock(&kamea->latency_lock, key);
+    if (0 != result) {
+        LOG_ERR("Unable to connect to the MQTT broker '%s:%d', result = %d (%s), errno = %d",
+                kamea->config.hostname,
+                kamea->config.port,
+                result,
+                zsock_gai_strerror(result),
+                errno);
+        kamea_mqtt_close(kamea, false);
+        return result;
+    }
+    LOG_INF("Kamea client '%s' connected to MQTT broker", kamea->client_id);
+
+    /* Wait for CONNACK */
+    kamea->open     = true;
+    kamea->activity = k_uptime_get();
+    kamea->deadline = kamea->activity + KAMEA_MQTT_CONNACK_TIMEOUT;
+
+    return 0;
+}
+
+static void
+kamea_mqtt_close(kamea_mqtt_t *kamea, bool graceful) {
+
+    k_spinlock_key_t key;
+
+    /* Abort connection and release queued messages */
+    kamea->connected = false;
+    kamea->open      = false;
+    mqtt_abort(&kamea->client);
+    kamea_mqtt_flush(kamea);
+
+    /* Record connection time */
+    key = k_spin_lock(&kamea->latency_lock);
+    kamea->duty_stats.connected_ms += k_uptime_get() - kamea->duty_start;
+    kamea->duty_start               = -1;
+    if (kamea->connected_since >= 0) {
+        kamea->stats.disconnections++;
+        kamea->connected_since = -1;
+    }
+    k_spin_unlock(&kamea->latency_lock, key);
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+    /* Save session so that the messages not acknowledged are sent again after a reboot */
+    if (true == kamea->session_dirty) {
+        kamea_mqtt_session_save(kamea);
+    }
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+
+    /* Client disconnected */
+    if (NULL != kamea->config.callbacks.disconnected) {
+        kamea->config.callbacks.disconnected(kamea);
+    }
+    if (true == graceful) {
+        kamea->deadline = k_uptime_get();
+        return;
+    }
+    LOG_ERR("Kamea client '%s' disconnected, waiting before trying to connect again to the broker", kamea->client_id);
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+    /* Messages are kept in batch mode, try again to flush them */
+    if (true == kamea_mqtt_pending(kamea)) {
+        atomic_set(&kamea->requested, 1);
+    }
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+    /* Wait before trying again */
+    kamea->deadline = k_uptime_get() + MSEC_PER_SEC * CONFIG_KAMEA_MQTT_RECONNECT_INTERVAL;
+}
+
+static void
+kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt *evt) {
+
+    kamea_mqtt_t    *kamea = CONTAINER_OF(client, kamea_mqtt_t, client);
+    k_spinlock_key_t key;
+
+    /* Treatment depending of the event */
     switch (evt->type) {
         case MQTT_EVT_SUBACK:
+            if ((evt->param.suback.return_codes.len > 0) && (0x80 == evt->param.suback.return_codes.data[0])) {
+                LOG_ERR("SUBACK packet id: %u, subscription refused", evt->param.suback.message_id);
+                break;
+            }
             LOG_INF("SUBACK packet id: %u", evt->param.suback.message_id);
             break;
         case MQTT_EVT_UNSUBACK:
@@ -422,12 +1169,36 @@ kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt
                 LOG_ERR("MQTT connect failed %d", evt->result);
                 break;
             }
-            kamea_mqtt_connected = true;
+            kamea->connected = true;
             LOG_DBG("MQTT client connected!");
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+            /* Connection request is served by this burst, alerts queued from now are sent during the burst */
+            atomic_clear(&kamea->requested);
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+            key = k_spin_lock(&kamea->latency_lock);
+            kamea->session_stats.sessions++;
+            kamea->session_stats.resumed += evt->param.connack.session_present_flag;
+            kamea->connected_since = k_uptime_get();
+            k_spin_unlock(&kamea->latency_lock, key);
+            /* Subscriptions are only kept by the server when the session is resumed, send all of them again otherwise */
+            if (0 == evt->param.connack.session_present_flag) {
+                for (atomic_val_t index = 0; index < atomic_get(&kamea->subscriptions_count); index++) {
+                    kamea->subscriptions[index].subscribed = false;
+                }
+            }
+            atomic_set(&kamea->subscribe_pending, 0);
+            kamea_mqtt_send_subscriptions(kamea);
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+            /* Send again the QoS 1 messages not acknowledged, even if the session is not resumed */
+            kamea_mqtt_resend(kamea);
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+            if (NULL != kamea->config.callbacks.connected) {
+                kamea->config.callbacks.connected(kamea);
+            }
             break;
         case MQTT_EVT_DISCONNECT:
             LOG_DBG("MQTT client disconnected %d", evt->result);
-            kamea_mqtt_connected = false;
+            kamea->connected = false;
             break;
         case MQTT_EVT_PUBACK:
             if (evt->result) {
@@ -435,23 +1206,24 @@ kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt
                 break;
             }
             LOG_DBG("PUBACK packet id: %u\n", evt->param.puback.message_id);
+            kamea_mqtt_update_puback_rtt(kamea, evt->param.puback.message_id);
+            kamea_mqtt_record_delivery(kamea, false);
             break;
         case MQTT_EVT_PUBLISH:
-            len = evt->param.publish.message.payload.len;
-            LOG_INF("MQTT publish received %d, %d bytes", evt->result, len);
-            LOG_INF(" id: %d, qos: %d", evt->param.publish.message_id, evt->param.publish.message.topic.qos);
-            while (len) {
-                bytes_read = mqtt_read_publish_payload(client, data, (len >= sizeof(data) - 1) ? (sizeof(data) - 1) : len);
-                if (bytes_read < 0 && bytes_read != -EAGAIN) {
-                    LOG_ERR("failure to read payload");
-                    break;
-                }
-                data[bytes_read] = '\0';
-                LOG_INF("   payload: %s", data);
-                len -= bytes_read;
-            }
-            puback.message_id = evt->param.publish.message_id;
-            mqtt_publish_qos1_ack(client, &puback);
+            LOG_DBG("PUBLISH packet id: %u, qos: %d, %u bytes",
+                    evt->param.publish.message_id,
+                    evt->param.publish.message.topic.qos,
+                    evt->param.publish.message.payload.len);
+            key = k_spin_lock(&kamea->latency_lock);
+            kamea->stats.received++;
+            kamea->stats.bytes_received += evt->param.publish.message.payload.len;
+            k_spin_unlock(&kamea->latency_lock, key);
+            kamea_mqtt_record_delivery(kamea, true);
+            kamea_mqtt_receive(kamea, &evt->param.publish);
+            break;
+        case MQTT_EVT_PUBREL:
+            LOG_DBG("PUBREL packet id: %u", evt->param.pubrel.message_id);
+            kamea_mqtt_release(kamea, evt->param.pubrel.message_id);
             break;
         default:
             LOG_DBG("Unhandled MQTT event %d", evt->type);
@@ -459,6 +1231,1028 @@ kamea_mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt
     }
 }
 
+static int
+kamea_mqtt_queue(kamea_mqtt_t                     *kamea,
+                 const char                       *topic,
+                 uint8_t                          *data,
+                 uint32_t                          len,
+                 struct kamea_mqtt_stream_request *request,
+                 enum mqtt_qos                     qos,
+                 kamea_priority_t                  priority) {
+
+    assert(NULL != kamea);
+    assert((NULL != data) || (NULL != request));
+    assert(priority < KAMEA_PRIORITY_COUNT);
+    struct kamea_mqtt_lane    *lane = &kamea->lanes[priority];
+    struct kamea_mqtt_message *message;
+
+    /* Check if client is initialized */
+    if (false == kamea->initialized) {
+        return -ENODEV;
+    }
+
+    /* Check if client is connected, messages are queued until the next burst in batch mode or the next connection with a persistent session */
+    if ((false == kamea->connected) && !IS_ENABLED(CONFIG_KAMEA_MQTT_BATCH) && !IS_ENABLED(CONFIG_KAMEA_MQTT_PERSISTENT_SESSION)) {
+        LOG_DBG("Unable to publish data, client is not connected");
+        kamea_mqtt_record_publish(kamea, -ENOTCONN, 0);
+        return -ENOTCONN;
+    }
+
+    /* Check payload length */
+    if (len > CONFIG_KAMEA_MQTT_PAYLOAD_SIZE) {
+        LOG_ERR("Unable to publish data, payload is too large (%u bytes)", len);
+        kamea_mqtt_record_publish(kamea, -EMSGSIZE, 0);
+        return -EMSGSIZE;
+    }
+
+    /* Allocate message, never wait so that the calling thread is not blocked by a stalled uplink */
+    if (0 != k_mem_slab_alloc(&lane->slab, (void **)&message, K_NO_WAIT)) {
+        LOG_DBG("Unable to publish data, priority %d queue is full", priority);
+        kamea_mqtt_record_publish(kamea, -ENOBUFS, 0);
+        return -ENOBUFS;
+    }
+    message->topic      = topic;
+    message->qos        = qos;
+    message->message_id = 0;
+    message->len        = len;
+    message->timestamp  = k_cycle_get_32();
+    message->request    = request;
+    message->cancelled  = false;
+    if (NULL != data) {
+        memcpy(message->payload, data, len);
+    } else {
+        request->message = message;
+    }
+
+    /* Queue message and wake up the Kamea MQTT thread */
+    k_fifo_put(&lane->fifo, message);
+    kamea_mqtt_wake();
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+    /* Alerts force an immediate connection */
+    if ((KAMEA_PRIORITY_HIGH == priority) && (false == kamea->connected)) {
+        kamea_mqtt_request(kamea);
+    }
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+    return 0;
+}
+
+static bool
+kamea_mqtt_pending(kamea_mqtt_t *kamea) {
+
+    /* Check the streamed message being written */
+    if (NULL != kamea->stream) {
+        return true;
+    }
+
+    /* Check all lanes */
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        if (!k_fifo_is_empty(&kamea->lanes[priority].fifo)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+kamea_mqtt_sendable(kamea_mqtt_t *kamea) {
+
+    struct kamea_mqtt_lane *lane;
+
+    return (NULL != kamea->stream) || (NULL != kamea_mqtt_next_message(kamea, &lane));
+}
+
+static struct kamea_mqtt_message *
+kamea_mqtt_next_message(kamea_mqtt_t *kamea, struct kamea_mqtt_lane **lane) {
+
+    struct kamea_mqtt_message *message;
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+    struct kamea_mqtt_inflight *inflight = &kamea->inflight[kamea->inflight_index];
+
+    /* The in-flight table is a ring, the next slot holds the oldest message, QoS 1 messages wait in their lane while it is not acknowledged */
+    bool full = (true == inflight->used) && (NULL != inflight->message);
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+
+    /* Retrieve the message with the highest priority, bulk messages are sent only if no other message is pending */
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        *lane = &kamea->lanes[priority];
+        if (NULL == (message = k_fifo_peek_head(&(*lane)->fifo))) {
+            continue;
+        }
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+        if ((true == full) && (MQTT_QOS_1_AT_LEAST_ONCE == message->qos)) {
+            continue;
+        }
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+        return message;
+    }
+
+    return NULL;
+}
+
+static uint16_t
+kamea_mqtt_next_message_id(kamea_mqtt_t *kamea) {
+
+    bool used;
+
+    /* Increment the counter, skipping 0 which is not a valid message ID and the IDs still waiting for PUBACK */
+    do {
+        if (0 == ++kamea->message_id) {
+            kamea->message_id = 1;
+        }
+        used = false;
+        for (int index = 0; index < KAMEA_MQTT_INFLIGHT_COUNT; index++) {
+            used |= ((true == kamea->inflight[index].used) && (kamea->message_id == kamea->inflight[index].message_id));
+        }
+    } while (true == used);
+
+    return kamea->message_id;
+}
+
+static int
+kamea_mqtt_send_next(kamea_mqtt_t *kamea) {
+
+    struct kamea_mqtt_lane    *lane    = NULL;
+    struct kamea_mqtt_message *message = NULL;
+    int                        result;
+
+    /* Write the next chunk of the streamed message, one per call so that incoming packets and the other instances are served meanwhile */
+    if (NULL != kamea->stream) {
+        if (-EINPROGRESS == (result = kamea_mqtt_send_stream_chunk(kamea))) {
+            return 0;
+        }
+        message       = kamea->stream;
+        kamea->stream = NULL;
+        kamea_mqtt_sent(kamea, kamea->stream_lane, message, result);
+        return result;
+    }
+
+    /* Retrieve the next message, the Kamea MQTT thread is the only one removing messages from the lanes */
+    if (NULL == (message = kamea_mqtt_next_message(kamea, &lane))) {
+        return 0;
+    }
+    k_fifo_get(&lane->fifo, K_NO_WAIT);
+
+    /* Publish data, the message ID is allocated by the Kamea MQTT thread which owns the in-flight messages table */
+    message->message_id = kamea_mqtt_next_message_id(kamea);
+    if (0 != (result = kamea_mqtt_publish(kamea, message, false))) {
+        LOG_ERR("Unable to publish data, result = %d, errno = %d", result, errno);
+    } else if (NULL != message->request) {
+        /* Header of the streamed message is written, the payload is written by the next calls */
+        kamea->stream      = message;
+        kamea->stream_lane = lane;
+        kamea->stream_sent = 0;
+        return 0;
+    }
+    kamea_mqtt_sent(kamea, lane, message, result);
+
+    return result;
+}
+
+static void
+kamea_mqtt_sent(kamea_mqtt_t *kamea, struct kamea_mqtt_lane *lane, struct kamea_mqtt_message *message, int result) {
+
+    struct kamea_mqtt_inflight *inflight;
+    bool                        kept = false;
+    uint32_t                    latency;
+    k_spinlock_key_t            key;
+
+    if (0 == result) {
+        /* Record latency */
+        latency = k_cyc_to_us_floor32(k_cycle_get_32() - message->timestamp);
+        key     = k_spin_lock(&kamea->latency_lock);
+        lane->latency[lane->latency_count++ % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES] = latency;
+        k_spin_unlock(&kamea->latency_lock, key);
+        /* Track message until PUBACK is received */
+        if (MQTT_QOS_1_AT_LEAST_ONCE == message->qos) {
+            inflight              = &kamea->inflight[kamea->inflight_index];
+            kamea->inflight_index = (kamea->inflight_index + 1) % KAMEA_MQTT_INFLIGHT_COUNT;
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+            /* Keep the message to send it again after reconnecting, QoS 1 messages are not sent while the slot is held so this is not expected */
+            if ((true == inflight->used) && (NULL != inflight->message)) {
+                LOG_WRN("Dropping QoS 1 message %u not acknowledged", inflight->message_id);
+                kamea_mqtt_record_publish(kamea, -ENOBUFS, 0);
+                if (NULL != kamea->config.callbacks.published) {
+                    kamea->config.callbacks.published(kamea, inflight->message_id, -ENOBUFS);
+                }
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+                kamea->session_dirty = true;
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+            }
+            kamea_mqtt_forget(kamea, inflight);
+            if (NULL == message->request) {
+                inflight->message = message;
+                kept              = true;
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+                kamea->session_dirty = true;
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+            }
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+            inflight->used       = true;
+            inflight->message_id = message->message_id;
+            inflight->timestamp  = k_cycle_get_32();
+            inflight->queued     = message->timestamp;
+            inflight->priority   = lane - kamea->lanes;
+        }
+    }
+
+    /* Complete and release message, unless it is kept until PUBACK */
+    kamea_mqtt_complete(kamea, message, result);
+    if (false == kept) {
+        k_mem_slab_free(&lane->slab, message);
+    }
+}
+
+static int
+kamea_mqtt_publish(kamea_mqtt_t *kamea, struct kamea_mqtt_message *message, bool dup) {
+
+    struct mqtt_publish_param param;
+    char                      topic[KAMEA_MQTT_TOPIC_SIZE];
+
+    /* Set publish param */
+    param.message.topic.qos = message->qos;
+    snprintf(topic, sizeof(topic), "%s%s", kamea->device_topic, message->topic);
+    param.message.topic.topic.utf8 = (uint8_t *)topic;
+    param.message.topic.topic.size = strlen(topic);
+    param.message.payload.data     = message->payload;
+    param.message.payload.len      = message->len;
+    param.message_id               = message->message_id;
+    param.dup_flag                 = (true == dup) ? 1U : 0U;
+    param.retain_flag              = 0U;
+
+    /* Publish data, streamed payloads are written directly to the socket */
+    if (NULL != message->request) {
+        return kamea_mqtt_send_stream_header(kamea, topic, message);
+    }
+
+    return mqtt_publish(&kamea->client, &param);
+}
+
+static int
+kamea_mqtt_send_stream_header(kamea_mqtt_t *kamea, const char *topic, struct kamea_mqtt_message *message) {
+
+    uint8_t header[KAMEA_MQTT_STREAM_HEADER_SIZE];
+    size_t  topic_len = strlen(topic);
+    size_t  remaining = 2 + topic_len + ((MQTT_QOS_0_AT_MOST_ONCE != message->qos) ? 2 : 0);
+    size_t  offset    = 0;
+    int     result    = 0;
+
+    /* Retrieve payload length, the request is detached if the publishing thread has timed out */
+    k_mutex_lock(&kamea->stream_lock, K_FOREVER);
+    if (true == message->cancelled) {
+        result = -ECANCELED;
+    } else {
+        remaining += message->request->stream->len;
+    }
+    k_mutex_unlock(&kamea->stream_lock);
+    if (0 != result) {
+        return result;
+    }
+
+    /* Check lengths */
+    if ((topic_len > KAMEA_MQTT_TOPIC_SIZE) || (remaining > KAMEA_MQTT_REMAINING_LENGTH_MAX)) {
+        return -EMSGSIZE;
+    }
+
+    /* Encode fixed header: PUBLISH packet type, QoS flags and remaining length */
+    header[offset++] = 0x30 | (message->qos << 1);
+    for (; remaining >= 128; remaining /= 128) {
+        header[offset++] = 0x80 | (remaining % 128);
+    }
+    header[offset++] = remaining;
+
+    /* Encode variable header: topic and message ID */
+    sys_put_be16(topic_len, &header[offset]);
+    offset += 2;
+    memcpy(&header[offset], topic, topic_len);
+    offset += topic_len;
+    if (MQTT_QOS_0_AT_MOST_ONCE != message->qos) {
+        sys_put_be16(message->message_id, &header[offset]);
+        offset += 2;
+    }
+
+    /* A partially written header breaks the MQTT stream, the connection must be closed */
+    if (0 != (result = kamea_mqtt_write(kamea, header, offset))) {
+        LOG_ERR("Unable to stream payload, closing connection");
+        kamea->connected = false;
+    }
+
+    return result;
+}
+
+static int
+kamea_mqtt_send_stream_chunk(kamea_mqtt_t *kamea) {
+
+    const kamea_mqtt_stream_t *stream;
+    const uint8_t             *chunk;
+    int                        len, result = 0;
+
+    /* Write the next chunk given by the iterator, the request is used under the lock so that the publishing thread can detach it on timeout */
+    k_mutex_lock(&kamea->stream_lock, K_FOREVER);
+    if (true == kamea->stream->cancelled) {
+        result = -ECANCELED;
+    } else if (kamea->stream_sent < (stream = kamea->stream->request->stream)->len) {
+        if ((len = stream->next(stream->user_data, &chunk)) <= 0) {
+            result = (len < 0) ? len : -EIO;
+        } else if (len > stream->len - kamea->stream_sent) {
+            result = -EMSGSIZE;
+        } else if (0 == (result = kamea_mqtt_write(kamea, chunk, len))) {
+            kamea->stream_sent += len;
+            result              = (kamea->stream_sent < stream->len) ? -EINPROGRESS : 0;
+        }
+    }
+    k_mutex_unlock(&kamea->stream_lock);
+
+    /* A partially written message breaks the MQTT stream, the connection must be closed */
+    if ((0 != result) && (-EINPROGRESS != result)) {
+        LOG_ERR("Unable to stream payload, closing connection");
+        kamea->connected = false;
+    }
+
+    return result;
+}
+
+static int
+kamea_mqtt_write(kamea_mqtt_t *kamea, const uint8_t *data, size_t len) {
+
+    ssize_t result;
+
+    /* Write all data, the socket is blocking */
+    while (len > 0) {
+        if ((result = zsock_send(kamea->client.transport.tls.sock, data, len, 0)) < 0) {
+            return -errno;
+        }
+        data += result;
+        len  -= result;
+    }
+
+    return 0;
+}
+
+static void
+kamea_mqtt_complete(kamea_mqtt_t *kamea, struct kamea_mqtt_message *message, int result) {
+
+    size_t len = message->len;
+
+    /* Wake up the thread waiting for the streamed message, unless it has timed out, the request must not be used anymore */
+    if (NULL != message->request) {
+        k_mutex_lock(&kamea->stream_lock, K_FOREVER);
+        if (false == message->cancelled) {
+            len                      = message->request->stream->len;
+            message->request->result = result;
+            k_sem_give(&message->request->done);
+        }
+        k_mutex_unlock(&kamea->stream_lock);
+    }
+
+    /* Record result */
+    kamea_mqtt_record_publish(kamea, result, len);
+
+    /* Invoke published callback */
+    if (NULL != kamea->config.callbacks.published) {
+        kamea->config.callbacks.published(kamea, message->message_id, result);
+    }
+}
+
+static void
+kamea_mqtt_flush(kamea_mqtt_t *kamea) {
+
+    /* Drop the streamed message being written, it can not be resumed on the next connection */
+    if (NULL != kamea->stream) {
+        kamea_mqtt_complete(kamea, kamea->stream, -ENOTCONN);
+        k_mem_slab_free(&kamea->stream_lane->slab, kamea->stream);
+        kamea->stream = NULL;
+    }
+
+#if !defined(CONFIG_KAMEA_MQTT_BATCH) && !defined(CONFIG_KAMEA_MQTT_PERSISTENT_SESSION)
+    struct kamea_mqtt_message *message;
+
+    /* Release messages of all lanes, they are kept until the next burst in batch mode or the next connection with a persistent session */
+    for (int priority = 0; priority < KAMEA_PRIORITY_COUNT; priority++) {
+        while (NULL != (message = k_fifo_get(&kamea->lanes[priority].fifo, K_NO_WAIT))) {
+            kamea_mqtt_complete(kamea, message, -ENOTCONN);
+            k_mem_slab_free(&kamea->lanes[priority].slab, message);
+        }
+    }
+#endif /* !CONFIG_KAMEA_MQTT_BATCH && !CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+
+#ifndef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+    /* Forget messages waiting for PUBACK and PUBREL, they are part of the session otherwise */
+    memset(kamea->inflight, 0, sizeof(kamea->inflight));
+    memset(kamea->qos2_received, 0, sizeof(kamea->qos2_received));
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+}
+
+static int
+kamea_mqtt_send_subscriptions(kamea_mqtt_t *kamea) {
+
+    struct kamea_mqtt_subscription *subscription;
+    struct mqtt_topic               topic;
+    struct mqtt_subscription_list   list;
+    char                            filter[96];
+    atomic_val_t                    count  = atomic_get(&kamea->subscriptions_count);
+    int                             result = 0;
+
+    /* Subscribe to the topic filters not sent yet, below the device topic */
+    for (atomic_val_t index = 0; index < count; index++) {
+        subscription = &kamea->subscriptions[index];
+        if (true == subscription->subscribed) {
+            continue;
+        }
+        snprintf(filter, sizeof(filter), "%s%s", kamea->device_topic, subscription->filter);
+        topic.topic.utf8 = (uint8_t *)filter;
+        topic.topic.size = strlen(filter);
+        topic.qos        = subscription->qos;
+        list.list        = &topic;
+        list.list_count  = 1;
+        list.message_id  = kamea_mqtt_next_message_id(kamea);
+        if (0 != (result = mqtt_subscribe(&kamea->client, &list))) {
+            LOG_ERR("Unable to subscribe to '%s', result = %d", filter, result);
+            break;
+        }
+        subscription->subscribed = true;
+    }
+
+    return result;
+}
+
+static void
+kamea_mqtt_receive(kamea_mqtt_t *kamea, const struct mqtt_publish_param *publish) {
+
+    const char                     *topic     = (const char *)publish->message.topic.topic.utf8;
+    size_t                          topic_len = publish->message.topic.topic.size;
+    uint8_t                        *buffer    = (uint8_t *)topic + topic_len;
+    size_t                          size      = &kamea->rx_buffer[sizeof(kamea->rx_buffer)] - buffer;
+    uint32_t                        start     = k_cycle_get_32();
+    uint32_t                        matches   = 0;
+    kamea_mqtt_slice_t              slice;
+    struct kamea_mqtt_subscription *subscription;
+    struct mqtt_puback_param        puback;
+    struct mqtt_pubrec_param        pubrec;
+    bool                            duplicate = false;
+    uint32_t                        time;
+    k_spinlock_key_t                key;
+    int                             result;
+
+    /* The header of the message has already been decoded, only the topic is still needed in the Rx buffer */
+    if (0 == size) {
+        LOG_ERR("Unable to read payload, Rx buffer is too small");
+        return;
+    }
+
+    /* QoS 2 messages waiting for PUBREL have already been delivered */
+    if (MQTT_QOS_2_EXACTLY_ONCE == publish->message.topic.qos) {
+        for (int index = 0; index < KAMEA_MQTT_QOS2_COUNT; index++) {
+            duplicate |= (publish->message_id == kamea->qos2_received[index]);
+        }
+    }
+
+    /* Retrieve matching subscriptions, topics are relative to the device topic */
+    slice.topic     = topic;
+    slice.topic_len = topic_len;
+    if ((topic_len >= kamea->device_topic_len) && (0 == memcmp(topic, kamea->device_topic, kamea->device_topic_len))) {
+        slice.topic     += kamea->device_topic_len;
+        slice.topic_len -= kamea->device_topic_len;
+        matches          = (false == duplicate) ? kamea_mqtt_route(kamea, slice.topic, slice.topic_len) : 0;
+    }
+    if (0 == matches) {
+        LOG_DBG("No subscription matching '%.*s', payload is discarded", (int)topic_len, topic);
+    }
+
+    /* Read the payload slice by slice in the Rx buffer, after the topic, and dispatch the slices without copy */
+    slice.data      = buffer;
+    slice.offset    = 0;
+    slice.total_len = publish->message.payload.len;
+    do {
+        slice.len = MIN(slice.total_len - slice.offset, size);
+        if ((slice.len > 0) && (0 != (result = mqtt_readall_publish_payload(&kamea->client, buffer, slice.len)))) {
+            LOG_ERR("Unable to read payload, result = %d", result);
+            return;
+        }
+        for (int index = 0; (index < CONFIG_KAMEA_MQTT_SUBSCRIPTIONS) && (0 != matches); index++) {
+            if (0 != (matches & BIT(index))) {
+                subscription = &kamea->subscriptions[index];
+                subscription->handler(&slice, subscription->user_data);
+            }
+        }
+        slice.offset += slice.len;
+    } while (slice.offset < slice.total_len);
+
+    /* Acknowledge message depending on its QoS */
+    if (MQTT_QOS_1_AT_LEAST_ONCE == publish->message.topic.qos) {
+        puback.message_id = publish->message_id;
+        mqtt_publish_qos1_ack(&kamea->client, &puback);
+    } else if (MQTT_QOS_2_EXACTLY_ONCE == publish->message.topic.qos) {
+        if (false == duplicate) {
+            kamea->qos2_received[kamea->qos2_index] = publish->message_id;
+            kamea->qos2_index                       = (kamea->qos2_index + 1) % KAMEA_MQTT_QOS2_COUNT;
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+            kamea->session_dirty = true;
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+        }
+        pubrec.message_id = publish->message_id;
+        mqtt_publish_qos2_receive(&kamea->client, &pubrec);
+    }
+
+    /* Record dispatch time */
+    time = (uint32_t)k_cyc_to_ns_floor64(k_cycle_get_32() - start);
+    key  = k_spin_lock(&kamea->latency_lock);
+    kamea->dispatch_time[kamea->dispatch_count++ % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES] = time;
+    k_spin_unlock(&kamea->latency_lock, key);
+}
+
+static uint32_t
+kamea_mqtt_route(kamea_mqtt_t *kamea, const char *topic, size_t len) {
+
+    atomic_val_t count   = atomic_get(&kamea->subscriptions_count);
+    uint32_t     matches = 0;
+
+    /* Check all subscriptions, several of them may match the same topic */
+    for (atomic_val_t index = 0; index < count; index++) {
+        if (true == kamea_mqtt_topic_match(kamea->subscriptions[index].filter, topic, len)) {
+            matches |= BIT(index);
+        }
+    }
+
+    return matches;
+}
+
+static bool
+kamea_mqtt_topic_match(const char *filter, const char *topic, size_t len) {
+
+    size_t index = 0;
+
+    /* Compare filter and topic level by level */
+    while ('\0' != *filter) {
+        if ('#' == *filter) {
+            /* Multi-level wildcard, matches all the remaining levels */
+            return true;
+        } else if ('+' == *filter) {
+            /* Single-level wildcard, skip the current topic level */
+            while ((index < len) && ('/' != topic[index])) {
+                index++;
+            }
+            filter++;
+        } else if ((index == len) && (0 == strcmp(filter, "/#"))) {
+            /* Multi-level wildcard also matches the parent level */
+            return true;
+        } else if ((index < len) && (*filter == topic[index])) {
+            filter++;
+            index++;
+        } else {
+            return false;
+        }
+    }
+
+    return (index == len);
+}
+
+static void
+kamea_mqtt_release(kamea_mqtt_t *kamea, uint16_t message_id) {
+
+    struct mqtt_pubcomp_param pubcomp;
+
+    /* Forget message, a PUBLISH received with the same message ID is a new message */
+    for (int index = 0; index < KAMEA_MQTT_QOS2_COUNT; index++) {
+        if (message_id == kamea->qos2_received[index]) {
+            kamea->qos2_received[index] = 0;
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+            kamea->session_dirty = true;
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+        }
+    }
+
+    /* Complete QoS 2 flow, PUBCOMP is sent even if the message is unknown */
+    pubcomp.message_id = message_id;
+    mqtt_publish_qos2_complete(&kamea->client, &pubcomp);
+}
+
+static void
+kamea_mqtt_update_puback_rtt(kamea_mqtt_t *kamea, uint16_t message_id) {
+
+    struct kamea_mqtt_lane *lane;
+    k_spinlock_key_t        key;
+    uint32_t                rtt, srtt;
+
+    /* Count acknowledged messages, even those not tracked anymore */
+    key = k_spin_lock(&kamea->latency_lock);
+    kamea->stats.acknowledged++;
+    k_spin_unlock(&kamea->latency_lock, key);
+
+    /* Retrieve message */
+    for (int index = 0; index < KAMEA_MQTT_INFLIGHT_COUNT; index++) {
+        if ((true == kamea->inflight[index].used) && (message_id == kamea->inflight[index].message_id)) {
+            /* Smooth the round-trip time the same way TCP does (7/8 of the previous value), an outdated value is not used */
+            rtt  = k_cyc_to_us_floor32(k_cycle_get_32() - kamea->inflight[index].timestamp);
+            srtt = kamea_mqtt_get_puback_rtt(kamea);
+            atomic_set(&kamea->puback_rtt, (0 == srtt) ? rtt : ((7 * (uint64_t)srtt + rtt) / 8));
+            atomic_set(&kamea->puback_time, (atomic_val_t)k_uptime_get_32());
+            lane = &kamea->lanes[kamea->inflight[index].priority];
+            key  = k_spin_lock(&kamea->latency_lock);
+            kamea_mqtt_histogram_add(kamea->stats.puback_rtt, rtt / USEC_PER_MSEC);
+            lane->ack_latency[lane->ack_latency_count++ % CONFIG_KAMEA_MQTT_LATENCY_SAMPLES]
+                = k_cyc_to_us_floor32(k_cycle_get_32() - kamea->inflight[index].queued);
+            k_spin_unlock(&kamea->latency_lock, key);
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+            /* Release the message kept until PUBACK */
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+            kamea->session_dirty |= (NULL != kamea->inflight[index].message);
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+            kamea_mqtt_forget(kamea, &kamea->inflight[index]);
+#else
+            kamea->inflight[index].used = false;
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+            return;
+        }
+    }
+}
+
+static void
+kamea_mqtt_request(kamea_mqtt_t *kamea) {
+
+    /* Set flag and wake up the Kamea MQTT thread */
+    atomic_set(&kamea->requested, 1);
+    kamea_mqtt_wake();
+}
+
+static void
+kamea_mqtt_record_delivery(kamea_mqtt_t *kamea, bool received) {
+
+    k_spinlock_key_t key    = k_spin_lock(&kamea->latency_lock);
+    uint32_t         time   = (uint32_t)(k_uptime_get() - kamea->session_start);
+    bool            *record = (true == received) ? &kamea->session_received : &kamea->session_acknowledged;
+
+    /* Record only the first message of the connection */
+    if (false == *record) {
+        *record = true;
+        if (true == received) {
+            kamea->session_stats.received++;
+            kamea->session_stats.received_ms = time;
+        } else {
+            kamea->session_stats.acknowledged++;
+            kamea->session_stats.acknowledged_ms = time;
+        }
+    }
+
+    k_spin_unlock(&kamea->latency_lock, key);
+}
+
+static void
+kamea_mqtt_record_publish(kamea_mqtt_t *kamea, int result, size_t len) {
+
+    k_spinlock_key_t key = k_spin_lock(&kamea->latency_lock);
+
+    /* Messages are dropped if the client is disconnected or the queue is full, other errors (payload too large, socket write) are failures */
+    if (0 == result) {
+        kamea->stats.published++;
+        kamea->stats.bytes_sent += len;
+    } else if ((-ENOTCONN == result) || (-ENOBUFS == result)) {
+        kamea->stats.dropped++;
+    } else {
+        kamea->stats.failed++;
+    }
+
+    k_spin_unlock(&kamea->latency_lock, key);
+}
+
+static void
+kamea_mqtt_histogram_add(uint32_t *histogram, uint32_t value) {
+
+    /* Bucket n counts values lower than 2^n, the last one counts all the greater values */
+    histogram[MIN(find_msb_set(value), KAMEA_MQTT_HISTOGRAM_BUCKETS - 1)]++;
+}
+
+#ifdef CONFIG_KAMEA_MQTT_STATS_TELEMETRY
+
+static void
+kamea_mqtt_publish_stats(kamea_mqtt_t *kamea) {
+
+    kamea_mqtt_stats_t stats;
+    char               payload[CONFIG_KAMEA_MQTT_PAYLOAD_SIZE];
+    int                len;
+
+    /* Format payload, round-trip time is the smoothed one (milliseconds) */
+    kamea_mqtt_get_stats(kamea, &stats);
+    len = snprintf(payload,
+                   sizeof(payload),
+                   "{ \"kamea\": { \"published\": %u, \"failed\": %u, \"dropped\": %u, \"acknowledged\": %u, \"handshakes\": %u, "
+                   "\"disconnections\": %u, \"uptime\": %u, \"rtt\": %u } }",
+                   stats.published,
+                   stats.failed,
+                   stats.dropped,
+                   stats.acknowledged,
+                   stats.handshakes,
+                   stats.disconnections,
+                   stats.uptime_s,
+                   kamea_mqtt_get_puback_rtt(kamea) / USEC_PER_MSEC);
+    if ((len < 0) || (len >= sizeof(payload))) {
+        LOG_ERR("Unable to format statistics telemetry");
+        return;
+    }
+
+    /* Publish payload with the lowest priority */
+    kamea_mqtt_publish_telemetry(kamea, (uint8_t *)payload, len, MQTT_QOS_0_AT_MOST_ONCE, KAMEA_PRIORITY_LOW);
+}
+
+#endif /* CONFIG_KAMEA_MQTT_STATS_TELEMETRY */
+
+#ifdef CONFIG_KAMEA_MQTT_PERSISTENT_SESSION
+
+static void
+kamea_mqtt_resend(kamea_mqtt_t *kamea) {
+
+    struct kamea_mqtt_inflight *inflight;
+    uint32_t                    resent = 0;
+    k_spinlock_key_t            key;
+    int                         result;
+
+    /* Send again the messages kept until PUBACK with the DUP flag, oldest first */
+    for (int count = 0; count < KAMEA_MQTT_INFLIGHT_COUNT; count++) {
+        inflight = &kamea->inflight[(kamea->inflight_index + count) % KAMEA_MQTT_INFLIGHT_COUNT];
+        if ((false == inflight->used) || (NULL == inflight->message)) {
+            continue;
+        }
+        if (0 != (result = kamea_mqtt_publish(kamea, inflight->message, true))) {
+            LOG_ERR("Unable to publish data again, result = %d", result);
+            break;
+        }
+        inflight->timestamp = k_cycle_get_32();
+        resent++;
+    }
+    if (resent > 0) {
+        LOG_INF("Sent again %u QoS 1 messages not acknowledged", resent);
+    }
+
+    key = k_spin_lock(&kamea->latency_lock);
+    kamea->session_stats.resent += resent;
+    k_spin_unlock(&kamea->latency_lock, key);
+}
+
+static void
+kamea_mqtt_forget(kamea_mqtt_t *kamea, struct kamea_mqtt_inflight *inflight) {
+
+    /* Release the message kept until PUBACK */
+    if ((true == inflight->used) && (NULL != inflight->message)) {
+        k_mem_slab_free(&kamea->lanes[inflight->priority].slab, inflight->message);
+    }
+    memset(inflight, 0, sizeof(struct kamea_mqtt_inflight));
+}
+
+#endif /* CONFIG_KAMEA_MQTT_PERSISTENT_SESSION */
+
+#ifdef CONFIG_KAMEA_MQTT_SESSION_STORAGE
+
+static int
+kamea_mqtt_session_save(kamea_mqtt_t *kamea) {
+
+    const struct flash_area         *fa;
+    struct kamea_mqtt_session_header header = { .magic = KAMEA_MQTT_SESSION_MAGIC, .version = KAMEA_MQTT_SESSION_VERSION };
+    struct kamea_mqtt_session_entry  entry;
+    struct kamea_mqtt_inflight      *inflight;
+    struct kamea_mqtt_message       *message;
+    off_t                            slot   = CONFIG_KAMEA_MQTT_SESSION_STORAGE_OFFSET + kamea->index * CONFIG_KAMEA_MQTT_SESSION_STORAGE_SLOT_SIZE;
+    off_t                            offset = slot + sizeof(header);
+    uint32_t                         crc    = 0;
+    int                              res;
+
+    /* Count messages to save, the flash is not erased if the session is and was empty, a failed save is retried on the next change */
+    for (int index = 0; index < KAMEA_MQTT_INFLIGHT_COUNT; index++) {
+        header.count += ((true == kamea->inflight[index].used) && (NULL != kamea->inflight[index].message)) ? 1 : 0;
+    }
+    kamea->session_dirty = false;
+    if ((0 == header.count) && (false == kamea->session_stored)) {
+        return 0;
+    }
+
+    /* Erase slot */
+    if (0 != (res = flash_area_open(FIXED_PARTITION_ID(storage_partition), &fa))) {
+        LOG_ERR("Unable to open storage partition, result = %d", res);
+        return res;
+    }
+    if (0 != (res = flash_area_erase(fa, slot, CONFIG_KAMEA_MQTT_SESSION_STORAGE_SLOT_SIZE))) {
+        LOG_ERR("Unable to erase session, result = %d", res);
+        goto END;
+    }
+    kamea->session_stored = false;
+    if (0 == header.count) {
+        goto END;
+    }
+
+    /* Write messages, oldest first */
+    for (int count = 0; count < KAMEA_MQTT_INFLIGHT_COUNT; count++) {
+        inflight = &kamea->inflight[(kamea->inflight_index + count) % KAMEA_MQTT_INFLIGHT_COUNT];
+        message  = inflight->message;
+        if ((false == inflight->used) || (NULL == message)) {
+            continue;
+        }
+        entry.message_id = message->message_id;
+        entry.priority   = inflight->priority;
+        entry.len        = message->len;
+        for (entry.topic = 0; (entry.topic < ARRAY_SIZE(kamea_mqtt_topics)) && (0 != strcmp(message->topic, kamea_mqtt_topics[entry.topic]));
+             entry.topic++) {}
+        crc = crc32_ieee_update(crc, (const uint8_t *)&entry, sizeof(entry));
+        crc = crc32_ieee_update(crc, message->payload, message->len);
+        if ((0 != (res = flash_area_write(fa, offset, &entry, sizeof(entry))))
+            || (0 != (res = flash_area_write(fa, offset + sizeof(entry), message->payload, message->len)))) {
+            LOG_ERR("Unable to write session, result = %d", res);
+            goto END;
+        }
+        offset += sizeof(entry) + CONFIG_KAMEA_MQTT_PAYLOAD_SIZE;
+    }
+
+    /* Write header last so that an interrupted save leaves an invalid session */
+    strncpy(header.client_id, kamea->client_id, sizeof(header.client_id));
+    memcpy(header.qos2_received, kamea->qos2_received, sizeof(header.qos2_received));
+    header.crc = crc;
+    if (0 != (res = flash_area_write(fa, slot, &header, sizeof(header)))) {
+        LOG_ERR("Unable to write session, result = %d", res);
+        goto END;
+    }
+    kamea->session_stored = true;
+    LOG_DBG("Saved %u QoS 1 messages not acknowledged", header.count);
+
+END:
+
+    flash_area_close(fa);
+
+    return res;
+}
+
+static int
+kamea_mqtt_session_restore(kamea_mqtt_t *kamea) {
+
+    const struct flash_area         *fa;
+    struct kamea_mqtt_session_header header;
+    struct kamea_mqtt_session_entry  entry;
+    struct kamea_mqtt_message       *message;
+    off_t                            slot   = CONFIG_KAMEA_MQTT_SESSION_STORAGE_OFFSET + kamea->index * CONFIG_KAMEA_MQTT_SESSION_STORAGE_SLOT_SIZE;
+    off_t                            offset = slot + sizeof(header);
+    uint32_t                         crc    = 0;
+    int                              index  = 0;
+    int                              res;
+
+    /* Read and check header, the slot may contain the session of another client */
+    if (0 != (res = flash_area_open(FIXED_PARTITION_ID(storage_partition), &fa))) {
+        LOG_ERR("Unable to open storage partition, result = %d", res);
+        return res;
+    }
+    if (0 != (res = flash_area_read(fa, slot, &header, sizeof(header)))) {
+        LOG_ERR("Unable to read session, result = %d", res);
+        goto END;
+    }
+    if ((KAMEA_MQTT_SESSION_MAGIC != header.magic) || (KAMEA_MQTT_SESSION_VERSION != header.version) || (header.count > KAMEA_MQTT_INFLIGHT_COUNT)
+        || (0 != strncmp(header.client_id, kamea->client_id, sizeof(header.client_id)))) {
+        goto END;
+    }
+    kamea->session_stored = true;
+
+    /* Read messages in their lanes slabs, they are sent again on the first connection */
+    for (index = 0; index < header.count; index++) {
+        if (0 != (res = flash_area_read(fa, offset, &entry, sizeof(entry)))) {
+            break;
+        }
+        if ((entry.priority >= KAMEA_PRIORITY_COUNT) || (entry.topic >= ARRAY_SIZE(kamea_mqtt_topics)) || (entry.len > CONFIG_KAMEA_MQTT_PAYLOAD_SIZE)) {
+            res = -EINVAL;
+            break;
+        }
+        if (0 != (res = k_mem_slab_alloc(&kamea->lanes[entry.priority].slab, (void **)&message, K_NO_WAIT))) {
+            break;
+        }
+        kamea->inflight[index].used     = true;
+        kamea->inflight[index].message  = message;
+        kamea->inflight[index].priority = entry.priority;
+        if (0 != (res = flash_area_read(fa, offset + sizeof(entry), message->payload, entry.len))) {
+            break;
+        }
+        crc = crc32_ieee_update(crc, (const uint8_t *)&entry, sizeof(entry));
+        crc = crc32_ieee_update(crc, message->payload, entry.len);
+        kamea->inflight[index].message_id = entry.message_id;
+        kamea->inflight[index].timestamp  = k_cycle_get_32();
+        kamea->inflight[index].queued     = k_cycle_get_32();
+        message->topic                    = kamea_mqtt_topics[entry.topic];
+        message->qos                      = MQTT_QOS_1_AT_LEAST_ONCE;
+        message->message_id               = entry.message_id;
+        message->len                      = entry.len;
+        message->timestamp                = k_cycle_get_32();
+        message->request                  = NULL;
+        offset += sizeof(entry) + CONFIG_KAMEA_MQTT_PAYLOAD_SIZE;
+    }
+
+    /* Discard the session if it is corrupted */
+    if ((0 != res) || (crc != header.crc)) {
+        LOG_WRN("Discarding corrupted session");
+        for (index = 0; index < KAMEA_MQTT_INFLIGHT_COUNT; index++) {
+            kamea_mqtt_forget(kamea, &kamea->inflight[index]);
+        }
+        res = -EINVAL;
+        goto END;
+    }
+    kamea->inflight_index = header.count % KAMEA_MQTT_INFLIGHT_COUNT;
+    memcpy(kamea->qos2_received, header.qos2_received, sizeof(kamea->qos2_received));
+    LOG_INF("Restored %u QoS 1 messages not acknowledged from the previous session", header.count);
+
+END:
+
+    flash_area_close(fa);
+
+    return res;
+}
+
+#endif /* CONFIG_KAMEA_MQTT_SESSION_STORAGE */
+
+static void
+kamea_mqtt_wake(void) {
+
+    /* The event is created by the Kamea MQTT thread, instances are checked when it starts otherwise */
+    if (kamea_mqtt_eventfd >= 0) {
+        zvfs_eventfd_write(kamea_mqtt_eventfd, 1);
+    }
+}
+
+#ifdef CONFIG_KAMEA_MQTT_BATCH
+
+static void
+kamea_mqtt_batch_timer_handler(struct k_timer *timer) {
+
+    kamea_mqtt_t *kamea = CONTAINER_OF(timer, kamea_mqtt_t, batch_timer);
+
+    /* Request a connection only if messages are waiting */
+    if (true == kamea_mqtt_pending(kamea)) {
+        kamea_mqtt_request(kamea);
+    }
+}
+
+#endif /* CONFIG_KAMEA_MQTT_BATCH */
+
+#ifdef CONFIG_KAMEA_MQTT_SHELL
+
+static int
+kamea_mqtt_stats_cmd(const struct shell *sh, size_t argc, char **argv) {
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+    kamea_mqtt_t      *kamea;
+    kamea_mqtt_stats_t stats;
+
+    /* Display statistics of each instance */
+    for (atomic_val_t index = 0; index < atomic_get(&kamea_mqtt_instances_count); index++) {
+        kamea = kamea_mqtt_instances[index];
+        kamea_mqtt_get_stats(kamea, &stats);
+        if (true == kamea->connected) {
+            shell_print(sh, "Kamea client '%s': connected for %u s", kamea->client_id, stats.uptime_s);
+        } else {
+            shell_print(sh, "Kamea client '%s': disconnected", kamea->client_id);
+        }
+        shell_print(sh,
+                    "  publishes: %u succeeded, %u failed, %u dropped, %u acknowledged, %llu bytes sent",
+                    stats.published,
+                    stats.failed,
+                    stats.dropped,
+                    stats.acknowledged,
+                    stats.bytes_sent);
+        shell_print(sh, "  received: %u messages, %llu bytes", stats.received, stats.bytes_received);
+        shell_print(sh,
+                    "  handshakes: %u succeeded, %u failed, latest %u ms with cipher suite 0x%04x, disconnections: %u",
+                    stats.handshakes,
+                    stats.handshake_failures,
+                    stats.handshake_ms,
+                    stats.ciphersuite,
+                    stats.disconnections);
+        kamea_mqtt_stats_print_histogram(sh, "TCP and TLS handshake", stats.handshake);
+        shell_print(sh, "  smoothed PUBACK round-trip time: %u us", kamea_mqtt_get_puback_rtt(kamea));
+        kamea_mqtt_stats_print_histogram(sh, "PUBACK round-trip time", stats.puback_rtt);
+    }
+
+    return 0;
+}
+
+static void
+kamea_mqtt_stats_print_histogram(const struct shell *sh, const char *name, const uint32_t *histogram) {
+
+    /* Display non-empty buckets */
+    shell_print(sh, "  %s:", name);
+    for (int bucket = 0; bucket < KAMEA_MQTT_HISTOGRAM_BUCKETS - 1; bucket++) {
+        if (0 != histogram[bucket]) {
+            shell_print(sh, "    < %u ms: %u", 1U << bucket, histogram[bucket]);
+        }
+    }
+    if (0 != histogram[KAMEA_MQTT_HISTOGRAM_BUCKETS - 1]) {
+        shell_print(sh, "    >= %u ms: %u", 1U << (KAMEA_MQTT_HISTOGRAM_BUCKETS - 2), histogram[KAMEA_MQTT_HISTOGRAM_BUCKETS - 1]);
+    }
+}
+
+/**
+ * @brief Shell commands definition
+ */
+SHELL_STATIC_SUBCMD_SET_CREATE(kamea_mqtt_cmds,
+                               SHELL_CMD_ARG(stats, NULL, "Display Kamea MQTT channel statistics", kamea_mqtt_stats_cmd, 1, 0),
+                               SHELL_SUBCMD_SET_END);
+SHELL_CMD_REGISTER(kamea, &kamea_mqtt_cmds, "Kamea commands", NULL);
+
+#endif /* CONFIG_KAMEA_MQTT_SHELL */
+
 #ifdef CONFIG_KAMEA_USE_CONNECTION_MANAGER
 
 static void
@@ -473,9 +2267,11 @@ kamea_mqtt_l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *inf
         /* Indicate the network is available */
         LOG_INF("Network is connected");
         kamea_mqtt_network_connected = true;
+        kamea_mqtt_wake();
     } else if (NET_EVENT_L4_DISCONNECTED == mgmt_event) {
         LOG_WRN("Network is disconnected");
         kamea_mqtt_network_connected = false;
+        kamea_mqtt_wake();
     }
 }
 